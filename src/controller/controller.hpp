@@ -4,16 +4,19 @@
 
 #include <Windows.h>
 
+#include <cstdint>
 #include <memory>
 
 #include "../drawing_board/drawing_board.hpp"
+#include "../drawing_board/snapshot.hpp"
 
 namespace gk {
 class Controller {
  public:
   virtual ~Controller() = default;
   // Return true if the screen needs to be updated
-  // (in any of the below methods).
+  // (in any of the below methods). Changed areas should be reported with
+  // DrawingBoard::Invalidate, otherwise the whole board gets redrawn.
   virtual bool OnMouseLButtonDown(DrawingBoard* board,
                                   DrawingBoard::Point2d mouse_pos) = 0;
   virtual bool OnMouseLButtonUp(DrawingBoard* board,
@@ -26,6 +29,16 @@ class Controller {
                          WPARAM key_code,
                          bool was_down) = 0;
   virtual bool OnKeyUp(DrawingBoard* board, WPARAM key_code) = 0;
-  virtual void Draw(DrawingBoard* board) = 0;
+  // Called once work the controller started on another thread and reported
+  // with DrawingBoard::PostWorkDone() is done.
+  virtual bool OnWorkDone(DrawingBoard* board, uint16_t generation) {
+    return false;
+  }
+  // Returns a snapshot of the scene, which is drawn on the render thread.
+  // Called after every event which needs the screen to be updated.
+  virtual std::shared_ptr<const Snapshot> TakeSnapshot() = 0;
+  // Hash of the scene, equal for scenes made by the same input. Replays of
+  // input logs are checked against it.
+  virtual uint64_t GetSceneFingerprint() const { return 0; }
 };
 }  // namespace gk
@@ -0,0 +1,129 @@
+// Copyright Wojciech Replin 2019
+
+#include "drag_solver.hpp"
+
+#include <chrono>
+#include <utility>
+
+namespace gk {
+DragSolver::~DragSolver() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+    cancel_ = true;
+  }
+  wake_up_.notify_one();
+  if (thread_.joinable())
+    thread_.join();
+}
+
+void DragSolver::Begin(DrawingBoard* board,
+                       Polygon* polygon,
+                       DrawingBoard::Point2d const& pos) {
+  End();
+  board_ = board;
+  polygon_ = polygon;
+  pos_ = pos;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    copy_ = polygon->CloneForSolving();
+  }
+  if (!thread_.joinable())
+    thread_ = std::thread(&DragSolver::Run, this);
+}
+
+void DragSolver::End() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  request_.reset();
+  if (state_ == State::SOLVING) {
+    cancel_ = true;
+    solved_.wait(lock, [this] { return state_ != State::SOLVING; });
+  }
+  state_ = State::IDLE;
+  pending_ = false;
+  copy_.reset();
+  polygon_ = nullptr;
+}
+
+void DragSolver::Solve(DrawingBoard::Point2d const& target,
+                       bool move_whole,
+                       Polygon::Solver solver) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (state_ == State::SOLVING) {
+      cancel_ = true;
+    } else if (state_ == State::SOLVED) {
+      copy_->RollbackTransaction();
+      state_ = State::IDLE;
+    }
+    request_ = Request{++generation_, pos_, target, move_whole, solver};
+    pending_ = true;
+  }
+  wake_up_.notify_one();
+}
+
+std::optional<DragSolver::Step> DragSolver::Apply(uint16_t generation) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!pending_ || generation != generation_)
+    return std::nullopt;
+  // A solved step is always the latest one, older ones are rolled back.
+  solved_.wait(lock, [this] { return state_ == State::SOLVED; });
+  Step step{solving_->move_whole, solving_->solver, correct_, solve_ms_, {}};
+  polygon_->BeginTransaction();
+  polygon_->ApplySolved(copy_.get());
+  polygon_->CommitTransaction(&step.delta);
+  pos_ = solving_->target;
+  state_ = State::IDLE;
+  pending_ = false;
+  return step;
+}
+
+void DragSolver::WaitUntilSolved() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  solved_.wait(lock, [this] {
+    return !request_.has_value() && state_ != State::SOLVING;
+  });
+}
+
+void DragSolver::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    wake_up_.wait(lock, [this] { return stop_ || request_.has_value(); });
+    if (stop_)
+      return;
+    solving_ = std::move(request_);
+    request_.reset();
+    const Request request = solving_.value();
+    state_ = State::SOLVING;
+    cancel_ = false;
+    lock.unlock();
+
+    const auto start = std::chrono::steady_clock::now();
+    copy_->BeginTransaction();
+    copy_->Drag(request.from, request.target, request.move_whole,
+                request.solver, &cancel_);
+    const bool correct = copy_->Correct();
+    if (!correct && !cancel_) {
+      // The polygon follows the mouse as a whole instead.
+      copy_->RollbackTransaction();
+      copy_->BeginTransaction();
+      copy_->Drag(request.from, request.target, true, request.solver);
+    }
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    lock.lock();
+    if (cancel_) {
+      // A newer step has been requested or the drag ended.
+      copy_->RollbackTransaction();
+      state_ = State::IDLE;
+    } else {
+      correct_ = correct;
+      solve_ms_ = elapsed.count();
+      state_ = State::SOLVED;
+      board_->PostWorkDone(request.generation);
+    }
+    solved_.notify_all();
+  }
+}
+}  // namespace gk
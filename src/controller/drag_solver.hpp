@@ -0,0 +1,106 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "../drawing_board/drawing_board.hpp"
+#include "../polygon/polygon.hpp"
+
+namespace gk {
+// Solves steps of a drag on a worker thread, on a copy of the dragged
+// polygon, so that the UI thread keeps handling input while the polygon
+// stays as it was after the last applied step. A step which hasn't been
+// applied when a newer one is requested is cancelled and solving starts
+// over from the last applied state towards the newer target. Solved steps
+// are reported with DrawingBoard::PostWorkDone() and applied on the UI
+// thread once the report is handled, so that replays of input logs apply
+// exactly the same steps.
+class DragSolver {
+ public:
+  // Step applied to the polygon.
+  struct Step {
+    bool move_whole;
+    Polygon::Solver solver;
+    // Whether the solver satisfied constraints, otherwise the polygon
+    // followed the mouse as a whole.
+    bool correct;
+    double solve_ms;
+    Polygon::Delta delta;
+  };
+
+  DragSolver() = default;
+  // Cancels the step being solved.
+  ~DragSolver();
+
+  // Starts a drag of |polygon| with the mouse at |pos|, reporting solved
+  // steps to |board|.
+  void Begin(DrawingBoard* board,
+             Polygon* polygon,
+             DrawingBoard::Point2d const& pos);
+  // Ends the drag, dropping the step which hasn't been applied, if any.
+  void End();
+  // Starts solving a step which moves the mouse to |target|, cancelling the
+  // step which hasn't been applied yet.
+  void Solve(DrawingBoard::Point2d const& target,
+             bool move_whole,
+             Polygon::Solver solver);
+  // Applies the step reported with |generation| unless a newer one has been
+  // requested since, waiting for it to be solved if needed.
+  std::optional<Step> Apply(uint16_t generation);
+  // Applies the latest step, unless it has been applied already.
+  std::optional<Step> ApplyLatest() { return Apply(generation_); }
+  // Waits until the latest step is solved and reported.
+  void WaitUntilSolved();
+
+ private:
+  struct Request {
+    uint16_t generation;
+    DrawingBoard::Point2d from;
+    DrawingBoard::Point2d target;
+    bool move_whole;
+    Polygon::Solver solver;
+  };
+  enum class State {
+    IDLE,
+    SOLVING,
+    // |copy_| holds the result of |solving_| in a transaction in progress.
+    SOLVED,
+  };
+  void Run();
+
+  DrawingBoard* board_ = nullptr;
+  Polygon* polygon_ = nullptr;
+  // Mouse position the polygon was dragged to by the last applied step.
+  DrawingBoard::Point2d pos_ = {0, 0};
+  uint16_t generation_ = 0;
+
+  // Guards members below.
+  std::mutex mutex_;
+  std::condition_variable wake_up_;
+  std::condition_variable solved_;
+  std::unique_ptr<Polygon> copy_;
+  // Latest step, waiting for the worker.
+  std::optional<Request> request_;
+  std::optional<Request> solving_;
+  State state_ = State::IDLE;
+  // Whether the latest step has been neither applied nor dropped.
+  bool pending_ = false;
+  bool correct_ = true;
+  double solve_ms_ = 0;
+  bool stop_ = false;
+  std::atomic<bool> cancel_ = false;
+
+  std::thread thread_;
+
+  // Disallow copy and assign
+  DragSolver& operator=(DragSolver&) = delete;
+  DragSolver(DragSolver&) = delete;
+};
+}  // namespace gk
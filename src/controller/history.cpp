@@ -0,0 +1,68 @@
+// Copyright Wojciech Replin 2019
+
+#include "history.hpp"
+
+#include <utility>
+
+namespace gk {
+History::History(size_t max_bytes) : max_bytes_(max_bytes) {}
+
+void History::Record(Step step) {
+  for (auto& redo : redo_)
+    bytes_ -= GetMemoryUsage(redo);
+  redo_.clear();
+  PushUndo(std::move(step));
+}
+
+std::optional<History::Step> History::TakeUndo() {
+  if (undo_.empty())
+    return std::nullopt;
+  auto step = std::move(undo_.back());
+  undo_.pop_back();
+  bytes_ -= GetMemoryUsage(step);
+  return step;
+}
+
+std::optional<History::Step> History::TakeRedo() {
+  if (redo_.empty())
+    return std::nullopt;
+  auto step = std::move(redo_.back());
+  redo_.pop_back();
+  bytes_ -= GetMemoryUsage(step);
+  return step;
+}
+
+void History::PushUndo(Step step) {
+  bytes_ += GetMemoryUsage(step);
+  undo_.push_back(std::move(step));
+  Trim();
+}
+
+void History::PushRedo(Step step) {
+  bytes_ += GetMemoryUsage(step);
+  redo_.push_back(std::move(step));
+  Trim();
+}
+
+size_t History::GetMemoryUsage(Step const& step) {
+  size_t bytes = step.capacity() * sizeof(Edit);
+  for (auto& edit : step) {
+    bytes += edit.delta.GetMemoryUsage();
+    if (edit.detached)
+      bytes += edit.detached->GetMemoryUsage();
+  }
+  return bytes;
+}
+
+void History::Trim() {
+  while (bytes_ > max_bytes_ && !undo_.empty()) {
+    bytes_ -= GetMemoryUsage(undo_.front());
+    undo_.pop_front();
+  }
+  // Then the steps furthest from being redone.
+  while (bytes_ > max_bytes_ && !redo_.empty()) {
+    bytes_ -= GetMemoryUsage(redo_.front());
+    redo_.erase(redo_.begin());
+  }
+}
+}  // namespace gk
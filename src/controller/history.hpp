@@ -0,0 +1,65 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "../polygon/polygon.hpp"
+
+namespace gk {
+// Undo and redo stacks of edits of a scene. Edits keep only what changed,
+// see Polygon::Delta, so undoing a drag of a few verticies of a huge polygon
+// stays cheap. Once the stacks take more than a given amount of memory, the
+// oldest steps are forgotten.
+class History {
+ public:
+  struct Edit {
+    enum class Type {
+      // |polygon| changed by |delta|.
+      CHANGE,
+      // |polygon| was added to the scene.
+      CREATE,
+      // |polygon| was removed from the scene, |detached| keeps it.
+      DELETE,
+    };
+    Type type;
+    Polygon* polygon;
+    Polygon::Delta delta = {};
+    std::unique_ptr<Polygon> detached = nullptr;
+  };
+  // Edits made by a single action, in order.
+  using Step = std::vector<Edit>;
+
+  explicit History(size_t max_bytes);
+
+  // Records |step| made by the user, which makes steps undone so far
+  // impossible to redo.
+  void Record(Step step);
+  // Steps are taken off the stacks to be reverted, the step which reverts
+  // them is pushed back onto the other stack.
+  std::optional<Step> TakeUndo();
+  std::optional<Step> TakeRedo();
+  void PushUndo(Step step);
+  void PushRedo(Step step);
+  size_t GetMemoryUsage() const { return bytes_; }
+
+ private:
+  static size_t GetMemoryUsage(Step const& step);
+  // Forgets the oldest steps until the limit is met, then steps which
+  // would be redone last.
+  void Trim();
+
+  const size_t max_bytes_;
+  size_t bytes_ = 0;
+  std::deque<Step> undo_;
+  std::vector<Step> redo_;
+
+  // Disallow copy and assign
+  History& operator=(History&) = delete;
+  History(History&) = delete;
+};
+}  // namespace gk
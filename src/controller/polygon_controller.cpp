@@ -2,23 +2,96 @@
 
 #include "polygon_controller.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <utility>
+#include <vector>
 
 #include "../polygon/polygon.hpp"
+#include "../rasterizer/rasterizer.hpp"
+#include "../scene/polygon_importer.hpp"
+#include "../scene/scene_file.hpp"
 
 namespace gk {
-PolygonController::PolygonController() {
+namespace {
+constexpr COLORREF kSelectionColor = RGB(255, 255, 0);
+constexpr COLORREF kBandColor = RGB(128, 128, 128);
+// Polygons handled by a single task of a parallel loop, enough for a task
+// to outweigh handing it out.
+constexpr size_t kPolygonsPerTask = 256;
+// Edges of fewer polygons are erased from the edge grid one by one rather
+// than in a pass over the whole grid.
+constexpr size_t kMaxPolygonsUnregisteredOneByOne = 16;
+constexpr double kRotationStep = 3.14159265358979323846 / 12;
+constexpr double kScaleStep = 1.1;
+
+void DrawOutline(Framebuffer* framebuffer,
+                 Rect const& rect,
+                 Framebuffer::Pixel color) {
+  if (rect.Empty())
+    return;
+  rasterizer::DrawHorizontalSpan(framebuffer, rect.left, rect.right - 1,
+                                 rect.top, color);
+  rasterizer::DrawHorizontalSpan(framebuffer, rect.left, rect.right - 1,
+                                 rect.bottom - 1, color);
+  const auto& clip = framebuffer->GetClipRect();
+  for (int y = std::max(rect.top, clip.top);
+       y < std::min(rect.bottom, clip.bottom); ++y) {
+    framebuffer->SetPixel(rect.left, y, color);
+    framebuffer->SetPixel(rect.right - 1, y, color);
+  }
+}
+
+class SceneSnapshot : public Snapshot {
+ public:
+  void Draw(Canvas* canvas) const override {
+    auto* framebuffer = canvas->GetFramebuffer();
+    const auto& clip = framebuffer->GetClipRect();
+    for (auto& polygon : polygons)
+      if (polygon.bounding_rect.Intersects(clip))
+        polygon.snapshot->Draw(canvas, polygon.offset);
+    DrawOutline(framebuffer, selection, DrawingBoard::ToPixel(kSelectionColor));
+    DrawOutline(framebuffer, band, DrawingBoard::ToPixel(kBandColor));
+  }
+
+  std::vector<Polygon::PlacedSnapshot> polygons;
+  Rect selection;
+  Rect band;
+};
+}  // namespace
+
+PolygonController::PolygonController(size_t history_bytes)
+    : edge_grid_(Polygon::PickMargin()), history_(history_bytes) {
   polygon_verticies_.reserve(2);
 }
 
-PolygonController::~PolygonController() = default;
+PolygonController::~PolygonController() {
+  // Spares polygons erasing their edges from the edge grid one by one.
+  std::vector<Polygon*> polygons;
+  for (auto& polygon : polygons_)
+    polygons.push_back(polygon.get());
+  Polygon::UnregisterEdges(std::move(polygons));
+}
 
 bool PolygonController::OnMouseLButtonDown(DrawingBoard* board,
                                            DrawingBoard::Point2d mouse_pos) {
+  // Grabbing a vertex or an edge doesn't change anything on the screen.
   if (state_ == State::FREE) {
-    for (auto& polygon : polygons_)
-      if (polygon->OnMouseLButtonDown(mouse_pos))
-        return true;
+    FinishDrag();
+    for (auto& pick : PickEdges(mouse_pos))
+      if (pick.polygon->OnMouseLButtonDown(mouse_pos, pick.edges))
+        break;
+  } else if (state_ == State::SELECT) {
+    FinishSelectionDrag(board);
+    selection_drag_ = selection_rect_.Contains(static_cast<int>(mouse_pos.x),
+                                               static_cast<int>(mouse_pos.y))
+                          ? SelectionDrag::MOVE
+                          : SelectionDrag::BAND;
+    selection_drag_from_ = selection_drag_pos_ = mouse_pos;
   }
   return false;
 }
@@ -26,9 +99,15 @@ bool PolygonController::OnMouseLButtonDown(DrawingBoard* board,
 bool PolygonController::OnMouseLButtonUp(DrawingBoard* board,
                                          DrawingBoard::Point2d mouse_pos) {
   if (state_ == State::FREE) {
+    FinishDrag();
+    UpdateFreeModeTitle(board);
     for (auto& polygon : polygons_)
       if (polygon->OnMouseLButtonUp(mouse_pos))
         return true;
+  } else if (state_ == State::SELECT &&
+             selection_drag_ != SelectionDrag::NONE) {
+    FinishSelectionDrag(board);
+    return true;
   }
   return false;
 }
@@ -38,15 +117,31 @@ bool PolygonController::OnMouseLButtonDoubleClick(
     DrawingBoard::Point2d mouse_pos) {
   switch (state_) {
     case State::CREATE_VERTEX:
-      for (auto& polygon : polygons_)
-        if (polygon->AddVertex(mouse_pos))
+      for (auto& pick : PickEdges(mouse_pos)) {
+        auto* polygon = pick.polygon;
+        polygon->BeginTransaction();
+        const bool added = polygon->AddVertex(mouse_pos, pick.edges);
+        History::Edit edit{History::Edit::Type::CHANGE, polygon};
+        polygon->CommitTransaction(&edit.delta);
+        if (added) {
+          History::Step step;
+          step.push_back(std::move(edit));
+          history_.Record(std::move(step));
           return true;
+        }
+      }
       return false;
     case State::CREATE_POLYGON:
       if (polygon_verticies_.size() == 2) {
-        polygons_.insert(Polygon::Create(board, polygon_verticies_[0],
-                                         polygon_verticies_[1], mouse_pos,
-                                         RGB(0, 255, 0), RGB(255, 0, 0)));
+        auto polygon =
+            Polygon::Create(board, &edge_grid_, &id_manager_,
+                            polygon_verticies_[0], polygon_verticies_[1],
+                            mouse_pos, RGB(0, 255, 0), RGB(255, 0, 0));
+        board->Invalidate(polygon->GetBoundingRect());
+        History::Step step;
+        step.push_back({History::Edit::Type::CREATE, polygon.get()});
+        history_.Record(std::move(step));
+        Attach(std::move(polygon));
         polygon_verticies_.clear();
         return true;
       } else {
@@ -54,59 +149,118 @@ bool PolygonController::OnMouseLButtonDoubleClick(
         return false;
       }
     case State::PURE_DESTRUCTION: {
-      for (auto it = polygons_.begin(); it != polygons_.end();) {
-        auto& polygon = *it;
-        if (!polygon->Remove(mouse_pos))
-          it = polygons_.erase(it);
-        else
-          ++it;
+      History::Step step;
+      for (auto& pick : PickEdges(mouse_pos)) {
+        auto* polygon = pick.polygon;
+        polygon->BeginTransaction();
+        const bool keep = polygon->Remove(mouse_pos, pick.edges);
+        History::Edit edit{History::Edit::Type::CHANGE, polygon};
+        polygon->CommitTransaction(&edit.delta);
+        if (!edit.delta.Empty())
+          step.push_back(std::move(edit));
+        if (!keep) {
+          step.push_back({History::Edit::Type::DELETE, polygon, {},
+                          Detach(polygon, board)});
+        }
       }
+      if (!step.empty())
+        history_.Record(std::move(step));
       return true;
-      case State::SET_PERPENDICULAR: {
-        if (last_click_.has_value()) {
-          for (auto it = polygons_.begin(); it != polygons_.end(); ++it) {
-            auto copy = (*it)->Clone();
-            if ((*it)->SetPerpendicular(last_click_.value(), mouse_pos)) {
-              if (!(*it)->Correct()) {
-                it = polygons_.erase(it);
-                polygons_.insert(std::move(copy));
-                board->ShowError(
-                    L"Could not add perpendicular constraint. Try again later.",
-                    false);
-              }
-              return true;
-            }
+    }
+    case State::SET_PERPENDICULAR: {
+      if (last_click_.has_value()) {
+        const auto first = PickEdges(last_click_.value());
+        const auto second = PickEdges(mouse_pos);
+        for (auto& pick : first) {
+          const auto other = std::find_if(
+              second.begin(), second.end(),
+              [&pick](Pick const& p) { return p.polygon == pick.polygon; });
+          if (other == second.end())
+            continue;
+          auto* polygon = pick.polygon;
+          polygon->BeginTransaction();
+          const bool added = polygon->SetPerpendicular(
+              last_click_.value(), pick.edges, mouse_pos, other->edges);
+          if (added && !polygon->Correct()) {
+            polygon->RollbackTransaction();
+            board->ShowError(
+                L"Could not add perpendicular constraint. Try again later.",
+                false);
+          } else if (added) {
+            History::Step step;
+            step.push_back({History::Edit::Type::CHANGE, polygon});
+            polygon->CommitTransaction(&step.back().delta);
+            history_.Record(std::move(step));
+          } else {
+            polygon->CommitTransaction();
           }
-          last_click_.emplace(mouse_pos);
-          return false;
-        } else {
-          last_click_.emplace(mouse_pos);
-          return false;
+          if (added)
+            return true;
         }
+        last_click_.emplace(mouse_pos);
+        return false;
+      } else {
+        last_click_.emplace(mouse_pos);
+        return false;
       }
-      case State::SET_EQUAL_LENGTH: {
-        if (last_click_.has_value()) {
-          for (auto it = polygons_.begin(); it != polygons_.end(); ++it) {
-            auto copy = (*it)->Clone();
-            if ((*it)->SetEqualLength(last_click_.value(), mouse_pos)) {
-              if (!(*it)->Correct()) {
-                it = polygons_.erase(it);
-                polygons_.insert(std::move(copy));
-                board->ShowError(
-                    L"Could not add equal length constraint. Try again later.",
-                    false);
-              }
-              return true;
-            }
+    }
+    case State::SET_EQUAL_LENGTH: {
+      if (last_click_.has_value()) {
+        const auto first = PickEdges(last_click_.value());
+        const auto second = PickEdges(mouse_pos);
+        for (auto& pick : first) {
+          const auto other = std::find_if(
+              second.begin(), second.end(),
+              [&pick](Pick const& p) { return p.polygon == pick.polygon; });
+          if (other == second.end())
+            continue;
+          auto* polygon = pick.polygon;
+          polygon->BeginTransaction();
+          const bool added = polygon->SetEqualLength(
+              last_click_.value(), pick.edges, mouse_pos, other->edges);
+          if (added && !polygon->Correct()) {
+            polygon->RollbackTransaction();
+            board->ShowError(
+                L"Could not add equal length constraint. Try again later.",
+                false);
+          } else if (added) {
+            History::Step step;
+            step.push_back({History::Edit::Type::CHANGE, polygon});
+            polygon->CommitTransaction(&step.back().delta);
+            history_.Record(std::move(step));
+          } else {
+            polygon->CommitTransaction();
           }
-          last_click_.emplace(mouse_pos);
-          return false;
-        } else {
-          last_click_.emplace(mouse_pos);
-          return false;
+          if (added)
+            return true;
         }
+        last_click_.emplace(mouse_pos);
+        return false;
+      } else {
+        last_click_.emplace(mouse_pos);
+        return false;
       }
     }
+    case State::FILL:
+      for (auto& polygon : polygons_) {
+        if (polygon->InPickRange(mouse_pos) &&
+            polygon->Contains(mouse_pos)) {
+          const auto fill_rule = polygon->GetFillRule();
+          if (!fill_rule.has_value())
+            polygon->SetFillRule(rasterizer::FillRule::EVEN_ODD);
+          else if (fill_rule.value() == rasterizer::FillRule::EVEN_ODD)
+            polygon->SetFillRule(rasterizer::FillRule::NON_ZERO);
+          else
+            polygon->SetFillRule(std::nullopt);
+          return true;
+        }
+      }
+      return false;
+    // Double-clicks aren't used in the other states, e.g. selecting.
+    case State::FREE:
+    case State::SELECT:
+    case State::TOTAL_STATES:
+      break;
   }
   return false;
 }  // namespace gk
@@ -114,23 +268,63 @@ bool PolygonController::OnMouseLButtonDoubleClick(
 bool PolygonController::OnMouseMove(DrawingBoard* board,
                                     DrawingBoard::Point2d mouse_pos) {
   if (state_ == State::FREE) {
-    for (auto it = polygons_.begin(); it != polygons_.end(); ++it) {
-      if ((*it)->Active()) {
-        auto copy = (*it)->Clone();
-        if ((*it)->OnMouseMove(mouse_pos, board->GetKeyState(VK_CONTROL))) {
-          if (!(*it)->Correct()) {
-            it = polygons_.erase(it);
-            copy->OnMouseMove(mouse_pos, true);
-            polygons_.insert(std::move(copy));
-          }
-          return true;
+    for (auto& polygon : polygons_) {
+      if (polygon->Active()) {
+        if (dragged_ != polygon.get()) {
+          FinishDrag();
+          dragged_ = polygon.get();
+          drag_solver_.Begin(board, dragged_, board->GetPreviousMousePos());
         }
+        // The screen is updated once the step is solved, see OnWorkDone().
+        drag_solver_.Solve(mouse_pos, board->GetKeyState(VK_CONTROL), solver_);
+        return false;
       }
     }
+  } else if (state_ == State::SELECT) {
+    switch (selection_drag_) {
+      case SelectionDrag::NONE:
+        return false;
+      case SelectionDrag::BAND: {
+        const Rect old_band = band_;
+        band_ = Rect(static_cast<int>(
+                         std::min(selection_drag_from_.x, mouse_pos.x)),
+                     static_cast<int>(
+                         std::min(selection_drag_from_.y, mouse_pos.y)),
+                     static_cast<int>(
+                         std::max(selection_drag_from_.x, mouse_pos.x)) + 1,
+                     static_cast<int>(
+                         std::max(selection_drag_from_.y, mouse_pos.y)) + 1);
+        board->Invalidate(old_band.Union(band_));
+        return true;
+      }
+      case SelectionDrag::MOVE:
+        TransformSelection(board, {1, 0}, mouse_pos - selection_drag_pos_,
+                           &selection_deltas_);
+        selection_drag_pos_ = mouse_pos;
+        return true;
+    }
   }
   return false;
 }
 
+bool PolygonController::OnWorkDone(DrawingBoard* board, uint16_t generation) {
+  return OnDragStep(drag_solver_.Apply(generation));
+}
+
+bool PolygonController::OnDragStep(std::optional<DragSolver::Step> step) {
+  if (!step.has_value())
+    return false;
+  if (!step->move_whole) {
+    auto& stats = solver_stats_[static_cast<size_t>(step->solver)];
+    ++stats.solves;
+    stats.failures += step->correct ? 0 : 1;
+    stats.total_ms += step->solve_ms;
+    stats.max_ms = std::max(stats.max_ms, step->solve_ms);
+  }
+  drag_delta_.Append(std::move(step->delta));
+  return true;
+}
+
 bool PolygonController::OnKeyDown(DrawingBoard* board,
                                   WPARAM key_code,
                                   bool was_down) {
@@ -139,6 +333,31 @@ bool PolygonController::OnKeyDown(DrawingBoard* board,
 
 bool PolygonController::OnKeyUp(DrawingBoard* board, WPARAM key_code) {
   switch (key_code) {
+    case 'Z':
+    case 'Y': {
+      if (!board->GetKeyState(VK_CONTROL))
+        break;
+      for (auto& polygon : polygons_)
+        if (polygon->Active())
+          return false;
+      FinishDrag();
+      FinishSelectionDrag(board);
+      const bool undo = key_code == 'Z';
+      auto step = undo ? history_.TakeUndo() : history_.TakeRedo();
+      if (!step.has_value())
+        return false;
+      auto reverted = Revert(std::move(step.value()), board);
+      if (undo)
+        history_.PushRedo(std::move(reverted));
+      else
+        history_.PushUndo(std::move(reverted));
+      if (!selection_.empty()) {
+        board->Invalidate(selection_rect_);
+        UpdateSelectionRect();
+        board->Invalidate(selection_rect_);
+      }
+      return true;
+    }
     case 'Q':
       SetState(State::FREE, board);
       break;
@@ -152,28 +371,126 @@ bool PolygonController::OnKeyUp(DrawingBoard* board, WPARAM key_code) {
       SetState(State::SET_PERPENDICULAR, board);
       break;
     case 'S':
+      if (board->GetKeyState(VK_CONTROL)) {
+        if (!scene_path_.empty() && !SaveScene())
+          board->ShowError(L"Could not save the scene.", false);
+        break;
+      }
       SetState(State::SET_EQUAL_LENGTH, board);
       break;
+    case 'I':
+      if (!board->GetKeyState(VK_CONTROL) || import_path_.empty())
+        break;
+      for (auto& polygon : polygons_)
+        if (polygon->Active())
+          return false;
+      SetState(State::FREE, board);
+      if (!ImportPolygons(board)) {
+        board->ShowError(L"Could not import polygons.", false);
+        return false;
+      }
+      return true;
+    case 'O':
+      if (!board->GetKeyState(VK_CONTROL) || scene_path_.empty())
+        break;
+      for (auto& polygon : polygons_)
+        if (polygon->Active())
+          return false;
+      SetState(State::FREE, board);
+      if (!LoadScene(board)) {
+        board->ShowError(L"Could not load the scene.", false);
+        return false;
+      }
+      return true;
     case 'D':
       SetState(State::PURE_DESTRUCTION, board);
       break;
-    case VK_SPACE:
-      polygons_.insert(Polygon::CreateSamplePolygon(board));
+    case 'F':
+      SetState(State::FILL, board);
+      break;
+    case 'X':
+      SetState(State::SELECT, board);
+      break;
+    case 'R':
+    case 'T':
+      if (state_ != State::SELECT || selection_.empty())
+        break;
+      TransformSelectionAboutCenter(
+          board, {std::cos(kRotationStep),
+                  key_code == 'R' ? std::sin(kRotationStep)
+                                  : -std::sin(kRotationStep)});
       return true;
+    case 'C':
+    case 'V':
+      if (state_ != State::SELECT || selection_.empty())
+        break;
+      TransformSelectionAboutCenter(
+          board, {key_code == 'C' ? kScaleStep : 1 / kScaleStep, 0});
+      return true;
+    case 'G':
+      solver_ = solver_ == Polygon::Solver::PROPAGATION
+                    ? Polygon::Solver::LEAST_SQUARES
+                    : Polygon::Solver::PROPAGATION;
+      if (state_ == State::FREE)
+        UpdateFreeModeTitle(board);
+      break;
+    case VK_SPACE: {
+      auto polygon =
+          Polygon::CreateSamplePolygon(board, &edge_grid_, &id_manager_);
+      board->Invalidate(polygon->GetBoundingRect());
+      History::Step step;
+      step.push_back({History::Edit::Type::CREATE, polygon.get()});
+      history_.Record(std::move(step));
+      Attach(std::move(polygon));
+      return true;
+    }
   }
   return false;
 }
 
-void PolygonController::Draw(DrawingBoard* board) {
+std::shared_ptr<const Snapshot> PolygonController::TakeSnapshot() {
+  auto snapshot = std::make_shared<SceneSnapshot>();
+  // After a transform of a large selection most polygons have to be copied,
+  // which is spread across cores.
+  if (snapshot_order_.empty())
+    for (auto& polygon : polygons_)
+      snapshot_order_.push_back(polygon.get());
+  snapshot->polygons.resize(snapshot_order_.size(),
+                            {nullptr, {0, 0}, Rect()});
+  worker_pool_.ParallelFor(
+      snapshot_order_.size(), kPolygonsPerTask, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+          snapshot->polygons[i] = snapshot_order_[i]->TakeSnapshot();
+      });
+  if (state_ == State::SELECT) {
+    snapshot->selection = selection_rect_;
+    snapshot->band = band_;
+  }
+  return snapshot;
+}
+
+uint64_t PolygonController::GetSceneFingerprint() const {
+  // Polygons are ordered by address, which differs between runs.
+  uint64_t fingerprint = 0;
   for (auto& polygon : polygons_)
-    polygon->Display();
+    fingerprint += polygon->GetFingerprint();
+  return fingerprint;
 }
 
 void PolygonController::SetState(State state, DrawingBoard* board) {
   const State old_state = state_;
+  FinishDrag();
+  FinishSelectionDrag(board);
+  if (state != State::SELECT && !selection_.empty()) {
+    UpdateEdgeGrid();
+    board->Invalidate(selection_rect_);
+    selection_.clear();
+    UpdateSelectionRect();
+  }
   switch (state) {
     case State::FREE:
-      board->SetTitle(L"Free mode");
+      state_ = state;
+      UpdateFreeModeTitle(board);
       break;
     case State::CREATE_VERTEX:
       board->SetTitle(L"Vertex creation mode");
@@ -193,6 +510,13 @@ void PolygonController::SetState(State state, DrawingBoard* board) {
       last_click_.reset();
       board->SetTitle(L"Adding equal length constraint");
       break;
+    case State::FILL:
+      board->SetTitle(L"Fill mode");
+      break;
+    case State::SELECT:
+      state_ = state;
+      UpdateSelectionModeTitle(board);
+      break;
     case State::TOTAL_STATES:
     default:
       return;
@@ -203,4 +527,323 @@ void PolygonController::SetState(State state, DrawingBoard* board) {
       polygon->OnControllerStateChanged(this);
 }
 
+void PolygonController::UpdateFreeModeTitle(DrawingBoard* board) {
+  constexpr wchar_t const* kSolverNames[] = {L"propagation",
+                                             L"least squares"};
+  std::wostringstream title;
+  title << L"Free mode [" << kSolverNames[static_cast<size_t>(solver_)]
+        << L" solver]" << std::fixed;
+  for (size_t i = 0; i < solver_stats_.size(); ++i) {
+    const auto& stats = solver_stats_[i];
+    if (!stats.solves)
+      continue;
+    title << L" | " << kSolverNames[i] << L": " << stats.solves
+          << L" steps, " << std::setprecision(3)
+          << stats.total_ms / stats.solves << L" ms avg, " << stats.max_ms
+          << L" ms max, " << std::setprecision(1)
+          << 100.0 * (stats.solves - stats.failures) / stats.solves
+          << L"% solved";
+  }
+  const auto& moves = board->GetMouseMoveStats();
+  if (moves.coalesced) {
+    title << L" | " << moves.coalesced << L" of " << moves.received
+          << L" mouse moves coalesced";
+  }
+  board->SetTitle(title.str());
+}
+
+void PolygonController::UpdateSelectionModeTitle(DrawingBoard* board,
+                                                 size_t skipped) {
+  std::wostringstream title;
+  title << L"Selection mode | " << selection_.size() << L" polygons selected";
+  if (skipped)
+    title << L" | " << skipped << L" too small to shrink";
+  board->SetTitle(title.str());
+}
+
+std::vector<PolygonController::Pick> PolygonController::PickEdges(
+    DrawingBoard::Point2d const& point) {
+  UpdateEdgeGrid();
+  // Entries come sorted by polygon, just like |polygons_|.
+  edge_grid_.Query(point, &grid_entries_);
+  std::vector<Pick> picks;
+  for (auto& entry : grid_entries_) {
+    if (picks.empty() || picks.back().polygon != entry.polygon)
+      picks.push_back({entry.polygon, {}});
+    picks.back().edges.push_back(entry.edge);
+  }
+  return picks;
+}
+
+void PolygonController::Attach(std::unique_ptr<Polygon> polygon) {
+  polygons_.insert(std::move(polygon));
+  snapshot_order_.clear();
+}
+
+std::unique_ptr<Polygon> PolygonController::Detach(Polygon* polygon,
+                                                   DrawingBoard* board) {
+  snapshot_order_.clear();
+  auto node = polygons_.extract(polygons_.find(polygon));
+  auto detached = std::move(node.value());
+  const auto selected =
+      std::lower_bound(selection_.begin(), selection_.end(), polygon,
+                       std::less<Polygon*>());
+  if (selected != selection_.end() && *selected == polygon) {
+    if (!selection_deltas_.empty())
+      selection_deltas_.erase(selection_deltas_.begin() +
+                              (selected - selection_.begin()));
+    selection_.erase(selected);
+  }
+  detached->UnregisterEdges();
+  board->Invalidate(detached->GetBoundingRect());
+  return detached;
+}
+
+void PolygonController::FinishDrag() {
+  if (!dragged_)
+    return;
+  OnDragStep(drag_solver_.ApplyLatest());
+  drag_solver_.End();
+  History::Step step;
+  step.push_back({History::Edit::Type::CHANGE, dragged_});
+  step.back().delta = std::move(drag_delta_);
+  step.back().delta.Compact();
+  if (!step.back().delta.Empty())
+    history_.Record(std::move(step));
+  dragged_ = nullptr;
+}
+
+History::Step PolygonController::Revert(History::Step step,
+                                        DrawingBoard* board) {
+  // Changed polygons register their edges again from scratch once many of
+  // them are reverted, e.g. after a transform of a large selection, and
+  // created ones leave the edge grid at once, e.g. after a scene is loaded.
+  if (step.size() > kMaxPolygonsUnregisteredOneByOne) {
+    std::vector<Polygon*> unregistered;
+    for (auto& edit : step)
+      if (edit.type != History::Edit::Type::DELETE)
+        unregistered.push_back(edit.polygon);
+    Polygon::UnregisterEdges(std::move(unregistered));
+  }
+  History::Step reverted;
+  for (auto edit = step.rbegin(); edit != step.rend(); ++edit) {
+    auto* polygon = edit->polygon;
+    switch (edit->type) {
+      case History::Edit::Type::CHANGE:
+        reverted.push_back({History::Edit::Type::CHANGE, polygon});
+        polygon->Revert(&edit->delta, &reverted.back().delta);
+        break;
+      case History::Edit::Type::CREATE:
+        reverted.push_back({History::Edit::Type::DELETE, polygon, {},
+                            Detach(polygon, board)});
+        break;
+      case History::Edit::Type::DELETE:
+        polygon->UpdateEdgeGrid();
+        board->Invalidate(polygon->GetBoundingRect());
+        Attach(std::move(edit->detached));
+        reverted.push_back({History::Edit::Type::CREATE, polygon});
+        break;
+    }
+  }
+  return reverted;
+}
+
+bool PolygonController::SaveScene() const {
+  std::vector<Polygon::Data> polygons;
+  polygons.reserve(polygons_.size());
+  for (auto& polygon : polygons_)
+    polygons.push_back(polygon->GetData());
+  return WriteScene(scene_path_, polygons);
+}
+
+bool PolygonController::LoadScene(DrawingBoard* board) {
+  SceneReader reader(scene_path_);
+  if (!reader.Good())
+    return false;
+  std::vector<std::unique_ptr<Polygon>> loaded;
+  loaded.reserve(reader.GetPolygonCount());
+  for (size_t i = 0; i < reader.GetPolygonCount(); ++i) {
+    auto polygon =
+        Polygon::Create(board, &edge_grid_, &id_manager_, reader.GetPolygon(i));
+    if (!polygon) {
+      std::vector<Polygon*> unregistered;
+      for (auto& created : loaded)
+        unregistered.push_back(created.get());
+      Polygon::UnregisterEdges(std::move(unregistered));
+      return false;
+    }
+    loaded.push_back(std::move(polygon));
+  }
+  // The loaded scene replaces the current one as a single step.
+  std::vector<Polygon*> replaced;
+  for (auto& polygon : polygons_)
+    replaced.push_back(polygon.get());
+  Polygon::UnregisterEdges(replaced);
+  History::Step step;
+  for (auto* polygon : replaced)
+    step.push_back({History::Edit::Type::DELETE, polygon, {},
+                    Detach(polygon, board)});
+  for (auto& polygon : loaded) {
+    step.push_back({History::Edit::Type::CREATE, polygon.get()});
+    Attach(std::move(polygon));
+  }
+  history_.Record(std::move(step));
+  board->InvalidateAll();
+  return true;
+}
+
+bool PolygonController::ImportPolygons(DrawingBoard* board) {
+  PolygonImporter importer(&worker_pool_);
+  std::vector<std::unique_ptr<Polygon>> imported;
+  const bool read =
+      importer.Import(import_path_, [&](Polygon::Data const& data) {
+        auto colored = data;
+        colored.edge_color = RGB(0, 255, 0);
+        colored.vertex_color = RGB(255, 0, 0);
+        auto polygon =
+            Polygon::Create(board, &edge_grid_, &id_manager_, colored);
+        if (polygon)
+          imported.push_back(std::move(polygon));
+      });
+  // Polygons read before a failure are dropped, the scene stays as it was.
+  if (!read) {
+    std::vector<Polygon*> unregistered;
+    for (auto& polygon : imported)
+      unregistered.push_back(polygon.get());
+    Polygon::UnregisterEdges(std::move(unregistered));
+    return false;
+  }
+  if (!imported.empty()) {
+    History::Step step;
+    for (auto& polygon : imported) {
+      step.push_back({History::Edit::Type::CREATE, polygon.get()});
+      Attach(std::move(polygon));
+    }
+    history_.Record(std::move(step));
+    board->InvalidateAll();
+  }
+  const auto& stats = importer.GetStats();
+  std::wostringstream title;
+  title << L"Imported " << stats.polygons << L" polygons, " << stats.verticies
+        << L" verticies";
+  if (stats.skipped)
+    title << L" (" << stats.skipped << L" skipped)";
+  title << L" | " << std::fixed << std::setprecision(1)
+        << stats.bytes / 1e6 / std::max(stats.seconds, 1e-9) << L" MB/s";
+  board->SetTitle(title.str());
+  return true;
+}
+
+size_t PolygonController::TransformSelection(
+    DrawingBoard* board,
+    DrawingBoard::Point2d const& factor,
+    DrawingBoard::Point2d const& offset,
+    std::vector<Polygon::Delta>* deltas) {
+  const double scale = std::hypot(factor.x, factor.y);
+  deltas->resize(selection_.size());
+  // Journals of polygons are swapped with these, so that their buffers are
+  // reused by the next transform.
+  transform_deltas_.resize(selection_.size());
+  std::atomic<size_t> skipped = 0;
+  std::mutex mutex;
+  Rect selection_rect;
+  worker_pool_.ParallelFor(
+      selection_.size(), kPolygonsPerTask, [&](size_t begin, size_t end) {
+        Rect rect;
+        for (size_t i = begin; i < end; ++i) {
+          auto* polygon = selection_[i];
+          if (polygon->CanScale(scale)) {
+            polygon->BeginTransaction();
+            polygon->Transform(factor, offset);
+            polygon->CommitTransaction(&transform_deltas_[i]);
+            (*deltas)[i].Append(std::move(transform_deltas_[i]));
+          } else {
+            ++skipped;
+          }
+          rect = rect.Union(polygon->GetBoundingRect());
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        selection_rect = selection_rect.Union(rect);
+      });
+  // Polygons lie inside the selection rect, before and after.
+  board->Invalidate(selection_rect_.Union(selection_rect));
+  selection_rect_ = selection_rect;
+  selection_unregistered_ = true;
+  return skipped;
+}
+
+void PolygonController::TransformSelectionAboutCenter(
+    DrawingBoard* board,
+    DrawingBoard::Point2d const& factor) {
+  FinishSelectionDrag(board);
+  const DrawingBoard::Point2d center{
+      (selection_rect_.left + selection_rect_.right) / 2.0,
+      (selection_rect_.top + selection_rect_.bottom) / 2.0};
+  std::vector<Polygon::Delta> deltas;
+  const size_t skipped =
+      TransformSelection(board, factor, center - center * factor, &deltas);
+  History::Step step;
+  for (size_t i = 0; i < selection_.size(); ++i)
+    if (!deltas[i].Empty())
+      step.push_back({History::Edit::Type::CHANGE, selection_[i],
+                      std::move(deltas[i])});
+  if (!step.empty())
+    history_.Record(std::move(step));
+  UpdateSelectionModeTitle(board, skipped);
+}
+
+void PolygonController::FinishSelectionDrag(DrawingBoard* board) {
+  switch (selection_drag_) {
+    case SelectionDrag::NONE:
+      return;
+    case SelectionDrag::BAND: {
+      // Polygons touched by the band are added to the selection with CTRL,
+      // replace it otherwise.
+      const bool add = board->GetKeyState(VK_CONTROL);
+      UpdateEdgeGrid();
+      board->Invalidate(selection_rect_.Union(band_));
+      std::vector<Polygon*> selection;
+      for (auto& polygon : polygons_) {
+        if (polygon->GetBoundingRect().Intersects(band_) ||
+            (add && std::binary_search(selection_.begin(), selection_.end(),
+                                       polygon.get(), std::less<Polygon*>())))
+          selection.push_back(polygon.get());
+      }
+      selection_.swap(selection);
+      UpdateSelectionRect();
+      board->Invalidate(selection_rect_);
+      band_ = Rect();
+      break;
+    }
+    case SelectionDrag::MOVE: {
+      History::Step step;
+      for (size_t i = 0; i < selection_deltas_.size(); ++i)
+        if (!selection_deltas_[i].Empty())
+          step.push_back({History::Edit::Type::CHANGE, selection_[i],
+                          std::move(selection_deltas_[i])});
+      if (!step.empty())
+        history_.Record(std::move(step));
+      selection_deltas_.clear();
+      break;
+    }
+  }
+  selection_drag_ = SelectionDrag::NONE;
+  UpdateSelectionModeTitle(board);
+}
+
+void PolygonController::UpdateSelectionRect() {
+  selection_rect_ = Rect();
+  for (auto* polygon : selection_)
+    selection_rect_ = selection_rect_.Union(polygon->GetBoundingRect());
+}
+
+void PolygonController::UpdateEdgeGrid() {
+  if (!selection_unregistered_)
+    return;
+  if (selection_.size() > kMaxPolygonsUnregisteredOneByOne)
+    Polygon::UnregisterEdges(selection_);
+  for (auto* polygon : selection_)
+    polygon->UpdateEdgeGrid();
+  selection_unregistered_ = false;
+}
 }  // namespace gk
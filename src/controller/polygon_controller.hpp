@@ -4,6 +4,11 @@
 
 #include <Windows.h>
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <set>
@@ -12,13 +17,20 @@
 
 #include "../controller/controller.hpp"
 #include "../drawing_board/drawing_board.hpp"
+#include "drag_solver.hpp"
+#include "history.hpp"
+#include "../id_manager/id_manager.hpp"
+#include "../polygon/edge_grid.hpp"
+#include "../polygon/polygon.hpp"
+#include "../worker_pool/worker_pool.hpp"
 
 namespace gk {
-class Polygon;
-
 class PolygonController : public Controller {
  public:
-  PolygonController();
+  static constexpr size_t kDefaultHistoryBytes = 64 << 20;
+
+  // Undo history takes at most |history_bytes| of memory.
+  explicit PolygonController(size_t history_bytes = kDefaultHistoryBytes);
   // Overridden from Controller
   ~PolygonController() override;
   bool OnMouseLButtonDown(DrawingBoard* board,
@@ -31,10 +43,99 @@ class PolygonController : public Controller {
                    DrawingBoard::Point2d mouse_pos) override;
   bool OnKeyDown(DrawingBoard* board, WPARAM key_code, bool was_down) override;
   bool OnKeyUp(DrawingBoard* board, WPARAM key_code) override;
-  void Draw(DrawingBoard* board) override;
+  bool OnWorkDone(DrawingBoard* board, uint16_t generation) override;
+  std::shared_ptr<const Snapshot> TakeSnapshot() override;
+  uint64_t GetSceneFingerprint() const override;
+
+  // Waits until the latest drag step is solved and its OnWorkDone() is
+  // posted, e.g. to handle events one at a time.
+  void WaitUntilSolved() { drag_solver_.WaitUntilSolved(); }
+  // Sets the scene file saved with CTRL+S and loaded with CTRL+O, see
+  // SceneReader.
+  void SetScenePath(std::filesystem::path path) {
+    scene_path_ = std::move(path);
+  }
+  // Sets the SVG or text file imported with CTRL+I, see PolygonImporter.
+  void SetImportPath(std::filesystem::path path) {
+    import_path_ = std::move(path);
+  }
 
  private:
-  std::set<std::unique_ptr<Polygon>> polygons_;
+  // Orders polygons by address like std::less would, but also allows
+  // looking them up by a raw pointer.
+  struct PolygonLess {
+    using is_transparent = void;
+    bool operator()(std::unique_ptr<Polygon> const& a,
+                    std::unique_ptr<Polygon> const& b) const {
+      return std::less<Polygon*>()(a.get(), b.get());
+    }
+    bool operator()(std::unique_ptr<Polygon> const& a, Polygon* b) const {
+      return std::less<Polygon*>()(a.get(), b);
+    }
+    bool operator()(Polygon* a, std::unique_ptr<Polygon> const& b) const {
+      return std::less<Polygon*>()(a, b.get());
+    }
+  };
+  // Polygon with candidate edges near a point.
+  struct Pick {
+    Polygon* polygon;
+    Polygon::Edges edges;
+  };
+  // Finds polygons with edges near |point|, in the order of |polygons_|.
+  std::vector<Pick> PickEdges(DrawingBoard::Point2d const& point);
+  // Puts |polygon| into the scene.
+  void Attach(std::unique_ptr<Polygon> polygon);
+  // Takes |polygon| out of the scene.
+  std::unique_ptr<Polygon> Detach(Polygon* polygon, DrawingBoard* board);
+  // Applies the latest step of the drag in progress, if any, and records
+  // changes made by the drag as a single step.
+  void FinishDrag();
+  // Adds |step| of the drag to solver statistics and the drag's changes.
+  // Returns whether there was a step.
+  bool OnDragStep(std::optional<DragSolver::Step> step);
+  // Reverts |step| and returns the step which reverts it back.
+  History::Step Revert(History::Step step, DrawingBoard* board);
+  bool SaveScene() const;
+  // Replaces the scene with the one in |scene_path_|, as a single step.
+  bool LoadScene(DrawingBoard* board);
+  // Adds polygons from |import_path_| to the scene, as a single step, and
+  // shows the import throughput. Returns false and leaves the scene as it
+  // was if the file can't be read to the end.
+  bool ImportPolygons(DrawingBoard* board);
+
+  // Maps verticies of every selected polygon, seen as complex numbers, from
+  // z to z * |factor| + |offset|, see Polygon::Transform(), appending the
+  // changes to |deltas|, which parallel |selection_|. Polygons whose
+  // constrained edges would become too short are left alone, their number
+  // is returned. Large selections are transformed in parallel and their
+  // edges are registered in the edge grid only once needed.
+  size_t TransformSelection(DrawingBoard* board,
+                            DrawingBoard::Point2d const& factor,
+                            DrawingBoard::Point2d const& offset,
+                            std::vector<Polygon::Delta>* deltas);
+  // Rotates and scales the selection by |factor| about its center, as a
+  // single step.
+  void TransformSelectionAboutCenter(DrawingBoard* board,
+                                     DrawingBoard::Point2d const& factor);
+  // Ends the rubber band or the move of the selection in progress, if any.
+  void FinishSelectionDrag(DrawingBoard* board);
+  void UpdateSelectionRect();
+  // Registers edges of polygons moved by TransformSelection() in the edge
+  // grid.
+  void UpdateEdgeGrid();
+
+  // Constraint ids and edges of all polygons. Declared before |polygons_|,
+  // which return their ids and unregister their edges when destroyed.
+  SequentialIdManager id_manager_;
+  EdgeGrid edge_grid_;
+  std::vector<EdgeGrid::Entry> grid_entries_;
+  std::set<std::unique_ptr<Polygon>, PolygonLess> polygons_;
+  History history_;
+  // Polygon being dragged and changes made by the drag so far, which are
+  // coalesced into one step once the drag ends.
+  Polygon* dragged_ = nullptr;
+  Polygon::Delta drag_delta_;
+  DragSolver drag_solver_;
   enum class State {
     FREE,
     CREATE_VERTEX,
@@ -42,11 +143,54 @@ class PolygonController : public Controller {
     PURE_DESTRUCTION,
     SET_PERPENDICULAR,
     SET_EQUAL_LENGTH,
+    FILL,
+    SELECT,
     TOTAL_STATES,
   } state_ = State::FREE;
   void SetState(State state, DrawingBoard* board);
+  // Shows the current solver and drag statistics of both solvers.
+  void UpdateFreeModeTitle(DrawingBoard* board);
+  // Shows the size of the selection and how many of its polygons the last
+  // transform had to leave alone.
+  void UpdateSelectionModeTitle(DrawingBoard* board, size_t skipped = 0);
+
+  Polygon::Solver solver_ = Polygon::Solver::PROPAGATION;
+  // Time spent in and success rate of single drag steps, per solver.
+  struct SolverStats {
+    unsigned int solves = 0;
+    unsigned int failures = 0;
+    double total_ms = 0;
+    double max_ms = 0;
+  };
+  std::array<SolverStats, 2> solver_stats_;
 
   std::optional<DrawingBoard::Point2d> last_click_;
   std::vector<DrawingBoard::Point2d> polygon_verticies_;
+
+  // Selected polygons, ordered like |polygons_|, and the union of their
+  // bounding rects.
+  std::vector<Polygon*> selection_;
+  Rect selection_rect_;
+  // Whether edges of the selection lag behind in the edge grid.
+  bool selection_unregistered_ = false;
+  // Pressing the mouse inside the selection rect moves the selection,
+  // pressing it elsewhere draws a rubber band selecting polygons it touches.
+  enum class SelectionDrag {
+    NONE,
+    BAND,
+    MOVE,
+  } selection_drag_ = SelectionDrag::NONE;
+  DrawingBoard::Point2d selection_drag_from_ = {0, 0};
+  DrawingBoard::Point2d selection_drag_pos_ = {0, 0};
+  Rect band_;
+  // Changes made by the move of the selection so far, which are coalesced
+  // into one step once the move ends.
+  std::vector<Polygon::Delta> selection_deltas_;
+  std::vector<Polygon::Delta> transform_deltas_;
+  WorkerPool worker_pool_;
+  // Polygons in the order of |polygons_|, cleared whenever it changes.
+  std::vector<Polygon*> snapshot_order_;
+  std::filesystem::path scene_path_;
+  std::filesystem::path import_path_;
 };
 }  // namespace gk
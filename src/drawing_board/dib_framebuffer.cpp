@@ -0,0 +1,25 @@
+// Copyright Wojciech Replin 2019
+
+#include "dib_framebuffer.hpp"
+
+namespace gk {
+DibFramebuffer::DibFramebuffer(HDC hdc, Size width, Size height) {
+  BITMAPINFO info = {};
+  info.bmiHeader.biSize = sizeof(info.bmiHeader);
+  info.bmiHeader.biWidth = width;
+  // Negative height makes the DIB top-down, just like the window.
+  info.bmiHeader.biHeight = -height;
+  info.bmiHeader.biPlanes = 1;
+  info.bmiHeader.biBitCount = 32;
+  info.bmiHeader.biCompression = BI_RGB;
+
+  void* bits = nullptr;
+  bitmap_ = CreateDIBSection(hdc, &info, DIB_RGB_COLORS, &bits, NULL, 0);
+  if (bitmap_ && bits)
+    Attach(static_cast<Pixel*>(bits), width, height, width);
+}
+
+DibFramebuffer::~DibFramebuffer() {
+  DeleteObject(bitmap_);
+}
+}  // namespace gk
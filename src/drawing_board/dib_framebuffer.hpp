@@ -0,0 +1,23 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+#include <Windows.h>
+
+#include "framebuffer.hpp"
+
+namespace gk {
+// Framebuffer backed by a top-down 32bpp DIB section. The bitmap can be
+// selected into a memory DC, so GDI and direct pixel writes share memory.
+// Remember to GdiFlush() before touching pixels after a GDI call.
+class DibFramebuffer : public Framebuffer {
+ public:
+  DibFramebuffer(HDC hdc, Size width, Size height);
+  ~DibFramebuffer() override;
+
+  HBITMAP GetBitmap() const { return bitmap_; }
+
+ private:
+  HBITMAP bitmap_ = NULL;
+};
+}  // namespace gk
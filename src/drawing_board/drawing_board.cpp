@@ -2,6 +2,7 @@
 
 #include "drawing_board.hpp"
 
+#include <limits>
 #include <string>
 #include <utility>
 
@@ -31,6 +32,12 @@ POINT GetCursorPosInWindow(HWND hWnd) {
   ScreenToClient(hWnd, &p);
   return p;
 }
+
+int16_t ClampToInt16(LONG value) {
+  return static_cast<int16_t>(
+      std::clamp<LONG>(value, std::numeric_limits<int16_t>::min(),
+                       std::numeric_limits<int16_t>::max()));
+}
 }  // namespace
 
 /* static */
@@ -58,8 +65,6 @@ DrawingBoard::DrawingBoard(Size posx,
       pixel_size_(pixel_size),
       drawing_board_width_(width),
       drawing_board_height_(height),
-      hdc_mem_(NULL),
-      off_screen_bitmap_(NULL),
       last_mouse_pos_({0, 0}),
       controller_(std::move(controller)) {
   if (!(width > 0 && height > 0 && pixel_size > 0)) {
@@ -87,56 +92,88 @@ DrawingBoard::DrawingBoard(Size posx,
   SetWindowLongPtr(window_, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
   window_hdc_ = GetDC(window_);
   const auto mouse_pos = GetCursorPosInWindow(window_);
-  last_mouse_pos_ = Point2d(mouse_pos.x, mouse_pos.y);
+  last_mouse_pos_ = Point2d(mouse_pos.x, mouse_pos.y) / pixel_size_;
 
-  hdc_mem_ = CreateCompatibleDC(window_hdc_);
-  off_screen_bitmap_ = CreateCompatibleBitmap(window_hdc_, width, height);
-  SelectObject(hdc_mem_, off_screen_bitmap_);
-  SetBkMode(hdc_mem_, TRANSPARENT);
+  renderer_ =
+      std::make_unique<Renderer>(window_hdc_, width, height, pixel_size);
+  if (!renderer_->Good()) {
+    ShowError(GetErrorCodeString(GetLastError()), true);
+    return;
+  }
 }
 
 DrawingBoard::~DrawingBoard() {
+  if (input_log_)
+    input_log_->Finish(controller_->GetSceneFingerprint());
+  renderer_.reset();
   ReleaseDC(window_, window_hdc_);
-  DeleteObject(off_screen_bitmap_);
-  DeleteDC(hdc_mem_);
   DestroyWindow(window_);
 }
 
 void DrawingBoard::Display() {
-  const RECT rect = {0, 0, drawing_board_width_ * pixel_size_,
-                     drawing_board_height_ * pixel_size_};
-  controller_->Draw(this);
-  StretchBlt(window_hdc_, rect.left, rect.top, rect.right - rect.left,
-             rect.bottom - rect.top, hdc_mem_, 0, 0, drawing_board_width_,
-             drawing_board_height_, SRCCOPY);
-}
-
-void DrawingBoard::Clear() {
-  const RECT rect = {0, 0, drawing_board_width_, drawing_board_height_};
-  FillRect(hdc_mem_, &rect,
-           reinterpret_cast<HBRUSH>(GetStockObject(BLACK_BRUSH)));
-}
-
-void DrawingBoard::SetPixel(Coordinate x, Coordinate y, COLORREF color) {
-  ::SetPixel(hdc_mem_, x, y, color);
-}
-
-void DrawingBoard::DrawTxt(Coordinate posx,
-                           Coordinate posy,
-                           std::wstring_view text,
-                           Size font_size,
-                           COLORREF color) {
-  RECT rect{posx, posy, drawing_board_width_, drawing_board_height_};
-  HFONT hFont;
-  hFont = CreateFont(font_size, 0, 0, 0, FW_THIN, FALSE, FALSE, FALSE,
-                     DEFAULT_CHARSET, OUT_OUTLINE_PRECIS, CLIP_DEFAULT_PRECIS,
-                     NONANTIALIASED_QUALITY, VARIABLE_PITCH, TEXT("arial"));
-  HFONT old_font = reinterpret_cast<HFONT>(SelectObject(hdc_mem_, hFont));
-  COLORREF old_color = SetTextColor(hdc_mem_, color);
-  DrawTextW(hdc_mem_, text.data(), text.length(), &rect, DT_NOCLIP);
-  SetTextColor(hdc_mem_, old_color);
-  SelectObject(hdc_mem_, old_font);
-  DeleteObject(hFont);
+  InvalidateAll();
+  Redraw();
+}
+
+bool DrawingBoard::RecordInput(std::filesystem::path const& path) {
+  input_log_ = std::make_unique<InputLogWriter>(
+      path, InputLogHeader{drawing_board_width_, drawing_board_height_,
+                           pixel_size_});
+  if (!input_log_->Good()) {
+    input_log_.reset();
+    return false;
+  }
+  input_log_start_ = std::chrono::steady_clock::now();
+  // Replays start with the same previous mouse position.
+  const auto mouse_pos = GetCursorPosInWindow(window_);
+  last_mouse_pos_ = Point2d(mouse_pos.x, mouse_pos.y) / pixel_size_;
+  Record(InputEvent::Type::CURSOR, 0,
+         MAKELPARAM(ClampToInt16(mouse_pos.x), ClampToInt16(mouse_pos.y)));
+  return true;
+}
+
+void DrawingBoard::Replay(InputEvent const& event) {
+  replayed_ctrl_ = event.ctrl;
+  const Point2d mouse_pos = Point2d(event.x, event.y) / pixel_size_;
+  switch (event.type) {
+    case InputEvent::Type::CURSOR:
+      last_mouse_pos_ = mouse_pos;
+      break;
+    case InputEvent::Type::L_BUTTON_DOWN:
+      OnMouseLButtonDown(mouse_pos);
+      break;
+    case InputEvent::Type::L_BUTTON_UP:
+      OnMouseLButtonUp(mouse_pos);
+      break;
+    case InputEvent::Type::L_BUTTON_DOUBLE_CLICK:
+      OnMouseLButtonDoubleClick(mouse_pos);
+      break;
+    case InputEvent::Type::MOUSE_MOVE:
+      OnMouseMove(mouse_pos);
+      break;
+    case InputEvent::Type::KEY_DOWN:
+      OnKeyDown(event.key_code, event.was_down);
+      break;
+    case InputEvent::Type::KEY_UP:
+      OnKeyUp(event.key_code);
+      break;
+    case InputEvent::Type::WORK_DONE:
+      OnWorkDone(event.generation);
+      break;
+  }
+}
+
+void DrawingBoard::PostWorkDone(uint16_t generation) {
+  PostMessageW(window_, kWorkDoneMessage, generation, 0);
+}
+
+void DrawingBoard::Invalidate(Rect const& rect) {
+  damage_ = damage_.Union(rect.Intersection(
+      Rect(0, 0, drawing_board_width_, drawing_board_height_)));
+}
+
+void DrawingBoard::InvalidateAll() {
+  damage_ = Rect(0, 0, drawing_board_width_, drawing_board_height_);
 }
 
 void DrawingBoard::ShowError(std::wstring_view error_message, bool fatal) {
@@ -163,38 +200,58 @@ LRESULT DrawingBoard::WndProc(HWND hWnd,
         window->Display();
       return DefWindowProcW(hWnd, message, wParam, lParam);
     case WM_KEYDOWN:
-      if (window)
+      if (window) {
+        window->Record(InputEvent::Type::KEY_DOWN, wParam, lParam);
         window->OnKeyDown(wParam, (lParam >> 30) & 1);
+      }
       return 0;
     case WM_KEYUP:
-      if (window)
+      if (window) {
+        window->Record(InputEvent::Type::KEY_UP, wParam, lParam);
         window->OnKeyUp(wParam);
+      }
       return 0;
     case WM_LBUTTONDBLCLK:
-      if (window)
+      if (window) {
+        window->Record(InputEvent::Type::L_BUTTON_DOUBLE_CLICK, wParam,
+                       lParam);
         window->OnMouseLButtonDoubleClick(
             Point2d(static_cast<int16_t>(LOWORD(lParam)),
                     static_cast<int16_t>(HIWORD(lParam))) /
             window->GetPixelSize());
+      }
       return 0;
     case WM_LBUTTONDOWN:
-      if (window)
+      if (window) {
+        window->Record(InputEvent::Type::L_BUTTON_DOWN, wParam, lParam);
         window->OnMouseLButtonDown(
             Point2d(static_cast<int16_t>(LOWORD(lParam)),
                     static_cast<int16_t>(HIWORD(lParam))) /
             window->GetPixelSize());
+      }
       return 0;
     case WM_LBUTTONUP:
-      if (window)
+      if (window) {
+        window->Record(InputEvent::Type::L_BUTTON_UP, wParam, lParam);
         window->OnMouseLButtonUp(Point2d(static_cast<int16_t>(LOWORD(lParam)),
                                          static_cast<int16_t>(HIWORD(lParam))) /
                                  window->GetPixelSize());
+      }
       return 0;
     case WM_MOUSEMOVE:
-      if (window)
+      if (window) {
+        lParam = window->CoalesceMouseMoves(lParam);
+        window->Record(InputEvent::Type::MOUSE_MOVE, wParam, lParam);
         window->OnMouseMove(Point2d(static_cast<int16_t>(LOWORD(lParam)),
                                     static_cast<int16_t>(HIWORD(lParam))) /
                             window->GetPixelSize());
+      }
+      return 0;
+    case kWorkDoneMessage:
+      if (window) {
+        window->Record(InputEvent::Type::WORK_DONE, wParam, lParam);
+        window->OnWorkDone(static_cast<uint16_t>(wParam));
+      }
       return 0;
     case WM_ERASEBKGND:
       return 1;
@@ -206,46 +263,95 @@ LRESULT DrawingBoard::WndProc(HWND hWnd,
   }
 }
 
+LPARAM DrawingBoard::CoalesceMouseMoves(LPARAM lParam) {
+  ++mouse_moves_.received;
+  MSG message;
+  while (PeekMessageW(&message, window_, 0, 0, PM_NOREMOVE) &&
+         message.message == WM_MOUSEMOVE) {
+    PeekMessageW(&message, window_, WM_MOUSEMOVE, WM_MOUSEMOVE, PM_REMOVE);
+    lParam = message.lParam;
+    ++mouse_moves_.received;
+    ++mouse_moves_.coalesced;
+  }
+  return lParam;
+}
+
+void DrawingBoard::Record(InputEvent::Type type,
+                          WPARAM wParam,
+                          LPARAM lParam) {
+  if (!input_log_)
+    return;
+  InputEvent event;
+  event.type = type;
+  event.time = std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - input_log_start_)
+                   .count();
+  event.ctrl = GetKeyState(VK_CONTROL);
+  if (type == InputEvent::Type::KEY_DOWN || type == InputEvent::Type::KEY_UP) {
+    event.key_code = static_cast<uint16_t>(wParam);
+    event.was_down = (lParam >> 30) & 1;
+  } else if (type == InputEvent::Type::WORK_DONE) {
+    event.generation = static_cast<uint16_t>(wParam);
+  } else {
+    event.x = static_cast<int16_t>(LOWORD(lParam));
+    event.y = static_cast<int16_t>(HIWORD(lParam));
+  }
+  input_log_->Write(event);
+}
+
+void DrawingBoard::Update() {
+  if (damage_.Empty())
+    InvalidateAll();
+  Redraw();
+}
+
+void DrawingBoard::Redraw() {
+  if (damage_.Empty() || !renderer_ || !renderer_->Good())
+    return;
+  renderer_->Publish(controller_->TakeSnapshot(), damage_);
+  damage_ = Rect();
+}
+
 void DrawingBoard::OnMouseLButtonDown(Point2d const& mouse_pos) {
   if (controller_->OnMouseLButtonDown(this, mouse_pos)) {
-    Clear();
-    Display();
+    Update();
   }
 }
 
 void DrawingBoard::OnMouseLButtonUp(Point2d const& mouse_pos) {
   if (controller_->OnMouseLButtonUp(this, mouse_pos)) {
-    Clear();
-    Display();
+    Update();
   }
 }
 
 void DrawingBoard::OnMouseMove(Point2d const& mouse_pos) {
   if (controller_->OnMouseMove(this, mouse_pos)) {
-    Clear();
-    Display();
+    Update();
   }
   last_mouse_pos_ = mouse_pos;
 }
 
 void DrawingBoard::OnKeyDown(WPARAM key_code, bool was_down) {
   if (controller_->OnKeyDown(this, key_code, was_down)) {
-    Clear();
-    Display();
+    Update();
   }
 }
 
 void DrawingBoard::OnKeyUp(WPARAM key_code) {
   if (controller_->OnKeyUp(this, key_code)) {
-    Clear();
-    Display();
+    Update();
+  }
+}
+
+void DrawingBoard::OnWorkDone(uint16_t generation) {
+  if (controller_->OnWorkDone(this, generation)) {
+    Update();
   }
 }
 
 void DrawingBoard::OnMouseLButtonDoubleClick(Point2d const& mouse_pos) {
   if (controller_->OnMouseLButtonDoubleClick(this, mouse_pos)) {
-    Clear();
-    Display();
+    Update();
   }
 }
 }  // namespace gk
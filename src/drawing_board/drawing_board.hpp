@@ -8,11 +8,20 @@
 #undef max
 
 #include <algorithm>
+#include <chrono>
 #include <complex>
+#include <cstdint>
+#include <filesystem>
 #include <memory>
+#include <optional>
 #include <string_view>
 #include <utility>
 
+#include "framebuffer.hpp"
+#include "input_log.hpp"
+#include "rect.hpp"
+#include "renderer.hpp"
+
 namespace gk {
 class Controller;
 
@@ -42,6 +51,14 @@ class DrawingBoard {
     Coordinate y;
   };
 
+  // Mouse moves received by the window. Moves already followed by another
+  // one waiting in the message queue are skipped, so that the controller
+  // only handles the latest position.
+  struct MouseMoveStats {
+    uint64_t received = 0;
+    uint64_t coalesced = 0;
+  };
+
   static bool RegisterWindowClass(HINSTANCE hInstance);
   DrawingBoard(Size posx,
                Size posy,
@@ -54,23 +71,47 @@ class DrawingBoard {
 
   bool Show() { return ShowWindow(window_, SW_RESTORE); }
   bool Hide() { return ShowWindow(window_, SW_MINIMIZE); }
+  // Schedules a repaint of the whole board.
   void Display();
+  // Starts recording input events forwarded to the controller into a log at
+  // |path|. The log ends with the fingerprint of the scene left when the
+  // board is destroyed.
+  bool RecordInput(std::filesystem::path const& path);
+  // Forwards a recorded event to the controller just like the window would,
+  // with CTRL reported in the recorded state from now on.
+  void Replay(InputEvent const& event);
+  // Lets a worker thread of the controller report that work identified by
+  // |generation| is done. Controller::OnWorkDone() is then called on the UI
+  // thread, in order with input events, so that input logs reproduce when
+  // the work was picked up. Can be called from any thread.
+  void PostWorkDone(uint16_t generation);
+  // Message posted by PostWorkDone().
+  static constexpr UINT kWorkDoneMessage = WM_APP;
 
   Size GetPixelSize() const { return pixel_size_; }
   Size GetWidth() const { return drawing_board_width_; }
   Size GetHeight() const { return drawing_board_height_; }
 
-  void Clear();
-  void SetPixel(Coordinate x, Coordinate y, COLORREF color);
-  void DrawTxt(Coordinate posx,
-               Coordinate posy,
-               std::wstring_view text,
-               Size font_size,
-               COLORREF color);
+  static constexpr Framebuffer::Pixel ToPixel(COLORREF color) {
+    return Framebuffer::MakePixel(GetRValue(color), GetGValue(color),
+                                  GetBValue(color));
+  }
+  Renderer* GetRenderer() { return renderer_.get(); }
+
+  // Marks |rect| as damaged. Once the current event has been handled, the
+  // controller is asked for a snapshot of the scene and the render thread
+  // redraws the damaged area from it.
+  void Invalidate(Rect const& rect);
+  void InvalidateAll();
   void ShowError(std::wstring_view error_message, bool fatal);
   void SetTitle(std::wstring_view new_title);
+  // Position of the last mouse move handled by the controller, which might
+  // be followed by coalesced moves.
   Point2d const& GetPreviousMousePos() const { return last_mouse_pos_; }
+  MouseMoveStats const& GetMouseMoveStats() const { return mouse_moves_; }
   bool GetKeyState(int key_id) const {
+    if (key_id == VK_CONTROL && replayed_ctrl_.has_value())
+      return replayed_ctrl_.value();
     return GetAsyncKeyState(key_id) & 1 << (sizeof(SHORT) * 8 - 1);
   }
 
@@ -79,12 +120,26 @@ class DrawingBoard {
                                   UINT message,
                                   WPARAM wParam,
                                   LPARAM lParam);
+  // Removes mouse moves waiting right after the current one, |lParam|, from
+  // the message queue and returns the parameter of the latest one. Windows
+  // synthesizes WM_MOUSEMOVE only when no posted messages are waiting and
+  // merges it with the previous one itself, so this mostly skips moves that
+  // were posted, e.g. by replay_bench --rate, not moves of a fast mouse.
+  LPARAM CoalesceMouseMoves(LPARAM lParam);
+  // Adds an event with given message parameters to the input log, if any.
+  void Record(InputEvent::Type type, WPARAM wParam, LPARAM lParam);
   void OnMouseLButtonDown(Point2d const& mouse_pos);
   void OnMouseLButtonUp(Point2d const& mouse_pos);
   void OnMouseLButtonDoubleClick(Point2d const& mouse_pos);
   void OnMouseMove(Point2d const& mouse_pos);
   void OnKeyDown(WPARAM key_code, bool was_down);
   void OnKeyUp(WPARAM key_code);
+  void OnWorkDone(uint16_t generation);
+  // Redraws damaged area. If the controller requested an update without
+  // reporting any damage, the whole board is redrawn.
+  void Update();
+  // Publishes a snapshot of the scene to be drawn over damaged area.
+  void Redraw();
 
   HWND window_;
   HDC window_hdc_;
@@ -93,13 +148,18 @@ class DrawingBoard {
   const Size drawing_board_width_;
   const Size drawing_board_height_;
 
-  HDC hdc_mem_;
-  HBITMAP off_screen_bitmap_;
+  std::unique_ptr<Renderer> renderer_;
+  Rect damage_;
 
   Point2d last_mouse_pos_;
+  MouseMoveStats mouse_moves_;
 
   std::unique_ptr<Controller> controller_;
 
+  std::unique_ptr<InputLogWriter> input_log_;
+  std::chrono::steady_clock::time_point input_log_start_;
+  std::optional<bool> replayed_ctrl_;
+
   // Disallow copy and assign
   DrawingBoard& operator=(DrawingBoard&) = delete;
   DrawingBoard(DrawingBoard&) = delete;
@@ -0,0 +1,29 @@
+// Copyright Wojciech Replin 2019
+
+#include "framebuffer.hpp"
+
+#include <algorithm>
+
+namespace gk {
+void Framebuffer::Fill(Pixel color) {
+  if (clip_.Empty())
+    return;
+  for (Size y = clip_.top; y < clip_.bottom; ++y)
+    std::fill_n(GetRow(y) + clip_.left, clip_.Width(), color);
+}
+
+void Framebuffer::Attach(Pixel* pixels, Size width, Size height, Size stride) {
+  pixels_ = pixels;
+  width_ = width;
+  height_ = height;
+  stride_ = stride;
+  ResetClipRect();
+}
+
+MemoryFramebuffer::MemoryFramebuffer(Size width, Size height)
+    : storage_(static_cast<size_t>(std::max(width, 0)) * std::max(height, 0)) {
+  Attach(storage_.data(), width, height, width);
+}
+
+MemoryFramebuffer::~MemoryFramebuffer() = default;
+}  // namespace gk
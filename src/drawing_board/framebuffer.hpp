@@ -0,0 +1,77 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "rect.hpp"
+
+namespace gk {
+// Raw, directly addressable 32-bit pixel buffer. Pixels are stored top-down,
+// row by row, in 0x00RRGGBB format. Stride is expressed in pixels and may be
+// larger than width. All writes are restricted to the current clip rectangle,
+// which by default covers the whole buffer.
+class Framebuffer {
+ public:
+  using Pixel = std::uint32_t;
+  using Size = int;
+
+  static constexpr Pixel MakePixel(std::uint8_t r,
+                                   std::uint8_t g,
+                                   std::uint8_t b) {
+    return static_cast<Pixel>(r) << 16 | static_cast<Pixel>(g) << 8 | b;
+  }
+
+  virtual ~Framebuffer() = default;
+
+  Pixel* GetPixels() { return pixels_; }
+  Pixel const* GetPixels() const { return pixels_; }
+  Pixel* GetRow(Size y) { return pixels_ + y * stride_; }
+  Pixel const* GetRow(Size y) const { return pixels_ + y * stride_; }
+  Size GetWidth() const { return width_; }
+  Size GetHeight() const { return height_; }
+  Size GetStride() const { return stride_; }
+
+  Rect GetBounds() const { return {0, 0, width_, height_}; }
+  Rect const& GetClipRect() const { return clip_; }
+  void SetClipRect(Rect const& clip) { clip_ = clip.Intersection(GetBounds()); }
+  void ResetClipRect() { clip_ = GetBounds(); }
+
+  bool Contains(int x, int y) const { return clip_.Contains(x, y); }
+  void SetPixel(int x, int y, Pixel color) {
+    if (Contains(x, y))
+      GetRow(y)[x] = color;
+  }
+  Pixel GetPixel(int x, int y) const { return GetRow(y)[x]; }
+  // Fills the clip rectangle with |color|.
+  void Fill(Pixel color);
+
+ protected:
+  Framebuffer() = default;
+  // Has to be called by implementations once the memory is available.
+  void Attach(Pixel* pixels, Size width, Size height, Size stride);
+
+ private:
+  Pixel* pixels_ = nullptr;
+  Size width_ = 0;
+  Size height_ = 0;
+  Size stride_ = 0;
+  Rect clip_;
+
+  // Disallow copy and assign
+  Framebuffer& operator=(Framebuffer&) = delete;
+  Framebuffer(Framebuffer&) = delete;
+};
+
+// Portable framebuffer living in ordinary heap memory. Does not depend on
+// any windowing system, so it can be used for off-screen rendering.
+class MemoryFramebuffer : public Framebuffer {
+ public:
+  MemoryFramebuffer(Size width, Size height);
+  ~MemoryFramebuffer() override;
+
+ private:
+  std::vector<Pixel> storage_;
+};
+}  // namespace gk
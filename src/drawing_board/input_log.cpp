@@ -0,0 +1,162 @@
+// Copyright Wojciech Replin 2019
+
+#include "input_log.hpp"
+
+#include <algorithm>
+
+namespace gk {
+namespace {
+constexpr char kMagic[] = {'G', 'K', 'I', 'L'};
+constexpr char kVersion = 2;
+
+// First byte of an event keeps its type in the low bits, followed by flags.
+constexpr uint8_t kTypeMask = 0x0f;
+constexpr uint8_t kCtrlFlag = 0x10;
+constexpr uint8_t kWasDownFlag = 0x20;
+// Type of the record ending a finished log.
+constexpr uint8_t kEnd = 0x0f;
+
+bool IsMouseEvent(InputEvent::Type type) {
+  return type <= InputEvent::Type::MOUSE_MOVE;
+}
+
+// Maps signed differences to small unsigned values.
+uint64_t ZigZag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^ (value < 0 ? ~0ull : 0ull);
+}
+
+int64_t UnZigZag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+}  // namespace
+
+InputLogWriter::InputLogWriter(std::filesystem::path const& path,
+                               InputLogHeader const& header)
+    : out_(path, std::ios::binary | std::ios::trunc) {
+  out_.write(kMagic, sizeof(kMagic));
+  out_.put(kVersion);
+  WriteVarint(header.width);
+  WriteVarint(header.height);
+  WriteVarint(header.pixel_size);
+}
+
+void InputLogWriter::Write(InputEvent const& event) {
+  uint8_t tag = static_cast<uint8_t>(event.type);
+  if (event.ctrl)
+    tag |= kCtrlFlag;
+  if (event.was_down)
+    tag |= kWasDownFlag;
+  out_.put(static_cast<char>(tag));
+  WriteVarint(
+      static_cast<uint64_t>(std::max<int64_t>(event.time - last_.time, 0)));
+  if (IsMouseEvent(event.type)) {
+    WriteVarint(ZigZag(event.x - last_.x));
+    WriteVarint(ZigZag(event.y - last_.y));
+    last_.x = event.x;
+    last_.y = event.y;
+  } else if (event.type == InputEvent::Type::WORK_DONE) {
+    WriteVarint(event.generation);
+  } else {
+    WriteVarint(event.key_code);
+  }
+  last_.time = std::max(event.time, last_.time);
+}
+
+void InputLogWriter::Finish(uint64_t fingerprint) {
+  out_.put(static_cast<char>(kEnd));
+  for (int i = 0; i < 8; ++i)
+    out_.put(static_cast<char>(fingerprint >> (i * 8)));
+  out_.flush();
+}
+
+void InputLogWriter::WriteVarint(uint64_t value) {
+  while (value >= 0x80) {
+    out_.put(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out_.put(static_cast<char>(value));
+}
+
+InputLogReader::InputLogReader(std::filesystem::path const& path)
+    : in_(path, std::ios::binary) {
+  char magic[sizeof(kMagic)];
+  if (!in_.read(magic, sizeof(magic)) ||
+      !std::equal(magic, magic + sizeof(magic), kMagic) ||
+      in_.get() != kVersion) {
+    return;
+  }
+  const auto width = ReadVarint();
+  const auto height = ReadVarint();
+  const auto pixel_size = ReadVarint();
+  if (!width.has_value() || !height.has_value() || !pixel_size.has_value())
+    return;
+  header_ = InputLogHeader{static_cast<int>(width.value()),
+                           static_cast<int>(height.value()),
+                           static_cast<int>(pixel_size.value())};
+}
+
+std::optional<InputEvent> InputLogReader::Next() {
+  if (!header_.has_value() || fingerprint_.has_value())
+    return std::nullopt;
+  const int tag = in_.get();
+  if (tag == std::char_traits<char>::eof())
+    return std::nullopt;
+  if ((tag & kTypeMask) == kEnd) {
+    uint64_t fingerprint = 0;
+    for (int i = 0; i < 8; ++i) {
+      const int byte = in_.get();
+      if (byte == std::char_traits<char>::eof())
+        return std::nullopt;
+      fingerprint |= static_cast<uint64_t>(byte) << (i * 8);
+    }
+    fingerprint_ = fingerprint;
+    return std::nullopt;
+  }
+  if ((tag & kTypeMask) > static_cast<int>(InputEvent::Type::WORK_DONE))
+    return std::nullopt;
+
+  InputEvent event;
+  event.type = static_cast<InputEvent::Type>(tag & kTypeMask);
+  event.ctrl = tag & kCtrlFlag;
+  event.was_down = tag & kWasDownFlag;
+  const auto time = ReadVarint();
+  if (!time.has_value())
+    return std::nullopt;
+  event.time = last_.time + static_cast<int64_t>(time.value());
+  if (IsMouseEvent(event.type)) {
+    const auto dx = ReadVarint();
+    const auto dy = ReadVarint();
+    if (!dx || !dy)
+      return std::nullopt;
+    event.x = static_cast<int16_t>(last_.x + UnZigZag(dx.value()));
+    event.y = static_cast<int16_t>(last_.y + UnZigZag(dy.value()));
+  } else {
+    const auto value = ReadVarint();
+    if (!value.has_value())
+      return std::nullopt;
+    if (event.type == InputEvent::Type::WORK_DONE)
+      event.generation = static_cast<uint16_t>(value.value());
+    else
+      event.key_code = static_cast<uint16_t>(value.value());
+  }
+  last_.time = event.time;
+  if (IsMouseEvent(event.type)) {
+    last_.x = event.x;
+    last_.y = event.y;
+  }
+  return event;
+}
+
+std::optional<uint64_t> InputLogReader::ReadVarint() {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    const int byte = in_.get();
+    if (byte == std::char_traits<char>::eof())
+      return std::nullopt;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return value;
+  }
+  return std::nullopt;
+}
+}  // namespace gk
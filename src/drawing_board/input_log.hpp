@@ -0,0 +1,101 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+
+namespace gk {
+// Input event forwarded by DrawingBoard to its controller.
+struct InputEvent {
+  enum class Type : uint8_t {
+    // Position of the cursor when the recording started, only sets the
+    // previous mouse position.
+    CURSOR,
+    L_BUTTON_DOWN,
+    L_BUTTON_UP,
+    L_BUTTON_DOUBLE_CLICK,
+    MOUSE_MOVE,
+    KEY_DOWN,
+    KEY_UP,
+    // Work the controller started on another thread is done, see
+    // DrawingBoard::PostWorkDone().
+    WORK_DONE,
+  };
+  Type type;
+  // Microseconds since the recording started.
+  int64_t time = 0;
+  // State of CTRL key when the event was handled.
+  bool ctrl = false;
+  // Mouse position in window pixels, for mouse events.
+  int16_t x = 0, y = 0;
+  // Key events only.
+  uint16_t key_code = 0;
+  bool was_down = false;
+  // WORK_DONE only.
+  uint16_t generation = 0;
+};
+
+// Size of the board whose input is logged.
+struct InputLogHeader {
+  int width;
+  int height;
+  int pixel_size;
+};
+
+// Writes a log of input events. The log is compact, since events only store
+// differences from the previous event, e.g. a typical mouse move takes five
+// bytes.
+class InputLogWriter {
+ public:
+  InputLogWriter(std::filesystem::path const& path,
+                 InputLogHeader const& header);
+
+  bool Good() const { return out_.good(); }
+  void Write(InputEvent const& event);
+  // Ends the log with a fingerprint of the final scene, which replays have
+  // to reproduce. Logs which weren't finished can be replayed, but not
+  // verified.
+  void Finish(uint64_t fingerprint);
+
+ private:
+  void WriteVarint(uint64_t value);
+
+  std::ofstream out_;
+  InputEvent last_ = {};
+
+  // Disallow copy and assign
+  InputLogWriter& operator=(InputLogWriter&) = delete;
+  InputLogWriter(InputLogWriter&) = delete;
+};
+
+// Reads a log written by InputLogWriter.
+class InputLogReader {
+ public:
+  explicit InputLogReader(std::filesystem::path const& path);
+
+  // False if the file isn't an input log.
+  bool Good() const { return header_.has_value(); }
+  InputLogHeader const& GetHeader() const { return header_.value(); }
+  // Returns events in order, nothing once the log ends or turns out to be
+  // truncated or corrupted.
+  std::optional<InputEvent> Next();
+  // Fingerprint of the final scene, known once Next() reached the end of a
+  // finished log.
+  std::optional<uint64_t> GetFingerprint() const { return fingerprint_; }
+
+ private:
+  std::optional<uint64_t> ReadVarint();
+
+  std::ifstream in_;
+  std::optional<InputLogHeader> header_;
+  std::optional<uint64_t> fingerprint_;
+  InputEvent last_ = {};
+
+  // Disallow copy and assign
+  InputLogReader& operator=(InputLogReader&) = delete;
+  InputLogReader(InputLogReader&) = delete;
+};
+}  // namespace gk
@@ -0,0 +1,110 @@
+// Copyright Wojciech Replin 2019
+
+#include "label_cache.hpp"
+
+#undef min
+#undef max
+
+#include <algorithm>
+
+#include "dib_framebuffer.hpp"
+
+namespace gk {
+namespace {
+// Labels carry constraint ids, so the cache could grow without bounds in
+// a long session. Start over once it gets this big.
+constexpr size_t kMaxLabels = 4096;
+}  // namespace
+
+void LabelCache::Label::Draw(Framebuffer* framebuffer, int x, int y) const {
+  const auto& clip = framebuffer->GetClipRect();
+  if (!clip.Intersects(Rect(x, y, x + width_, y + height_)))
+    return;
+  for (auto const& span : spans_) {
+    const int row = y + span.y;
+    if (row < clip.top || row >= clip.bottom)
+      continue;
+    const int begin = std::max(x + span.x, clip.left);
+    const int end = std::min(x + span.x + span.length, clip.right);
+    if (begin < end)
+      std::fill(framebuffer->GetRow(row) + begin,
+                framebuffer->GetRow(row) + end, color_);
+  }
+}
+
+LabelCache::LabelCache(HDC hdc) : hdc_(CreateCompatibleDC(hdc)) {
+  SetBkMode(hdc_, TRANSPARENT);
+  SetTextColor(hdc_, RGB(255, 255, 255));
+}
+
+LabelCache::~LabelCache() {
+  for (auto& font : fonts_)
+    DeleteObject(font.second);
+  DeleteDC(hdc_);
+}
+
+LabelCache::Label const& LabelCache::Get(std::wstring_view text,
+                                         Size font_size,
+                                         COLORREF color) {
+  const auto it = labels_.find(std::make_tuple(font_size, color, text));
+  if (it != labels_.end())
+    return it->second;
+  if (labels_.size() >= kMaxLabels)
+    labels_.clear();
+  return labels_
+      .emplace(std::make_tuple(font_size, color, std::wstring(text)),
+               Rasterize(text, font_size, color))
+      .first->second;
+}
+
+HFONT LabelCache::GetFont(Size font_size) {
+  auto& font = fonts_[font_size];
+  if (!font)
+    font = CreateFont(font_size, 0, 0, 0, FW_THIN, FALSE, FALSE, FALSE,
+                      DEFAULT_CHARSET, OUT_OUTLINE_PRECIS, CLIP_DEFAULT_PRECIS,
+                      NONANTIALIASED_QUALITY, VARIABLE_PITCH, TEXT("arial"));
+  return font;
+}
+
+LabelCache::Label LabelCache::Rasterize(std::wstring_view text,
+                                        Size font_size,
+                                        COLORREF color) {
+  Label label;
+  label.color_ = Framebuffer::MakePixel(GetRValue(color), GetGValue(color),
+                                        GetBValue(color));
+  const HGDIOBJ old_font = SelectObject(hdc_, GetFont(font_size));
+  RECT rect = {0, 0, 0, 0};
+  DrawTextW(hdc_, text.data(), static_cast<int>(text.length()), &rect,
+            DT_NOCLIP | DT_CALCRECT);
+  DibFramebuffer scratch(hdc_, rect.right - rect.left,
+                         rect.bottom - rect.top);
+  if (!scratch.GetPixels()) {
+    SelectObject(hdc_, old_font);
+    return label;
+  }
+  const HGDIOBJ old_bitmap = SelectObject(hdc_, scratch.GetBitmap());
+  scratch.Fill(0);
+  DrawTextW(hdc_, text.data(), static_cast<int>(text.length()), &rect,
+            DT_NOCLIP);
+  GdiFlush();
+  SelectObject(hdc_, old_bitmap);
+  SelectObject(hdc_, old_font);
+
+  label.width_ = scratch.GetWidth();
+  label.height_ = scratch.GetHeight();
+  for (int y = 0; y < label.height_; ++y) {
+    const auto* row = scratch.GetRow(y);
+    for (int x = 0; x < label.width_;) {
+      if (!row[x]) {
+        ++x;
+        continue;
+      }
+      const int begin = x;
+      while (x < label.width_ && row[x])
+        ++x;
+      label.spans_.push_back({begin, y, x - begin});
+    }
+  }
+  return label;
+}
+}  // namespace gk
@@ -0,0 +1,60 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+#include <Windows.h>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "framebuffer.hpp"
+
+namespace gk {
+// Keeps pre-rasterized text labels, so that GDI is involved only the first
+// time a given label is drawn. Fonts are created once per size and kept for
+// the lifetime of the cache.
+class LabelCache {
+ public:
+  using Size = int;
+  class Label {
+   public:
+    // Copies the label into |framebuffer| with its top left corner at (x, y).
+    void Draw(Framebuffer* framebuffer, int x, int y) const;
+    Size GetWidth() const { return width_; }
+    Size GetHeight() const { return height_; }
+
+   private:
+    friend class LabelCache;
+    // Horizontal run of lit pixels.
+    struct Span {
+      int x, y, length;
+    };
+    Size width_ = 0;
+    Size height_ = 0;
+    Framebuffer::Pixel color_ = 0;
+    std::vector<Span> spans_;
+  };
+
+  explicit LabelCache(HDC hdc);
+  ~LabelCache();
+
+  Label const& Get(std::wstring_view text, Size font_size, COLORREF color);
+
+ private:
+  HFONT GetFont(Size font_size);
+  Label Rasterize(std::wstring_view text, Size font_size, COLORREF color);
+
+  HDC hdc_;
+  std::map<Size, HFONT> fonts_;
+  std::map<std::tuple<Size, COLORREF, std::wstring>, Label, std::less<>>
+      labels_;
+
+  // Disallow copy and assign
+  LabelCache& operator=(LabelCache&) = delete;
+  LabelCache(LabelCache&) = delete;
+};
+}  // namespace gk
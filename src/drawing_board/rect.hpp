@@ -0,0 +1,52 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+#include <algorithm>
+
+namespace gk {
+// Axis aligned rectangle in pixel coordinates. Right and bottom edges are
+// exclusive.
+struct Rect {
+  Rect() = default;
+  Rect(int left, int top, int right, int bottom)
+      : left(left), top(top), right(right), bottom(bottom) {}
+
+  bool operator==(Rect const& r) const {
+    return left == r.left && top == r.top && right == r.right &&
+           bottom == r.bottom;
+  }
+  bool operator!=(Rect const& r) const { return !(*this == r); }
+  bool Empty() const { return left >= right || top >= bottom; }
+  int Width() const { return right - left; }
+  int Height() const { return bottom - top; }
+  bool Contains(int x, int y) const {
+    return x >= left && x < right && y >= top && y < bottom;
+  }
+  bool Contains(Rect const& r) const {
+    return r.left >= left && r.right <= right && r.top >= top &&
+           r.bottom <= bottom;
+  }
+  bool Intersects(Rect const& r) const {
+    return !Empty() && !r.Empty() && left < r.right && r.left < right &&
+           top < r.bottom && r.top < bottom;
+  }
+  Rect Intersection(Rect const& r) const {
+    return {std::max(left, r.left), std::max(top, r.top),
+            std::min(right, r.right), std::min(bottom, r.bottom)};
+  }
+  Rect Union(Rect const& r) const {
+    if (Empty())
+      return r;
+    if (r.Empty())
+      return *this;
+    return {std::min(left, r.left), std::min(top, r.top),
+            std::max(right, r.right), std::max(bottom, r.bottom)};
+  }
+
+  int left = 0;
+  int top = 0;
+  int right = 0;
+  int bottom = 0;
+};
+}  // namespace gk
@@ -0,0 +1,144 @@
+// Copyright Wojciech Replin 2019
+
+#include "renderer.hpp"
+
+#include <utility>
+
+namespace gk {
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr Framebuffer::Pixel kBackground = Framebuffer::MakePixel(0, 0, 0);
+
+Clock::duration ToFrameInterval(double frames_per_second) {
+  if (frames_per_second <= 0)
+    return Clock::duration::zero();
+  return std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1 / frames_per_second));
+}
+
+double Seconds(Clock::duration duration) {
+  return std::chrono::duration<double>(duration).count();
+}
+}  // namespace
+
+Renderer::Renderer(HDC window_hdc, Size width, Size height, Size pixel_size)
+    : window_hdc_(window_hdc),
+      pixel_size_(pixel_size),
+      hdc_mem_(CreateCompatibleDC(window_hdc)),
+      old_bitmap_(NULL),
+      framebuffer_(std::make_unique<DibFramebuffer>(hdc_mem_, width, height)),
+      frame_interval_(ToFrameInterval(kDefaultFrameRate)) {
+  if (!Good())
+    return;
+  old_bitmap_ = SelectObject(hdc_mem_, framebuffer_->GetBitmap());
+  label_cache_ = std::make_unique<LabelCache>(hdc_mem_);
+  thread_ = std::thread(&Renderer::Run, this);
+}
+
+Renderer::~Renderer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_up_.notify_one();
+  if (thread_.joinable())
+    thread_.join();
+  label_cache_.reset();
+  if (old_bitmap_)
+    SelectObject(hdc_mem_, old_bitmap_);
+  framebuffer_.reset();
+  DeleteDC(hdc_mem_);
+}
+
+void Renderer::SetFrameRate(double frames_per_second) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  frame_interval_ = ToFrameInterval(frames_per_second);
+}
+
+void Renderer::SetFrameCallback(FrameCallback callback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  frame_callback_ = std::move(callback);
+}
+
+void Renderer::Publish(std::shared_ptr<const Snapshot> snapshot,
+                       Rect const& damage) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ = std::move(snapshot);
+    pending_damage_ = pending_damage_.Union(damage);
+    ++stats_.published;
+  }
+  wake_up_.notify_one();
+}
+
+void Renderer::WaitUntilIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this] {
+    return !thread_.joinable() || (!pending_ && !drawing_);
+  });
+}
+
+Renderer::Stats Renderer::GetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void Renderer::Run() {
+  auto next_frame = Clock::now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    wake_up_.wait(lock, [this] { return stop_ || pending_; });
+    if (stop_)
+      return;
+    // Snapshots published in the meantime replace the pending one.
+    if (Clock::now() < next_frame) {
+      wake_up_.wait_until(lock, next_frame, [this] { return stop_; });
+      if (stop_)
+        return;
+    }
+    const auto snapshot = std::move(pending_);
+    const Rect damage = pending_damage_;
+    pending_damage_ = Rect();
+    drawing_ = true;
+    next_frame = Clock::now() + frame_interval_;
+    lock.unlock();
+
+    DrawFrame(*snapshot, damage);
+
+    lock.lock();
+    drawing_ = false;
+    ++stats_.frames;
+    if (!pending_)
+      idle_.notify_all();
+  }
+}
+
+void Renderer::DrawFrame(Snapshot const& snapshot, Rect const& damage) {
+  const auto start = Clock::now();
+  framebuffer_->SetClipRect(damage);
+  const Rect clip = framebuffer_->GetClipRect();
+  if (!clip.Empty()) {
+    framebuffer_->Fill(kBackground);
+    Canvas canvas(framebuffer_.get(), label_cache_.get());
+    snapshot.Draw(&canvas);
+  }
+  const auto drawn = Clock::now();
+  if (!clip.Empty()) {
+    StretchBlt(window_hdc_, clip.left * pixel_size_, clip.top * pixel_size_,
+               clip.Width() * pixel_size_, clip.Height() * pixel_size_,
+               hdc_mem_, clip.left, clip.top, clip.Width(), clip.Height(),
+               SRCCOPY);
+  }
+  framebuffer_->ResetClipRect();
+  const auto blitted = Clock::now();
+
+  FrameCallback callback;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    callback = frame_callback_;
+  }
+  if (callback)
+    callback(Seconds(drawn - start), Seconds(blitted - drawn));
+}
+}  // namespace gk
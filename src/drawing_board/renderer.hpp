@@ -0,0 +1,88 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+#include <Windows.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "dib_framebuffer.hpp"
+#include "label_cache.hpp"
+#include "rect.hpp"
+#include "snapshot.hpp"
+
+namespace gk {
+// Draws snapshots of the scene onto a window on its own thread, so that
+// handling input never waits for rasterization. Snapshots are triple
+// buffered: one is being drawn, the latest one published waits for the next
+// frame and the controller builds another one. Publishing never blocks, a
+// snapshot published before the previous one got drawn replaces it and
+// their damage is merged.
+class Renderer {
+ public:
+  using Size = int;
+  static constexpr double kDefaultFrameRate = 60;
+  // Raster and blit time of a frame, in seconds.
+  using FrameCallback = std::function<void(double raster, double blit)>;
+
+  // Draws |width| x |height| pixels, each of them scaled to |pixel_size|
+  // pixels of |window_hdc|.
+  Renderer(HDC window_hdc, Size width, Size height, Size pixel_size);
+  // Stops the render thread, dropping snapshots which weren't drawn.
+  ~Renderer();
+
+  // False if the framebuffer couldn't be created.
+  bool Good() const { return framebuffer_->GetPixels() != nullptr; }
+  // Frames start at most |frames_per_second| times a second, zero draws
+  // every snapshot as soon as the previous frame is done.
+  void SetFrameRate(double frames_per_second);
+  // Called on the render thread after each frame.
+  void SetFrameCallback(FrameCallback callback);
+
+  // Schedules |damage| to be redrawn from |snapshot|.
+  void Publish(std::shared_ptr<const Snapshot> snapshot, Rect const& damage);
+  // Waits until all published snapshots are drawn or dropped.
+  void WaitUntilIdle();
+
+  struct Stats {
+    uint64_t published = 0;
+    uint64_t frames = 0;
+  };
+  Stats GetStats();
+
+ private:
+  void Run();
+  void DrawFrame(Snapshot const& snapshot, Rect const& damage);
+
+  HDC window_hdc_;
+  const Size pixel_size_;
+  HDC hdc_mem_;
+  HGDIOBJ old_bitmap_;
+  std::unique_ptr<DibFramebuffer> framebuffer_;
+  std::unique_ptr<LabelCache> label_cache_;
+
+  // Guards members below.
+  std::mutex mutex_;
+  std::condition_variable wake_up_;
+  std::condition_variable idle_;
+  std::shared_ptr<const Snapshot> pending_;
+  Rect pending_damage_;
+  bool drawing_ = false;
+  bool stop_ = false;
+  std::chrono::steady_clock::duration frame_interval_;
+  FrameCallback frame_callback_;
+  Stats stats_;
+
+  std::thread thread_;
+
+  // Disallow copy and assign
+  Renderer& operator=(Renderer&) = delete;
+  Renderer(Renderer&) = delete;
+};
+}  // namespace gk
@@ -0,0 +1,46 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+#include <Windows.h>
+
+#include <string_view>
+
+#include "framebuffer.hpp"
+#include "label_cache.hpp"
+
+namespace gk {
+// What snapshots are drawn onto: a framebuffer clipped to the damaged area
+// and text labels.
+class Canvas {
+ public:
+  using Size = int;
+
+  Canvas(Framebuffer* framebuffer, LabelCache* label_cache)
+      : framebuffer_(framebuffer), label_cache_(label_cache) {}
+
+  Framebuffer* GetFramebuffer() { return framebuffer_; }
+  void DrawTxt(int posx,
+               int posy,
+               std::wstring_view text,
+               Size font_size,
+               COLORREF color) {
+    label_cache_->Get(text, font_size, color).Draw(framebuffer_, posx, posy);
+  }
+
+ private:
+  Framebuffer* framebuffer_;
+  LabelCache* label_cache_;
+};
+
+// Immutable picture of a scene. Snapshots are taken by the controller after
+// every change and drawn by the render thread, while the controller goes on
+// changing the scene.
+class Snapshot {
+ public:
+  virtual ~Snapshot() = default;
+  // Draws the area inside the canvas' clip rect, which has been cleared.
+  // Called on the render thread.
+  virtual void Draw(Canvas* canvas) const = 0;
+};
+}  // namespace gk
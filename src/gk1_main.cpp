@@ -2,7 +2,9 @@
 
 #include <Windows.h>
 
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "./controller/polygon_controller.hpp"
@@ -42,7 +44,7 @@ int WINAPI wWinMain(HINSTANCE hInstance,
   gk::DrawingBoard::Size Width = 800;
   gk::DrawingBoard::Size Height = 400;
 
-  const auto args = SplitString(pCmdLine, ' ', 5);
+  const auto args = SplitString(pCmdLine, ' ', 8);
   switch (args.size()) {
     default:
     case 5:
@@ -60,10 +62,17 @@ int WINAPI wWinMain(HINSTANCE hInstance,
     case 0:
       break;
   }
+  auto controller = std::make_unique<gk::PolygonController>();
+  // "-" skips an optional path, so that later ones can be given.
+  if (args.size() > 6 && args[6] != L"-")
+    controller->SetScenePath(args[6]);
+  if (args.size() > 7 && args[7] != L"-")
+    controller->SetImportPath(args[7]);
   gk::DrawingBoard::RegisterWindowClass(hInstance);
   gk::DrawingBoard window(Posx, Posy, Width / PixelSize, Height / PixelSize,
-                          PixelSize, hInstance,
-                          std::make_unique<gk::PolygonController>());
+                          PixelSize, hInstance, std::move(controller));
+  if (args.size() > 5 && args[5] != L"-" && !window.RecordInput(args[5]))
+    window.ShowError(L"Could not create the input log.", false);
   window.Show();
   RunMessageLoop();
   return 0;
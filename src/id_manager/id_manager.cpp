@@ -2,30 +2,45 @@
 
 #include "id_manager.hpp"
 
-#include <set>
+#include <thread>
 
 namespace gk {
-namespace id_manager {
-namespace {
-std::set<ID> used_ids_;
-}  // namespace
-ID Get() {
-  ID ret =  1;
-  for (auto id : used_ids_)
-    if (id == ret) {
-      ++ret;
-    } else {
-      used_ids_.insert(ret);
-      return ret;
-    }
-  used_ids_.insert(ret);
+IdManager::ID SequentialIdManager::Get() {
+  ID ret;
+  if (free_ids_.empty()) {
+    ret = next_id_++;
+    used_ids_.push_back(true);
+  } else {
+    ret = free_ids_.top();
+    free_ids_.pop();
+    used_ids_[ret] = true;
+  }
   return ret;
 }
 
-void Release(ID id) {
-  auto it = std::find(used_ids_.begin(), used_ids_.end(), id);
-  if (it != used_ids_.end())
-    used_ids_.erase(it);
+void SequentialIdManager::Release(ID id) {
+  if (id >= used_ids_.size() || !used_ids_[id])
+    return;
+  used_ids_[id] = false;
+  free_ids_.push(id);
+}
+
+IdManager::ID ConcurrentIdManager::Get() {
+  const auto shard = static_cast<ID>(
+      std::hash<std::thread::id>()(std::this_thread::get_id()) % kShards);
+  ID local;
+  {
+    std::lock_guard<std::mutex> lock(shards_[shard].mutex);
+    local = shards_[shard].ids.Get();
+  }
+  return (local - 1) * kShards + shard + 1;
+}
+
+void ConcurrentIdManager::Release(ID id) {
+  if (id == 0)
+    return;
+  auto& shard = shards_[(id - 1) % kShards];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.ids.Release((id - 1) / kShards + 1);
 }
-}  // namespace id_manager
 }  // namespace gk
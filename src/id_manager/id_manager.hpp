@@ -2,10 +2,82 @@
 
 #pragma once
 
+#include <array>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <vector>
+
 namespace gk {
-namespace id_manager {
-using ID = unsigned int;
-ID Get();
-void Release(ID id);
-}  // namespace id_manager
+// Hands out constraint ids, which are shown in labels. Each scene owns its
+// own manager.
+class IdManager {
+ public:
+  using ID = unsigned int;
+
+  virtual ~IdManager() = default;
+
+  // Returns a free id, never 0.
+  virtual ID Get() = 0;
+  // Releasing an id which isn't in use does nothing.
+  virtual void Release(ID id) = 0;
+};
+
+// Hands out the smallest id not in use, starting from 1. Both calls take
+// O(log n) time. Not thread-safe, see ConcurrentIdManager.
+class SequentialIdManager : public IdManager {
+ public:
+  SequentialIdManager() = default;
+  ~SequentialIdManager() override = default;
+
+  // Overridden from IdManager
+  ID Get() override;
+  void Release(ID id) override;
+
+ private:
+  // Ids below |next_id_| are either used or in |free_ids_|, all the ones
+  // above are free, so the smallest free id is on top of the heap or is
+  // |next_id_| itself.
+  ID next_id_ = 1;
+  std::priority_queue<ID, std::vector<ID>, std::greater<ID>> free_ids_;
+  // Indexed by id, tells whether releasing it is legal.
+  std::vector<bool> used_ids_ = std::vector<bool>(1, false);
+
+  // Disallow copy and assign
+  SequentialIdManager& operator=(SequentialIdManager&) = delete;
+  SequentialIdManager(SequentialIdManager&) = delete;
+};
+
+// Thread-safe manager for threads creating constraints at the same time.
+// Ids are split into shards by their remainder modulo the number of
+// shards, each shard guarded by its own lock. A thread takes ids from the
+// shard its id hashes to, so threads rarely wait for each other. Each shard
+// hands out its smallest free id, thus ids stay small, but aren't the
+// smallest free ones overall.
+class ConcurrentIdManager : public IdManager {
+ public:
+  ConcurrentIdManager() = default;
+  ~ConcurrentIdManager() override = default;
+
+  // Overridden from IdManager
+  ID Get() override;
+  void Release(ID id) override;
+
+  static constexpr ID kShards = 16;
+
+ private:
+  // Aligned, so that shards used by different threads don't share cache
+  // lines.
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    // Hands out local ids, local id i of shard s is id
+    // (i - 1) * kShards + s + 1.
+    SequentialIdManager ids;
+  };
+  std::array<Shard, kShards> shards_;
+
+  // Disallow copy and assign
+  ConcurrentIdManager& operator=(ConcurrentIdManager&) = delete;
+  ConcurrentIdManager(ConcurrentIdManager&) = delete;
+};
 }  // namespace gk
@@ -0,0 +1,153 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace gk {
+// Arrays of |Ts|, all of the same size, kept one after another in a single
+// block of memory. However many arrays there are, they are allocated,
+// copied and released at once, which takes a single allocation.
+template <typename... Ts>
+class ArrayBlock {
+ public:
+  template <size_t I>
+  using Element = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+  static_assert((std::is_trivially_copyable_v<Ts> && ...));
+  static_assert(((alignof(Ts) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) && ...));
+
+  ArrayBlock() = default;
+  ArrayBlock(ArrayBlock const& other) { Assign(other, 0, other.size_); }
+  ArrayBlock(ArrayBlock&& other) noexcept { Swap(&other); }
+  ArrayBlock& operator=(ArrayBlock const& other) {
+    if (this != &other)
+      Assign(other, 0, other.size_);
+    return *this;
+  }
+  ArrayBlock& operator=(ArrayBlock&& other) noexcept {
+    ArrayBlock(std::move(other)).Swap(this);
+    return *this;
+  }
+
+  // Array |I|, valid until the block is reallocated.
+  template <size_t I>
+  Element<I>* Get() {
+    return reinterpret_cast<Element<I>*>(block_.get() + Offset<I>(capacity_));
+  }
+  template <size_t I>
+  Element<I> const* Get() const {
+    return reinterpret_cast<Element<I> const*>(block_.get() +
+                                               Offset<I>(capacity_));
+  }
+  size_t Size() const { return size_; }
+  bool Empty() const { return size_ == 0; }
+  size_t GetMemoryUsage() const { return block_ ? Bytes(capacity_) : 0; }
+
+  // Added elements are value-initialized.
+  void Resize(size_t size) {
+    if (size > capacity_)
+      Reallocate(size);
+    if (size > size_) {
+      ForEachArray([this, size](auto i) {
+        auto* array = Get<decltype(i)::value>();
+        std::fill(array + size_, array + size, Element<decltype(i)::value>());
+      });
+    }
+    size_ = size;
+  }
+  // Inserts value-initialized elements at |index| of every array. The
+  // block grows geometrically.
+  void Insert(size_t index) {
+    if (size_ == capacity_)
+      Reallocate(std::max<size_t>(2 * capacity_, kMinCapacity));
+    ForEachArray([this, index](auto i) {
+      auto* array = Get<decltype(i)::value>();
+      std::memmove(array + index + 1, array + index,
+                   (size_ - index) * sizeof(*array));
+      array[index] = Element<decltype(i)::value>();
+    });
+    ++size_;
+  }
+  // Erases elements at |index| of every array, keeping the capacity.
+  void Erase(size_t index) {
+    ForEachArray([this, index](auto i) {
+      auto* array = Get<decltype(i)::value>();
+      std::memmove(array + index, array + index + 1,
+                   (size_ - index - 1) * sizeof(*array));
+    });
+    --size_;
+  }
+  // Replaces the arrays with elements from |begin| to |end| of |other|'s.
+  void Assign(ArrayBlock const& other, size_t begin, size_t end) {
+    const size_t size = end - begin;
+    if (size > capacity_) {
+      // Nothing has to be kept.
+      size_ = 0;
+      Reallocate(size);
+    }
+    ForEachArray([this, &other, begin, size](auto i) {
+      if (size) {
+        std::memcpy(Get<decltype(i)::value>(),
+                    other.template Get<decltype(i)::value>() + begin,
+                    size * sizeof(Element<decltype(i)::value>));
+      }
+    });
+    size_ = size;
+  }
+
+ private:
+  static constexpr size_t kMinCapacity = 4;
+  static constexpr size_t kArrays = sizeof...(Ts);
+
+  // Offset of array |I| in a block of |capacity| elements per array.
+  template <size_t I>
+  static size_t Offset(size_t capacity) {
+    if constexpr (I == 0) {
+      return 0;
+    } else {
+      constexpr size_t alignment = alignof(Element<I>);
+      const size_t end =
+          Offset<I - 1>(capacity) + capacity * sizeof(Element<I - 1>);
+      return (end + alignment - 1) / alignment * alignment;
+    }
+  }
+  static size_t Bytes(size_t capacity) {
+    return Offset<kArrays - 1>(capacity) +
+           capacity * sizeof(Element<kArrays - 1>);
+  }
+
+  template <typename Function>
+  static void ForEachArray(Function function) {
+    ForEachArray(function, std::make_index_sequence<kArrays>());
+  }
+  template <typename Function, size_t... Is>
+  static void ForEachArray(Function function, std::index_sequence<Is...>) {
+    (function(std::integral_constant<size_t, Is>()), ...);
+  }
+
+  // Moves the arrays into a new block of |capacity| elements per array.
+  void Reallocate(size_t capacity) {
+    ArrayBlock block;
+    block.block_.reset(new std::byte[Bytes(capacity)]);
+    block.capacity_ = capacity;
+    block.Assign(*this, 0, size_);
+    Swap(&block);
+  }
+  void Swap(ArrayBlock* other) {
+    std::swap(block_, other->block_);
+    std::swap(size_, other->size_);
+    std::swap(capacity_, other->capacity_);
+  }
+
+  std::unique_ptr<std::byte[]> block_;
+  size_t size_ = 0;
+  size_t capacity_ = 0;
+};
+}  // namespace gk
@@ -0,0 +1,139 @@
+// Copyright Wojciech Replin 2019
+
+#include "edge_grid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace gk {
+namespace {
+// Should be a few times larger than the margin, so that an edge rarely
+// spans more than a couple of cells.
+constexpr double kCellSize = 32;
+// Edges overlapping more cells are kept aside and checked by every query.
+constexpr long long kMaxCellsPerEdge = 256;
+// Keeps cell coordinates of far away (or non-finite) points representable.
+constexpr double kMaxCell = 1 << 29;
+
+int ToCell(double coordinate) {
+  const auto cell = std::floor(coordinate / kCellSize);
+  if (!(cell > -kMaxCell))
+    return static_cast<int>(-kMaxCell);
+  return static_cast<int>(std::min(cell, kMaxCell));
+}
+
+bool Oversized(Rect const& cells) {
+  return static_cast<long long>(cells.right - cells.left) *
+             (cells.bottom - cells.top) >
+         kMaxCellsPerEdge;
+}
+}  // namespace
+
+EdgeGrid::EdgeGrid(double margin) : margin_(margin) {}
+
+Rect EdgeGrid::GetCells(DrawingBoard::Point2d const& begin,
+                        DrawingBoard::Point2d const& end) const {
+  return {ToCell(std::min(begin.x, end.x) - margin_),
+          ToCell(std::min(begin.y, end.y) - margin_),
+          ToCell(std::max(begin.x, end.x) + margin_) + 1,
+          ToCell(std::max(begin.y, end.y) + margin_) + 1};
+}
+
+void EdgeGrid::Insert(Polygon* polygon, unsigned int edge, Rect const& cells) {
+  if (Oversized(cells)) {
+    oversized_.push_back({polygon, edge});
+    return;
+  }
+  for (int y = cells.top; y < cells.bottom; ++y)
+    for (int x = cells.left; x < cells.right; ++x)
+      cells_[Key(x, y)].push_back({polygon, edge});
+}
+
+void EdgeGrid::InsertAll(Polygon* polygon, std::vector<Rect> const& cells) {
+  Rect last;
+  std::vector<std::vector<Entry>*> last_cells;
+  for (unsigned int edge = 0; edge < cells.size(); ++edge) {
+    if (!(cells[edge] == last)) {
+      last = cells[edge];
+      last_cells.clear();
+      if (Oversized(last)) {
+        last_cells.push_back(&oversized_);
+      } else {
+        for (int y = last.top; y < last.bottom; ++y)
+          for (int x = last.left; x < last.right; ++x)
+            last_cells.push_back(&cells_[Key(x, y)]);
+      }
+    }
+    for (auto* cell : last_cells)
+      cell->push_back({polygon, edge});
+  }
+}
+
+void EdgeGrid::Erase(Polygon* polygon, unsigned int edge, Rect const& cells) {
+  if (Oversized(cells)) {
+    Remove(polygon, edge, &oversized_);
+    return;
+  }
+  for (int y = cells.top; y < cells.bottom; ++y) {
+    for (int x = cells.left; x < cells.right; ++x) {
+      const auto cell = cells_.find(Key(x, y));
+      if (cell == cells_.end())
+        continue;
+      Remove(polygon, edge, &cell->second);
+      if (cell->second.empty())
+        cells_.erase(cell);
+    }
+  }
+}
+
+void EdgeGrid::EraseAll(std::vector<Polygon*> const& polygons) {
+  const auto erased = [&polygons](Entry const& entry) {
+    return std::binary_search(polygons.begin(), polygons.end(), entry.polygon,
+                              std::less<Polygon*>());
+  };
+  for (auto cell = cells_.begin(); cell != cells_.end();) {
+    auto& entries = cell->second;
+    entries.erase(std::remove_if(entries.begin(), entries.end(), erased),
+                  entries.end());
+    if (entries.empty())
+      cell = cells_.erase(cell);
+    else
+      ++cell;
+  }
+  oversized_.erase(std::remove_if(oversized_.begin(), oversized_.end(), erased),
+                   oversized_.end());
+}
+
+void EdgeGrid::Query(DrawingBoard::Point2d const& point,
+                     std::vector<Entry>* entries) const {
+  entries->assign(oversized_.begin(), oversized_.end());
+  const auto cell = cells_.find(Key(ToCell(point.x), ToCell(point.y)));
+  if (cell != cells_.end())
+    entries->insert(entries->end(), cell->second.begin(), cell->second.end());
+  std::sort(entries->begin(), entries->end(),
+            [](Entry const& a, Entry const& b) {
+              if (a.polygon != b.polygon)
+                return std::less<Polygon*>()(a.polygon, b.polygon);
+              return a.edge < b.edge;
+            });
+}
+
+void EdgeGrid::Remove(Polygon* polygon,
+                      unsigned int edge,
+                      std::vector<Entry>* entries) {
+  const auto it =
+      std::find_if(entries->begin(), entries->end(), [&](Entry const& e) {
+        return e.polygon == polygon && e.edge == edge;
+      });
+  if (it == entries->end())
+    return;
+  *it = entries->back();
+  entries->pop_back();
+}
+
+unsigned long long EdgeGrid::Key(int x, int y) {
+  return static_cast<unsigned long long>(static_cast<unsigned int>(x)) << 32 |
+         static_cast<unsigned int>(y);
+}
+}  // namespace gk
@@ -0,0 +1,67 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "../drawing_board/drawing_board.hpp"
+#include "../drawing_board/rect.hpp"
+
+namespace gk {
+class Polygon;
+
+// Uniform grid over edges of all polygons of a scene, so that finding edges
+// near a point visits only edges passing nearby instead of every edge. An
+// edge is registered in every cell overlapped by its bounding box grown by
+// the pick margin, hence all edges within the margin of a point are found
+// in the single cell containing it. Long slanted edges are registered in
+// more cells than they actually cross. Only nonempty cells are stored. Edges
+// which would take too many cells, e.g. ones thrown far away by a diverging
+// solver, are kept in a separate list visited by every query instead.
+class EdgeGrid {
+ public:
+  struct Entry {
+    Polygon* polygon;
+    unsigned int edge;
+  };
+
+  // |margin| is the largest distance from an edge at which it can be
+  // picked.
+  explicit EdgeGrid(double margin);
+
+  // Range of cells an edge from |begin| to |end| has to be registered in.
+  Rect GetCells(DrawingBoard::Point2d const& begin,
+                DrawingBoard::Point2d const& end) const;
+  void Insert(Polygon* polygon, unsigned int edge, Rect const& cells);
+  // Inserts every edge of |polygon|, edge i into |cells|[i]. Faster than
+  // inserting edges one by one, as cells shared by consecutive edges are
+  // looked up once.
+  void InsertAll(Polygon* polygon, std::vector<Rect> const& cells);
+  void Erase(Polygon* polygon, unsigned int edge, Rect const& cells);
+  // Erases all edges of |polygons|, which have to be sorted, in a single
+  // pass over the grid. Faster than erasing edges one by one once the
+  // polygons make up a large part of the grid, as each cell is searched
+  // once instead of once per edge.
+  void EraseAll(std::vector<Polygon*> const& polygons);
+  // Fills |entries| with edges which may lie within the margin of |point|,
+  // ordered by polygon and then by edge.
+  void Query(DrawingBoard::Point2d const& point,
+             std::vector<Entry>* entries) const;
+
+ private:
+  // Swaps the entry of |edge| out of |entries|.
+  static void Remove(Polygon* polygon,
+                     unsigned int edge,
+                     std::vector<Entry>* entries);
+  static unsigned long long Key(int x, int y);
+
+  const double margin_;
+  std::unordered_map<unsigned long long, std::vector<Entry>> cells_;
+  std::vector<Entry> oversized_;
+
+  // Disallow copy and assign
+  EdgeGrid& operator=(EdgeGrid&) = delete;
+  EdgeGrid(EdgeGrid&) = delete;
+};
+}  // namespace gk
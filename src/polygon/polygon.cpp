@@ -6,20 +6,35 @@
 #undef max
 
 #include <algorithm>
-#include <map>
+#include <cmath>
+#include <cstring>
+#include <functional>
 #include <numeric>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "../rasterizer/rasterizer.hpp"
 
 namespace gk {
 namespace {
 constexpr double kMinDistanceFromVertexSquared = 6;
 constexpr double kMinDistanceFromEdgeSquared = 6;
-constexpr wchar_t kUpTack[] = {8869};
+constexpr wchar_t kUpTack[] = {8869, 0};
 constexpr wchar_t kEqualSign[] = L"=";
 constexpr double kVerySmallValue = 0.001;
 constexpr unsigned int kMaxIters = 100;
+constexpr int kLabelFontSize = 15;
+constexpr int kMaxLabelWidth = 4 * kLabelFontSize;
+constexpr COLORREF kFillColor = RGB(0, 80, 0);
+// Shorter edges can't be told apart on the screen.
+constexpr double kMinConstrainedLength = 1;
+// Largest distance of a vertex left out of a drawn outline from the
+// outline, in board pixels.
+constexpr double kOutlineTolerance = 0.5;
 
 double DistanceSquared(DrawingBoard::Point2d const& from,
                        DrawingBoard::Point2d const& to) {
@@ -56,11 +71,11 @@ DrawingBoard::Point2d ClosestPointOnCircle(DrawingBoard::Point2d const& center,
   return center + pos;
 }
 
-void DisplayLabel(DrawingBoard* board,
+void DisplayLabel(Canvas* canvas,
                   DrawingBoard::Point2d const& pos,
                   std::wstring_view label) {
-  constexpr int font_size = 15;
-  board->DrawTxt(pos.x, pos.y, label.data(), font_size, RGB(255, 0, 0));
+  canvas->DrawTxt(static_cast<int>(pos.x), static_cast<int>(pos.y), label,
+                  kLabelFontSize, RGB(255, 0, 0));
 }
 
 double Determinant(DrawingBoard::Point2d const& p1,
@@ -117,54 +132,18 @@ auto CircleIntersection(DrawingBoard::Point2d const& center1,
                                         center1.y + x * e.y - y * e.x}};
   return result;
 }
-
-template <typename Callback>
-void BresenhamSymmetric(int x0, int y0, int x1, int y1, Callback callback) {
-  const auto dx = std::abs(x1 - x0);
-  const auto dy = -std::abs(y1 - y0);
-  const auto sx = x0 < x1 ? 1 : -1;
-  const auto sy = y0 < y1 ? 1 : -1;
-  auto err = dx + dy;
-  auto iters = (err > 0 ? dx / 2 : -dy / 2) + 1;
-  while (--iters > 0) {
-    auto e2 = 2 * err;
-    if (e2 >= dy) {
-      err += dy;
-      x0 += sx;
-      x1 -= sx;
-    }
-    if (e2 <= dx) {
-      err += dx;
-      y0 += sy;
-      y1 -= sy;
-    }
-    callback(x0, y0);
-    callback(x1, y1);
-  }
-}
-template <typename Callback>
-void BresenhamClassic(int x0, int y0, int x1, int y1, Callback callback) {
-  const auto dx = std::abs(x1 - x0);
-  const auto dy = -std::abs(y1 - y0);
-  const auto sx = x0 < x1 ? 1 : -1;
-  const auto sy = y0 < y1 ? 1 : -1;
-  auto err = dx + dy;
-  while (x0 != x1 || y0 != y1) {
-    auto e2 = 2 * err;
-    if (e2 >= dy) {
-      err += dy;
-      x0 += sx;
-    }
-    if (e2 <= dx) {
-      err += dx;
-      y0 += sy;
-    }
-    callback(x0, y0);
-  }
-}
 }  // namespace
+double Polygon::PickMargin() {
+  // Distances to edges are measured to projections rounded to whole pixels.
+  return std::sqrt(std::max(kMinDistanceFromVertexSquared,
+                            kMinDistanceFromEdgeSquared)) +
+         std::sqrt(2.0);
+}
+
 std::unique_ptr<Polygon> Polygon::CreateSamplePolygon(
-    DrawingBoard* drawing_board) {
+    DrawingBoard* drawing_board,
+    EdgeGrid* edge_grid,
+    IdManager* id_manager) {
   constexpr COLORREF edge_color = RGB(0, 255, 0);
   constexpr COLORREF vertex_color = RGB(255, 0, 0);
   const auto ps = drawing_board->GetPixelSize();
@@ -173,733 +152,1507 @@ std::unique_ptr<Polygon> Polygon::CreateSamplePolygon(
   const double y[]{279.0 / ps, 222.0 / ps, 198.0 / ps, 59.0 / ps,
                    5.0 / ps,   110.0 / ps, 278.0 / ps};
   auto ret = std::make_unique<Polygon>();
-  PolygonEdge* edge[] = {
-      new PolygonEdge(drawing_board, DrawingBoard::Point2d{x[0], y[0]},
-                      DrawingBoard::Point2d{x[1], y[1]}, edge_color,
-                      vertex_color),
-      new PolygonEdge(drawing_board, DrawingBoard::Point2d{x[1], y[1]},
-                      DrawingBoard::Point2d{x[2], y[2]}, edge_color,
-                      vertex_color),
-      new PolygonEdge(drawing_board, DrawingBoard::Point2d{x[2], y[2]},
-                      DrawingBoard::Point2d{x[3], y[3]}, edge_color,
-                      vertex_color),
-      new PolygonEdge(drawing_board, DrawingBoard::Point2d{x[3], y[3]},
-                      DrawingBoard::Point2d{x[4], y[4]}, edge_color,
-                      vertex_color),
-      new PolygonEdge(drawing_board, DrawingBoard::Point2d{x[4], y[4]},
-                      DrawingBoard::Point2d{x[5], y[5]}, edge_color,
-                      vertex_color),
-      new PolygonEdge(drawing_board, DrawingBoard::Point2d{x[5], y[5]},
-                      DrawingBoard::Point2d{x[6], y[6]}, edge_color,
-                      vertex_color),
-      new PolygonEdge(drawing_board, DrawingBoard::Point2d{x[6], y[6]},
-                      DrawingBoard::Point2d{x[0], y[0]}, edge_color,
-                      vertex_color),
-  };
-  ret->body_.reset(edge[0]);
-  for (int i = 1; i < 7; ++i)
-    ret->body_->AddBefore(edge[i]);
-
-  edge[0]->constraint_ = PolygonEdge::Constraint::PERPENDICULAR;
-  edge[0]->constraint_id_ = id_manager::Get();
-  edge[0]->constrained_edge_ = edge[3];
-
-  edge[1]->constraint_ = PolygonEdge::Constraint::PERPENDICULAR;
-  edge[1]->constraint_id_ = id_manager::Get();
-  edge[1]->constrained_edge_ = edge[2];
-
-  edge[2]->constraint_ = edge[1]->constraint_;
-  edge[2]->constraint_id_ = edge[1]->constraint_id_;
-  edge[2]->constrained_edge_ = edge[1];
-
-  edge[3]->constraint_ = edge[0]->constraint_;
-  edge[3]->constraint_id_ = edge[0]->constraint_id_;
-  edge[3]->constrained_edge_ = edge[0];
-
-  edge[4]->constraint_ = PolygonEdge::Constraint::EQUAL_LENGTH;
-  edge[4]->constraint_id_ = id_manager::Get();
-  edge[4]->constrained_edge_ = edge[5];
-
-  edge[5]->constraint_ = edge[4]->constraint_;
-  edge[5]->constraint_id_ = edge[4]->constraint_id_;
-  edge[5]->constrained_edge_ = edge[4];
+  ret->drawing_board_ = drawing_board;
+  ret->edge_grid_ = edge_grid;
+  ret->id_manager_ = id_manager;
+  ret->edge_color_ = edge_color;
+  ret->vertex_color_ = vertex_color;
+  for (int i = 0; i < 7; ++i)
+    ret->InsertVertex(ret->Size(), DrawingBoard::Point2d{x[i], y[i]});
 
-  edge[6]->constraint_ = PolygonEdge::Constraint::NONE;
-  edge[6]->constraint_id_ = 0;
-  edge[6]->constrained_edge_ = nullptr;
+  const auto constrain = [&ret](Index e1, Index e2, Constraint constraint) {
+    ret->constraint_[e1] = ret->constraint_[e2] = constraint;
+    ret->constrained_edge_[e1] = e2;
+    ret->constrained_edge_[e2] = e1;
+    ret->constraint_id_[e1] = ret->constraint_id_[e2] = ret->AcquireId();
+    ++ret->constraints_;
+  };
+  constrain(0, 3, Constraint::PERPENDICULAR);
+  constrain(1, 2, Constraint::PERPENDICULAR);
+  constrain(4, 5, Constraint::EQUAL_LENGTH);
 
-  ret->nverticies_ = 7;
-  ret->drawing_board_ = drawing_board;
-  auto* ptr = ret->body_.get();
-  do {
-    ptr->SetEnd(ptr->end_ + DrawingBoard::Point2d{1, 0}, 3 * ret->nverticies_);
-  } while ((ptr = ptr->next_) != ret->body_.get());
+  for (Index e = 0; e < ret->Size(); ++e) {
+    ret->Schedule(Step::SetEnd(e, ret->End(e) + DrawingBoard::Point2d{1, 0},
+                               ret->End(e), 3 * ret->Size(), true));
+    ret->Propagate();
+  }
+  ret->FitBounds();
+  ret->UpdateEdgeGrid();
   return ret;
 }
 
 std::unique_ptr<Polygon> Polygon::Create(DrawingBoard* drawing_board,
+                                         EdgeGrid* edge_grid,
+                                         IdManager* id_manager,
                                          DrawingBoard::Point2d const& p1,
                                          DrawingBoard::Point2d const& p2,
                                          DrawingBoard::Point2d const& p3,
                                          COLORREF edge_color,
                                          COLORREF vertex_color) {
   auto ret = std::make_unique<Polygon>();
-  ret->body_ = std::make_unique<PolygonEdge>(drawing_board, p1, p2, edge_color,
-                                             vertex_color);
-  ret->body_->AddAfter(
-      new PolygonEdge(drawing_board, p2, p3, edge_color, vertex_color));
-  ret->body_->AddBefore(
-      new PolygonEdge(drawing_board, p3, p1, edge_color, vertex_color));
-  ret->nverticies_ = 3;
   ret->drawing_board_ = drawing_board;
+  ret->edge_grid_ = edge_grid;
+  ret->id_manager_ = id_manager;
+  ret->edge_color_ = edge_color;
+  ret->vertex_color_ = vertex_color;
+  ret->InsertVertex(0, p1);
+  ret->InsertVertex(1, p2);
+  ret->InsertVertex(2, p3);
+  ret->UpdateEdgeGrid();
   return ret;
 }
 
-void Polygon::Display() {
-  auto* ptr = body_.get();
-  do {
-    ptr->Display();
-  } while ((ptr = ptr->Next()) != body_.get());
+std::unique_ptr<Polygon> Polygon::Create(DrawingBoard* drawing_board,
+                                         EdgeGrid* edge_grid,
+                                         IdManager* id_manager,
+                                         Data const& data) {
+  static_assert(sizeof(Constraint) == sizeof(uint8_t) &&
+                sizeof(Index) == sizeof(uint32_t));
+  if (data.size < 3)
+    return nullptr;
+  for (Index e = 0; e < data.size; ++e) {
+    if (!std::isfinite(data.x[e]) || !std::isfinite(data.y[e]))
+      return nullptr;
+    if (!data.constraint[e])
+      continue;
+    const Index other = data.constrained_edge[e];
+    if (data.constraint[e] > static_cast<uint8_t>(Constraint::EQUAL_LENGTH) ||
+        other >= data.size || other == e ||
+        data.constraint[other] != data.constraint[e] ||
+        data.constrained_edge[other] != e) {
+      return nullptr;
+    }
+  }
+  auto ret = std::make_unique<Polygon>();
+  ret->drawing_board_ = drawing_board;
+  ret->edge_grid_ = edge_grid;
+  ret->id_manager_ = id_manager;
+  ret->edge_color_ = data.edge_color;
+  ret->vertex_color_ = data.vertex_color;
+  ret->fill_rule_ = data.fill_rule;
+  ret->edges_.Resize(data.size);
+  ret->BindEdges();
+  std::copy_n(data.x, data.size, ret->x_);
+  std::copy_n(data.y, data.size, ret->y_);
+  std::memcpy(ret->constraint_, data.constraint, data.size);
+  std::copy_n(data.constrained_edge, data.size, ret->constrained_edge_);
+  for (Index e = 0; e < data.size; ++e) {
+    if (data.constraint[e] && e < data.constrained_edge[e]) {
+      ret->constraint_id_[e] = ret->constraint_id_[data.constrained_edge[e]] =
+          ret->AcquireId();
+      ++ret->constraints_;
+    }
+  }
+  ret->FitBounds();
+  ret->UpdateEdgeGrid();
+  return ret;
 }
 
-bool Polygon::OnMouseLButtonDown(DrawingBoard::Point2d const& mouse_pos) {
-  auto* ptr = body_.get();
-  bool ret = false;
-  do {
-    ret = ptr->OnMouseLButtonDown(mouse_pos) || ret;
-  } while ((ptr = ptr->Next()) != body_.get());
-  return ret;
+Polygon::~Polygon() {
+  UnregisterEdges();
+  if (!id_manager_)
+    return;
+  for (Index e = 0; e < Size(); ++e)
+    if (constraint_[e] != Constraint::NONE)
+      id_manager_->Release(constraint_id_[e]);
 }
 
-bool Polygon::OnMouseLButtonUp(DrawingBoard::Point2d const& mouse_pos) {
-  auto* ptr = body_.get();
-  bool ret = false;
-  do {
-    ret = ptr->OnMouseLButtonUp(mouse_pos) || ret;
-  } while ((ptr = ptr->Next()) != body_.get());
-  return ret;
+struct Polygon::Chunk {
+  static constexpr size_t kX = 0, kY = 1, kConstraint = 2,
+                          kConstraintId = 3;
+
+  // Fills |outline| unless it's been filled already.
+  void Simplify() const;
+
+  // What's drawn of every edge, in a single allocation.
+  ArrayBlock<double, double, Constraint, IdManager::ID> edges;
+  // Verticies the chunk's outline is drawn through, in increasing order.
+  // Built by the render thread when the chunk is first drawn and shared by
+  // all snapshots the chunk is part of, so it's only built again after the
+  // chunk's verticies change.
+  mutable std::vector<Index> outline;
+};
+
+void Polygon::Chunk::Simplify() const {
+  if (!outline.empty())
+    return;
+  const Index size = static_cast<Index>(edges.Size());
+  const auto* const x = edges.Get<kX>();
+  const auto* const y = edges.Get<kY>();
+  const auto* const constraint = edges.Get<kConstraint>();
+  const auto distance_squared = [x, y](Index from, Index to) {
+    return (x[to] - x[from]) * (x[to] - x[from]) +
+           (y[to] - y[from]) * (y[to] - y[from]);
+  };
+  // Only verticies between unconstrained edges shorter than a pixel are
+  // left out, so that outlines of polygons which aren't too detailed to be
+  // seen are drawn exactly. The first and the last vertex are kept, so that
+  // chunks are drawn independently.
+  std::vector<char> keep(size, 1);
+  for (Index v = 1; v + 1 < size; ++v) {
+    keep[v] = constraint[v - 1] != Constraint::NONE ||
+              constraint[v] != Constraint::NONE ||
+              distance_squared(v - 1, v) >= 1 ||
+              distance_squared(v, v + 1) >= 1;
+  }
+  // Douglas-Peucker simplification of every run of verticies which may be
+  // left out, between two which are kept.
+  const auto error_squared = [x, y, &distance_squared](Index begin,
+                                                       Index end, Index v) {
+    const double length_squared = distance_squared(begin, end);
+    double t = 0;
+    if (length_squared > 0) {
+      t = ((x[v] - x[begin]) * (x[end] - x[begin]) +
+           (y[v] - y[begin]) * (y[end] - y[begin])) /
+          length_squared;
+      t = std::max(0.0, std::min(1.0, t));
+    }
+    const double dx = x[begin] + t * (x[end] - x[begin]) - x[v];
+    const double dy = y[begin] + t * (y[end] - y[begin]) - y[v];
+    return dx * dx + dy * dy;
+  };
+  std::vector<std::pair<Index, Index>> runs;
+  for (Index begin = 0, end = 1; end < size; ++end) {
+    if (!keep[end])
+      continue;
+    if (end - begin > 1)
+      runs.emplace_back(begin, end);
+    while (!runs.empty()) {
+      const auto [run_begin, run_end] = runs.back();
+      runs.pop_back();
+      Index farthest = run_begin;
+      double farthest_error = kOutlineTolerance * kOutlineTolerance;
+      for (Index v = run_begin + 1; v < run_end; ++v) {
+        const double error = error_squared(run_begin, run_end, v);
+        if (error > farthest_error) {
+          farthest = v;
+          farthest_error = error;
+        }
+      }
+      if (farthest == run_begin)
+        continue;
+      keep[farthest] = 1;
+      if (farthest - run_begin > 1)
+        runs.emplace_back(run_begin, farthest);
+      if (run_end - farthest > 1)
+        runs.emplace_back(farthest, run_end);
+    }
+    begin = end;
+  }
+  for (Index v = 0; v < size; ++v)
+    if (keep[v])
+      outline.push_back(v);
 }
 
-bool Polygon::OnMouseMove(DrawingBoard::Point2d const& mouse_pos,
-                          bool move_whole) {
-  if (move_whole)
-    return body_->MoveWhole(mouse_pos, drawing_board_->GetPreviousMousePos());
-  auto* ptr = body_.get();
-  do {
-    if (ptr->OnMouseMove(mouse_pos, drawing_board_->GetPreviousMousePos(),
-                         3 * nverticies_))
-      return true;
-  } while ((ptr = ptr->Next()) != body_.get());
+Polygon::PlacedSnapshot Polygon::TakeSnapshot() {
+  if (snapshot_)
+    return {snapshot_, snapshot_offset_, GetBoundingRect()};
+  chunks_.resize((Size() + kChunkSize - 1) / kChunkSize);
+  for (Index c = 0; c < chunks_.size(); ++c) {
+    if (chunks_[c])
+      continue;
+    const Index begin = c * kChunkSize;
+    const Index end = std::min(begin + kChunkSize, Size());
+    auto chunk = std::make_shared<Chunk>();
+    chunk->edges.Resize(end - begin);
+    std::copy(x_ + begin, x_ + end, chunk->edges.Get<Chunk::kX>());
+    std::copy(y_ + begin, y_ + end, chunk->edges.Get<Chunk::kY>());
+    std::copy(constraint_ + begin, constraint_ + end,
+              chunk->edges.Get<Chunk::kConstraint>());
+    std::copy(constraint_id_ + begin, constraint_id_ + end,
+              chunk->edges.Get<Chunk::kConstraintId>());
+    chunks_[c] = std::move(chunk);
+  }
+  std::shared_ptr<Snapshot> snapshot(new Snapshot());
+  snapshot->size_ = Size();
+  snapshot->chunks_ = chunks_;
+  snapshot->edge_color_ = edge_color_;
+  snapshot->vertex_color_ = vertex_color_;
+  snapshot->fill_rule_ = fill_rule_;
+  snapshot_ = std::move(snapshot);
+  return {snapshot_, snapshot_offset_, GetBoundingRect()};
+}
+
+bool Polygon::OnMouseLButtonDown(DrawingBoard::Point2d const& mouse_pos,
+                                 Edges const& edges) {
+  if (!InPickRange(mouse_pos))
+    return Active();
+  for (auto e : edges) {
+    if (DistanceSquared(mouse_pos, Begin(e)) < kMinDistanceFromVertexSquared)
+      grab_ = Grab::BEGIN;
+    else if (DistanceSquared(mouse_pos, End(e)) < kMinDistanceFromVertexSquared)
+      grab_ = Grab::END;
+    else if (DistanceToSegmentSquared(Begin(e), End(e), mouse_pos) <
+             kMinDistanceFromEdgeSquared)
+      grab_ = Grab::EDGE;
+    else
+      continue;
+    grabbed_edge_ = e;
+    return true;
+  }
+  return Active();
+}
+
+bool Polygon::OnMouseLButtonUp(DrawingBoard::Point2d const& mouse_pos) {
+  if (Active())
+    FitBounds();
+  grab_ = Grab::NONE;
   return false;
 }
 
+void Polygon::Drag(DrawingBoard::Point2d const& from,
+                   DrawingBoard::Point2d const& to,
+                   bool move_whole,
+                   Solver solver,
+                   std::atomic<bool> const* cancel) {
+  if (!Active() || to == from)
+    return;
+  cancel_ = cancel;
+  if (move_whole) {
+    Translate(to - from);
+  } else if (solver == Solver::LEAST_SQUARES) {
+    const auto end = Next(grabbed_edge_);
+    switch (grab_) {
+      case Grab::EDGE: {
+        const DrawingBoard::Point2d vector = to - from;
+        SetVertex(grabbed_edge_, Begin(grabbed_edge_) + vector);
+        SetVertex(end, Begin(end) + vector);
+        SolveLeastSquares({grabbed_edge_, end});
+      } break;
+      case Grab::BEGIN:
+        SetVertex(grabbed_edge_, to);
+        SolveLeastSquares({grabbed_edge_});
+        break;
+      case Grab::END:
+        SetVertex(end, to);
+        SolveLeastSquares({end});
+        break;
+      case Grab::NONE:
+        break;
+    }
+  } else {
+    const auto end = Next(grabbed_edge_);
+    switch (grab_) {
+      case Grab::EDGE:
+        MoveByVector(grabbed_edge_, to - from, MaxCalls({grabbed_edge_, end}));
+        break;
+      case Grab::BEGIN:
+        Schedule(Step::SetBegin(grabbed_edge_, to, Begin(grabbed_edge_),
+                                MaxCalls({grabbed_edge_}), true));
+        Propagate();
+        break;
+      case Grab::END:
+        Schedule(Step::SetEnd(grabbed_edge_, to, End(grabbed_edge_),
+                              MaxCalls({end}), true));
+        Propagate();
+        break;
+      case Grab::NONE:
+        break;
+    }
+  }
+  cancel_ = nullptr;
+}
+
+std::unique_ptr<Polygon> Polygon::CloneForSolving() const {
+  auto clone = std::make_unique<Polygon>();
+  clone->edges_ = edges_;
+  clone->BindEdges();
+  clone->grab_ = grab_;
+  clone->grabbed_edge_ = grabbed_edge_;
+  clone->correct_ = correct_;
+  clone->min_x_ = min_x_;
+  clone->min_y_ = min_y_;
+  clone->max_x_ = max_x_;
+  clone->max_y_ = max_y_;
+  clone->constraints_ = constraints_;
+  return clone;
+}
+
+void Polygon::ApplySolved(Polygon* solved) {
+  const auto old_rect = GetBoundingRect();
+  // Drags either translate the polygon or move single verticies, whose
+  // final positions are copied once. Constraints which can't be kept are
+  // removed, which releases their ids.
+  for (auto const& entry : solved->journal_) {
+    switch (entry.type) {
+      case JournalEntry::Type::VERTEX:
+        // Records of all verticies only precede translations, which are
+        // applied instead.
+        if (solved->verticies_journaled_)
+          break;
+        if (x_[entry.index] != solved->x_[entry.index] ||
+            y_[entry.index] != solved->y_[entry.index])
+          SetVertex(entry.index, solved->Begin(entry.index));
+        break;
+      case JournalEntry::Type::TRANSLATION:
+        Translate({entry.x, entry.y});
+        break;
+      case JournalEntry::Type::CONSTRAINT: {
+        const auto e = entry.index;
+        if (constraint_[e] == solved->constraint_[e] &&
+            constrained_edge_[e] == solved->constrained_edge_[e] &&
+            constraint_id_[e] == solved->constraint_id_[e])
+          break;
+        JournalConstraint(e);
+        constraint_[e] = solved->constraint_[e];
+        constrained_edge_[e] = solved->constrained_edge_[e];
+        constraint_id_[e] = solved->constraint_id_[e];
+        break;
+      }
+      case JournalEntry::Type::ID_RELEASED:
+        ReleaseId(entry.id);
+        break;
+      default:
+        break;
+    }
+  }
+  constraints_ = solved->constraints_;
+  correct_ = solved->correct_;
+  // Changes are journaled here instead, and ids released by the copy
+  // belong to this polygon's id manager.
+  solved->journal_.clear();
+  solved->in_transaction_ = false;
+  solved->moved_edges_.clear();
+  OnGeometryChanged(old_rect);
+}
+
+void Polygon::Transform(DrawingBoard::Point2d const& factor,
+                        DrawingBoard::Point2d const& offset) {
+  if (!(factor == DrawingBoard::Point2d{1, 0}))
+    Multiply(factor);
+  if (!(offset == DrawingBoard::Point2d{0, 0}))
+    Translate(offset);
+}
+
+bool Polygon::CanScale(double scale) const {
+  if (scale >= 1)
+    return true;
+  for (Index e = 0; e < Size(); ++e)
+    if (constraint_[e] != Constraint::NONE &&
+        Length(e) * scale < kMinConstrainedLength)
+      return false;
+  return true;
+}
+
 void Polygon::OnControllerStateChanged(PolygonController* controller) {
-  auto* ptr = body_.get();
-  do {
-    ptr->OnControllerStateChanged(controller);
-  } while ((ptr = ptr->Next()) != body_.get());
+  grab_ = Grab::NONE;
 }
 
-bool Polygon::AddVertex(DrawingBoard::Point2d const& pos) {
-  auto* ptr = body_.get();
-  do {
-    if (ptr->Split(pos)) {
-      ++nverticies_;
+bool Polygon::AddVertex(DrawingBoard::Point2d const& pos, Edges const& edges) {
+  if (!InPickRange(pos))
+    return false;
+  for (auto e : edges) {
+    if (DistanceToSegmentSquared(Begin(e), End(e), pos) <
+        kMinDistanceFromEdgeSquared) {
+      const auto old_rect = GetBoundingRect();
+      RemoveConstraint(e);
+      InsertVertex(e + 1, (Begin(e) + End(e)) / 2);
+      OnGeometryChanged(old_rect);
       return true;
     }
-  } while ((ptr = ptr->Next()) != body_.get());
+  }
   return false;
 }
 
-bool Polygon::Remove(DrawingBoard::Point2d const& point) {
-  auto* ptr = body_.get();
-  auto* head = body_.get();
-  do {
-    if (ptr->RemoveVertex(point, &head, 3 * nverticies_)) {
-      --nverticies_;
-      body_.release();
-      body_.reset(head);
-      if (body_->Next()->Next() == body_.get())
-        return false;
-      return true;
+bool Polygon::Remove(DrawingBoard::Point2d const& point, Edges const& edges) {
+  if (!InPickRange(point))
+    return true;
+  for (auto e : edges) {
+    std::optional<Index> vertex;
+    if (DistanceSquared(End(e), point) < kMinDistanceFromVertexSquared)
+      vertex = Next(e);
+    else if (DistanceSquared(Begin(e), point) < kMinDistanceFromVertexSquared)
+      vertex = e;
+    if (vertex.has_value()) {
+      const auto old_rect = GetBoundingRect();
+      RemoveConstraint(Prev(vertex.value()));
+      RemoveConstraint(vertex.value());
+      EraseVertex(vertex.value());
+      FitBounds();
+      OnGeometryChanged(old_rect);
+      return Size() > 2;
     }
-    if (ptr->RemoveConstraint(point))
+    if (DistanceToSegmentSquared(Begin(e), End(e), point) <
+        kMinDistanceFromEdgeSquared) {
+      const auto old_rect = GetBoundingRect();
+      RemoveConstraint(e);
+      OnGeometryChanged(old_rect);
       return true;
-  } while ((ptr = ptr->Next()) != body_.get());
+    }
+  }
   return true;
 }
 
 bool Polygon::SetPerpendicular(DrawingBoard::Point2d const& p1,
-                               DrawingBoard::Point2d const& p2) {
-  PolygonEdge *e1 = nullptr, *e2 = nullptr;
-  auto* ptr = body_.get();
-  do {
-    if (DistanceToSegmentSquared(ptr->Begin(), ptr->End(), p1) <
-        kMinDistanceFromEdgeSquared) {
-      e1 = ptr;
-    }
-    if (DistanceToSegmentSquared(ptr->Begin(), ptr->End(), p2) <
-        kMinDistanceFromEdgeSquared) {
-      e2 = ptr;
-    }
-  } while ((ptr = ptr->Next()) != body_.get());
+                               Edges const& edges1,
+                               DrawingBoard::Point2d const& p2,
+                               Edges const& edges2) {
+  if (!InPickRange(p1) || !InPickRange(p2))
+    return false;
+  std::optional<Index> e1, e2;
+  for (auto e : edges1) {
+    if (DistanceToSegmentSquared(Begin(e), End(e), p1) <
+        kMinDistanceFromEdgeSquared)
+      e1 = e;
+  }
+  for (auto e : edges2) {
+    if (DistanceToSegmentSquared(Begin(e), End(e), p2) <
+        kMinDistanceFromEdgeSquared)
+      e2 = e;
+  }
   if (!e1 || !e2 || e1 == e2)
     return false;
-  return e1->SetPerpendicular(e2, 3 * nverticies_);
+  const auto old_rect = GetBoundingRect();
+  const auto max_calls = MaxCalls(
+      {e1.value(), Next(e1.value()), e2.value(), Next(e2.value())});
+  if (!SetPerpendicular(e1.value(), e2.value(), max_calls))
+    return false;
+  OnGeometryChanged(old_rect);
+  return true;
 }
 
 bool Polygon::SetEqualLength(DrawingBoard::Point2d const& p1,
-                             DrawingBoard::Point2d const& p2) {
-  PolygonEdge *e1 = nullptr, *e2 = nullptr;
-  auto* ptr = body_.get();
-  do {
-    if (DistanceToSegmentSquared(ptr->Begin(), ptr->End(), p1) <
-        kMinDistanceFromEdgeSquared) {
-      e1 = ptr;
-    }
-    if (DistanceToSegmentSquared(ptr->Begin(), ptr->End(), p2) <
-        kMinDistanceFromEdgeSquared) {
-      e2 = ptr;
-    }
-  } while ((ptr = ptr->Next()) != body_.get());
+                             Edges const& edges1,
+                             DrawingBoard::Point2d const& p2,
+                             Edges const& edges2) {
+  if (!InPickRange(p1) || !InPickRange(p2))
+    return false;
+  std::optional<Index> e1, e2;
+  for (auto e : edges1) {
+    if (DistanceToSegmentSquared(Begin(e), End(e), p1) <
+        kMinDistanceFromEdgeSquared)
+      e1 = e;
+  }
+  for (auto e : edges2) {
+    if (DistanceToSegmentSquared(Begin(e), End(e), p2) <
+        kMinDistanceFromEdgeSquared)
+      e2 = e;
+  }
   if (!e1 || !e2 || e1 == e2)
     return false;
-  return e1->SetEqualLength(e2, 3 * nverticies_);
+  const auto old_rect = GetBoundingRect();
+  const auto max_calls = MaxCalls(
+      {e1.value(), Next(e1.value()), e2.value(), Next(e2.value())});
+  if (!SetEqualLength(e1.value(), e2.value(), max_calls))
+    return false;
+  OnGeometryChanged(old_rect);
+  return true;
 }
 
-std::unique_ptr<Polygon> Polygon::Clone() {
-  auto ret = std::make_unique<Polygon>();
-  ret->drawing_board_ = drawing_board_;
-  ret->nverticies_ = nverticies_;
-  auto* ptr = body_.get();
-  std::map<PolygonEdge*, PolygonEdge*> map;
-  ret->body_.reset(new PolygonEdge(*body_));
-  map[body_.get()] = ret->body_.get();
-  ptr = ptr->Next();
-  do {
-    auto* edge = new PolygonEdge(*ptr);
-    map[ptr] = edge;
-    ret->body_->AddBefore(edge);
-  } while ((ptr = ptr->Next()) != body_.get());
-  auto* ret_body = ret->body_.get();
-  do {
-    ret_body->constrained_edge_ = map[ptr->constrained_edge_];
-    ret_body->constraint_ = ptr->constraint_;
-    ret_body->constraint_id_ = ptr->constraint_id_;
-
-    ret_body = ret_body->Next();
-  } while ((ptr = ptr->Next()) != body_.get());
-  return ret;
+void Polygon::SetFillRule(std::optional<rasterizer::FillRule> fill_rule) {
+  fill_rule_ = fill_rule;
+  ResetSnapshot();
+  drawing_board_->Invalidate(GetBoundingRect());
 }
 
-bool Polygon::Active() {
-  auto* ptr = body_.get();
-  do {
-    if (ptr->Active())
-      return true;
-  } while ((ptr = ptr->Next()) != body_.get());
-  return false;
+bool Polygon::Contains(DrawingBoard::Point2d const& point) {
+  bool inside = false;
+  for (Index e = 0; e < Size(); ++e) {
+    const auto a = Begin(e);
+    const auto b = End(e);
+    if ((a.y > point.y) != (b.y > point.y) &&
+        point.x < a.x + (point.y - a.y) * (b.x - a.x) / (b.y - a.y))
+      inside = !inside;
+  }
+  return inside;
 }
 
-Polygon::PolygonEdge::~PolygonEdge() {
-  if (next_ != this) {
-    prev_->next_ = nullptr;
-    delete next_;
-  }
-}
-
-Polygon::PolygonEdge::PolygonEdge(DrawingBoard* drawing_board,
-                                  DrawingBoard::Point2d const& begin,
-                                  DrawingBoard::Point2d const& end,
-                                  COLORREF edge_color,
-                                  COLORREF vertex_color)
-    : drawing_board_(drawing_board),
-      begin_(begin),
-      end_(end),
-      next_(this),
-      prev_(this),
-      edge_color_(edge_color),
-      vertex_color_(vertex_color) {}
-
-Polygon::PolygonEdge::PolygonEdge(PolygonEdge const& other)
-    : drawing_board_(other.drawing_board_),
-      begin_(other.begin_),
-      end_(other.end_),
-      next_(this),
-      prev_(this),
-      edge_color_(other.edge_color_),
-      vertex_color_(other.vertex_color_),
-      is_edge_clicked_(other.is_edge_clicked_),
-      is_clicked_(other.is_clicked_),
-      begin_clicked_(other.begin_clicked_),
-      correct_(other.correct_) {}
-
-void Polygon::PolygonEdge::Display() {
-  BresenhamSymmetric(begin_.x, begin_.y, end_.x, end_.y, [this](int x, int y) {
-    drawing_board_->SetPixel(x, y, edge_color_);
-  });
-  drawing_board_->SetPixel(begin_.x, begin_.y, vertex_color_);
-  drawing_board_->SetPixel(end_.x, end_.y, vertex_color_);
-  switch (constraint_) {
-    case Constraint::PERPENDICULAR:
-      DisplayLabel(
-          drawing_board_, (begin_ + end_) / 2,
-          std::wstring(kUpTack).append(std::to_wstring(constraint_id_)));
-      break;
-    case Constraint::EQUAL_LENGTH:
-      DisplayLabel(
-          drawing_board_, (begin_ + end_) / 2,
-          std::wstring(kEqualSign).append(std::to_wstring(constraint_id_)));
-      break;
+void Polygon::BeginTransaction() {
+  journal_.clear();
+  in_transaction_ = true;
+  verticies_journaled_ = false;
+  saved_correct_ = correct_;
+}
+
+void Polygon::CommitTransaction(Delta* delta) {
+  in_transaction_ = false;
+  if (delta) {
+    delta->ReleaseIds();
+    delta->entries_.swap(journal_);
+    delta->id_manager_ = id_manager_;
+    delta->verticies_journaled_ = verticies_journaled_;
+  } else {
+    for (auto& entry : journal_)
+      if (entry.type == JournalEntry::Type::ID_RELEASED)
+        id_manager_->Release(entry.id);
   }
+  journal_.clear();
 }
 
-void Polygon::PolygonEdge::AddAfter(PolygonEdge* edge) {
-  edge->prev_ = this;
-  edge->next_ = next_;
-  next_->prev_ = edge;
-  next_ = edge;
+void Polygon::RollbackTransaction() {
+  const auto old_rect = GetBoundingRect();
+  in_transaction_ = false;
+  Replay(journal_);
+  journal_.clear();
+  correct_ = saved_correct_;
+  OnGeometryChanged(old_rect);
 }
 
-void Polygon::PolygonEdge::AddBefore(PolygonEdge* edge) {
-  edge->next_ = this;
-  edge->prev_ = prev_;
-  prev_->next_ = edge;
-  prev_ = edge;
+void Polygon::Revert(Delta* delta, Delta* inverse) {
+  const auto old_rect = GetBoundingRect();
+  BeginTransaction();
+  Replay(delta->entries_);
+  // Reserved ids now belong to |inverse|.
+  delta->entries_.clear();
+  delta->verticies_journaled_ = false;
+  CommitTransaction(inverse);
+  OnGeometryChanged(old_rect);
 }
 
-double Polygon::PolygonEdge::Length() const {
-  return std::sqrt(DistanceSquared(begin_, end_));
+size_t Polygon::GetMemoryUsage() const {
+  size_t chunks = 0;
+  for (auto& chunk : chunks_)
+    chunks += chunk ? chunk->edges.GetMemoryUsage() : 0;
+  return sizeof(*this) + edges_.GetMemoryUsage() + chunks +
+         edge_cells_.capacity() * sizeof(Rect) +
+         (edge_marks_.capacity() + vertex_marks_.capacity()) *
+             sizeof(unsigned int);
 }
 
-bool Polygon::PolygonEdge::OnMouseLButtonDown(
-    DrawingBoard::Point2d const& mouse_pos) {
-  if (DistanceSquared(mouse_pos, begin_) < kMinDistanceFromVertexSquared) {
-    begin_clicked_ = true;
-    is_clicked_ = true;
-    is_edge_clicked_ = false;
-    return true;
-  } else if (DistanceSquared(mouse_pos, end_) < kMinDistanceFromVertexSquared) {
-    begin_clicked_ = false;
-    is_clicked_ = true;
-    is_edge_clicked_ = false;
-    return true;
-  } else if (DistanceToSegmentSquared(begin_, end_, mouse_pos) <
-             kMinDistanceFromEdgeSquared) {
-    begin_clicked_ = false;
-    is_clicked_ = true;
-    is_edge_clicked_ = true;
+uint64_t Polygon::GetFingerprint() const {
+  // FNV-1a over exact coordinates, so that any difference shows.
+  uint64_t hash = 14695981039346656037ull;
+  const auto add = [&hash](uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+      hash ^= (value >> (i * 8)) & 0xff;
+      hash *= 1099511628211ull;
+    }
+  };
+  const auto add_double = [&add](double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    add(bits);
+  };
+  add(Size());
+  for (Index i = 0; i < Size(); ++i) {
+    add_double(x_[i]);
+    add_double(y_[i]);
+    add(static_cast<uint64_t>(constraint_[i]));
+    if (constraint_[i] != Constraint::NONE)
+      add(constrained_edge_[i]);
   }
-  return is_clicked_;
+  add(fill_rule_.has_value() ? static_cast<uint64_t>(fill_rule_.value()) + 1
+                             : 0);
+  return hash;
 }
 
-bool Polygon::PolygonEdge::OnMouseLButtonUp(
-    DrawingBoard::Point2d const& mouse_pos) {
-  is_edge_clicked_ = is_clicked_ = begin_clicked_ = false;
-  return false;
+Polygon::Data Polygon::GetData() const {
+  return {Size(),
+          x_,
+          y_,
+          reinterpret_cast<uint8_t const*>(constraint_),
+          constrained_edge_,
+          edge_color_,
+          vertex_color_,
+          fill_rule_};
 }
 
-bool Polygon::PolygonEdge::OnMouseMove(
-    DrawingBoard::Point2d const& mouse_pos,
-    DrawingBoard::Point2d const& prev_mouse_pos,
-    int max_calls) {
-  if (is_clicked_) {
-    if (mouse_pos == prev_mouse_pos)
-      return true;
-    if (is_edge_clicked_) {
-      MoveByVector(mouse_pos - prev_mouse_pos, max_calls);
-    } else if (begin_clicked_) {
-      SetBegin(mouse_pos, max_calls);
-    } else {
-      SetEnd(mouse_pos, max_calls);
-    }
-    return true;
+Rect Polygon::GetBoundingRect() const {
+  Rect rect(static_cast<int>(std::floor(min_x_)),
+            static_cast<int>(std::floor(min_y_)),
+            static_cast<int>(std::floor(max_x_)) + 1,
+            static_cast<int>(std::floor(max_y_)) + 1);
+  // Labels are drawn to the bottom right of edges' midpoints.
+  if (constraints_) {
+    rect.right += kMaxLabelWidth;
+    rect.bottom += kLabelFontSize;
   }
-  return false;
+  return rect;
 }
 
-bool Polygon::PolygonEdge::MoveWhole(
-    DrawingBoard::Point2d const& mouse_pos,
-    DrawingBoard::Point2d const& prev_mouse_pos) {
-  bool is_clicked = false;
-  auto* ptr = this;
-  do {
-    if (ptr->is_clicked_) {
-      if (mouse_pos == prev_mouse_pos)
-        return true;
-      const DrawingBoard::Point2d vector = mouse_pos - prev_mouse_pos;
-      ptr = this;
-      do {
-        ptr->begin_ = ptr->begin_ + vector;
-        ptr->end_ = ptr->end_ + vector;
-      } while ((ptr = ptr->Next()) != this);
-      return true;
-    }
-  } while ((ptr = ptr->Next()) != this);
-  return false;
+bool Polygon::InPickRange(DrawingBoard::Point2d const& point) const {
+  const auto margin = PickMargin();
+  return point.x >= min_x_ - margin && point.x <= max_x_ + margin &&
+         point.y >= min_y_ - margin && point.y <= max_y_ + margin;
 }
 
-void Polygon::PolygonEdge::OnControllerStateChanged(
-    PolygonController* controller) {
-  is_edge_clicked_ = is_clicked_ = begin_clicked_ = false;
-}
-
-bool Polygon::PolygonEdge::Split(DrawingBoard::Point2d const& mouse_pos) {
-  if (DistanceToSegmentSquared(begin_, end_, mouse_pos) <
-      kMinDistanceFromEdgeSquared) {
-    RemoveConstraint();
-    const auto mid =
-        DrawingBoard::Point2d{(begin_.x + end_.x) / 2, (begin_.y + end_.y) / 2};
-    auto* new_edge =
-        new PolygonEdge(drawing_board_, mid, end_, edge_color_, vertex_color_);
-    new_edge->next_ = next_;
-    next_->prev_ = new_edge;
-    next_ = new_edge;
-    new_edge->prev_ = this;
-    end_ = mid;
-    return true;
+double Polygon::Length(Index edge) const {
+  return std::sqrt(DistanceSquared(Begin(edge), End(edge)));
+}
+
+void Polygon::InsertVertex(Index vertex, DrawingBoard::Point2d const& pos) {
+  if (in_transaction_)
+    journal_.push_back({JournalEntry::Type::VERTEX_INSERTED, Constraint::NONE,
+                        vertex, 0, 0, pos.x, pos.y});
+  UnregisterEdges();
+  if (edges_.Empty()) {
+    min_x_ = max_x_ = pos.x;
+    min_y_ = max_y_ = pos.y;
   }
-  return false;
+  for (Index e = 0; e < Size(); ++e)
+    if (constraint_[e] != Constraint::NONE && constrained_edge_[e] >= vertex)
+      ++constrained_edge_[e];
+  if (grabbed_edge_ >= vertex && grab_ != Grab::NONE)
+    ++grabbed_edge_;
+  edges_.Insert(vertex);
+  BindEdges();
+  x_[vertex] = pos.x;
+  y_[vertex] = pos.y;
+  InvalidateSnapshotFrom(vertex);
+  OnVertexMoved(vertex);
 }
 
-bool Polygon::PolygonEdge::RemoveVertex(DrawingBoard::Point2d const& point,
-                                        PolygonEdge** head,
-                                        int max_calls) {
-  if (DistanceSquared(end_, point) < kMinDistanceFromVertexSquared) {
-    RemoveConstraint();
-    next_->RemoveConstraint();
-    next_->prev_ = prev_;
-    prev_->next_ = next_;
-    next_->SetBegin(begin_, max_calls - 1);
-    if (*head == this)
-      *head = next_;
-    prev_ = this;
-    next_ = this;
-    delete this;
-    return true;
-  } else if (DistanceSquared(begin_, point) < kMinDistanceFromVertexSquared) {
-    RemoveConstraint();
-    prev_->RemoveConstraint();
-    prev_->next_ = next_;
-    next_->prev_ = prev_;
-    prev_->SetEnd(end_, max_calls - 1);
-    if (*head == this)
-      *head = prev_;
-    prev_ = this;
-    next_ = this;
-    delete this;
-    return true;
+void Polygon::EraseVertex(Index vertex) {
+  if (in_transaction_)
+    journal_.push_back({JournalEntry::Type::VERTEX_ERASED, Constraint::NONE,
+                        vertex, 0, 0, x_[vertex], y_[vertex]});
+  UnregisterEdges();
+  // Edge |vertex| - 1 now reaches the vertex after |vertex|.
+  edges_.Erase(vertex);
+  InvalidateSnapshotFrom(vertex);
+  for (Index e = 0; e < Size(); ++e)
+    if (constraint_[e] != Constraint::NONE && constrained_edge_[e] > vertex)
+      --constrained_edge_[e];
+  grab_ = Grab::NONE;
+}
+
+Polygon::Step Polygon::Step::SetBegin(Index edge,
+                                      DrawingBoard::Point2d const& begin,
+                                      DrawingBoard::Point2d const& old_begin,
+                                      int max_calls,
+                                      bool update_prev) {
+  return {Type::SET_BEGIN, edge, 0, begin, old_begin, 0, max_calls,
+          update_prev};
+}
+
+Polygon::Step Polygon::Step::SetEnd(Index edge,
+                                    DrawingBoard::Point2d const& end,
+                                    DrawingBoard::Point2d const& old_end,
+                                    int max_calls,
+                                    bool update_next) {
+  return {Type::SET_END, edge, 0, end, old_end, 0, max_calls, update_next};
+}
+
+Polygon::Step Polygon::Step::SetVertex(Index vertex,
+                                       DrawingBoard::Point2d const& pos) {
+  return {Type::SET_VERTEX, vertex, 0, pos, pos, 0, 0, false};
+}
+
+Polygon::Step Polygon::Step::SetLengthByBegin(Index edge,
+                                              double length,
+                                              int max_calls) {
+  return {Type::SET_LENGTH_BY_BEGIN, edge, 0, {0, 0}, {0, 0}, length,
+          max_calls, false};
+}
+
+Polygon::Step Polygon::Step::SetLengthByEnd(Index edge,
+                                            double length,
+                                            int max_calls) {
+  return {Type::SET_LENGTH_BY_END, edge, 0, {0, 0}, {0, 0}, length,
+          max_calls, false};
+}
+
+Polygon::Step Polygon::Step::SetPerpendicularByBegin(
+    Index edge,
+    Index other,
+    DrawingBoard::Point2d const& begin,
+    int max_calls) {
+  return {Type::SET_PERPENDICULAR_BY_BEGIN, edge, other, begin, begin, 0,
+          max_calls, false};
+}
+
+Polygon::Step Polygon::Step::SetPerpendicularByEnd(
+    Index edge,
+    Index other,
+    DrawingBoard::Point2d const& end,
+    int max_calls) {
+  return {Type::SET_PERPENDICULAR_BY_END, edge, other, end, end, 0,
+          max_calls, false};
+}
+
+void Polygon::Propagate() {
+  while (!worklist_.empty()) {
+    if (cancel_ && cancel_->load(std::memory_order_relaxed)) {
+      worklist_.clear();
+      correct_ = false;
+      return;
+    }
+    const Step step = worklist_.back();
+    worklist_.pop_back();
+    switch (step.type) {
+      case Step::Type::SET_BEGIN:
+        SetBegin(step.edge, step.point, step.old_point, step.max_calls,
+                 step.update_neighbour);
+        break;
+      case Step::Type::SET_END:
+        SetEnd(step.edge, step.point, step.old_point, step.max_calls,
+               step.update_neighbour);
+        break;
+      case Step::Type::SET_VERTEX:
+        SetVertex(step.edge, step.point);
+        break;
+      case Step::Type::SET_LENGTH_BY_BEGIN:
+        SetLengthByBegin(step.edge, step.length, step.max_calls);
+        break;
+      case Step::Type::SET_LENGTH_BY_END:
+        SetLengthByEnd(step.edge, step.length, step.max_calls);
+        break;
+      case Step::Type::SET_PERPENDICULAR_BY_BEGIN:
+        SetPerpendicularByBegin(step.edge, step.other, step.point,
+                                step.max_calls);
+        break;
+      case Step::Type::SET_PERPENDICULAR_BY_END:
+        SetPerpendicularByEnd(step.edge, step.other, step.point,
+                              step.max_calls);
+        break;
+    }
   }
-  return false;
 }
 
-void Polygon::PolygonEdge::SetBegin(DrawingBoard::Point2d const& begin,
-                                    int max_calls) {
-  if (begin_ == begin)
+void Polygon::SetBegin(Index edge,
+                       DrawingBoard::Point2d const& begin,
+                       DrawingBoard::Point2d const& old_begin,
+                       int max_calls,
+                       bool update_prev) {
+  if (old_begin == begin)
     return;
   if (max_calls < 0) {
-    SetIncorrect();
+    correct_ = false;
     return;
   }
-  switch (constraint_) {
+  const auto prev = Prev(edge);
+  const auto other = constrained_edge_[edge];
+  switch (constraint_[edge]) {
     case Constraint::NONE:
-      begin_ = begin;
-      prev_->SetEnd(begin_, max_calls - 1);
+      SetVertex(edge, begin);
+      if (update_prev)
+        Schedule(Step::SetEnd(prev, begin, old_begin, max_calls - 1, false));
       break;
     case Constraint::PERPENDICULAR:
-      if (next_ == constrained_edge_) {
-        begin_ = begin;
-        constrained_edge_->SetPerpendicularByEnd(this, max_calls - 1);
-        prev_->SetEnd(begin_, max_calls - 1);
-      } else if (prev_ == constrained_edge_) {
+      if (prev == other) {
+        const auto end = End(edge);
+        const auto prev_begin = Begin(prev);
         const auto projection_onto_this =
-            ((end_ - begin_) * DotProduct(begin - begin_, end_ - begin_)) /
-            DistanceSquared(end_, begin_);
+            ((end - old_begin) *
+             DotProduct(begin - old_begin, end - old_begin)) /
+            DistanceSquared(end, old_begin);
         const auto projection_onto_prev =
-            ((prev_->end_ - prev_->begin_) *
-             DotProduct(begin - begin_, prev_->end_ - prev_->begin_)) /
-            DistanceSquared(prev_->end_, prev_->begin_);
-        prev_->end_ = begin_ = begin_ + projection_onto_this;
-        prev_->SetPerpendicularByBegin(this, max_calls - 1);
-        end_ = end_ + projection_onto_prev;
-        prev_->end_ = begin_ = begin_ + projection_onto_prev;
-        SetPerpendicularByEnd(prev_, max_calls - 1);
+            ((old_begin - prev_begin) *
+             DotProduct(begin - old_begin, old_begin - prev_begin)) /
+            DistanceSquared(old_begin, prev_begin);
+        const auto moved_begin = old_begin + projection_onto_this;
+        SetVertex(edge, moved_begin);
+        Schedule(Step::SetPerpendicularByEnd(edge, prev,
+                                             end + projection_onto_prev,
+                                             max_calls - 1));
+        Schedule(Step::SetVertex(edge, moved_begin + projection_onto_prev));
+        Schedule(Step::SetPerpendicularByBegin(prev, edge, Begin(prev),
+                                               max_calls - 1));
       } else {
-        begin_ = begin;
-        constrained_edge_->SetPerpendicularByEnd(this, max_calls - 1);
-        prev_->SetEnd(begin_, max_calls - 1);
+        SetVertex(edge, begin);
+        if (update_prev)
+          Schedule(Step::SetEnd(prev, begin, old_begin, max_calls - 1, false));
+        Schedule(Step::SetPerpendicularByEnd(other, edge, End(other),
+                                             max_calls - 1));
       }
       break;
     case Constraint::EQUAL_LENGTH: {
-      if (next_ == constrained_edge_) {
-        begin_ = begin;
-        constrained_edge_->SetLengthByEnd(Length(), max_calls - 1);
-        prev_->SetEnd(begin_, max_calls - 1);
-      } else if (prev_ == constrained_edge_) {
-        const auto vec = end_ - begin_ - prev_->end_ + prev_->begin_;
-        const auto projection = (vec * DotProduct(begin - begin_, vec)) /
+      if (prev == other) {
+        // The previous edge may have already moved the shared vertex.
+        const auto vec = End(edge) - old_begin - Begin(edge) + Begin(prev);
+        const auto projection = (vec * DotProduct(begin - old_begin, vec)) /
                                 DistanceSquared(vec, {0, 0});
-        prev_->end_ = begin_ = begin_ + projection;
-        prev_->SetLengthByBegin(Length(), max_calls - 1);
+        SetVertex(edge, old_begin + projection);
+        Schedule(Step::SetLengthByBegin(prev, Length(edge), max_calls - 1));
       } else {
-        begin_ = begin;
-        constrained_edge_->SetLengthByBegin(Length(), max_calls - 1);
-        prev_->SetEnd(begin_, max_calls - 1);
+        SetVertex(edge, begin);
+        if (update_prev)
+          Schedule(Step::SetEnd(prev, begin, old_begin, max_calls - 1, false));
+        if (Next(edge) == other)
+          Schedule(Step::SetLengthByEnd(other, Length(edge), max_calls - 1));
+        else
+          Schedule(Step::SetLengthByBegin(other, Length(edge), max_calls - 1));
       }
     } break;
   }
 }
 
-void Polygon::PolygonEdge::SetEnd(DrawingBoard::Point2d const& end,
-                                  int max_calls) {
-  if (end == end_)
+void Polygon::SetEnd(Index edge,
+                     DrawingBoard::Point2d const& end,
+                     DrawingBoard::Point2d const& old_end,
+                     int max_calls,
+                     bool update_next) {
+  if (end == old_end)
     return;
   if (max_calls < 0) {
-    SetIncorrect();
+    correct_ = false;
     return;
   }
-  switch (constraint_) {
+  const auto next = Next(edge);
+  const auto other = constrained_edge_[edge];
+  switch (constraint_[edge]) {
     case Constraint::NONE:
-      end_ = end;
-      next_->SetBegin(end_, max_calls - 1);
+      SetVertex(next, end);
+      if (update_next)
+        Schedule(Step::SetBegin(next, end, old_end, max_calls - 1, false));
       break;
     case Constraint::PERPENDICULAR:
-      if (prev_ == constrained_edge_) {
-        end_ = end;
-        constrained_edge_->SetPerpendicularByBegin(this, max_calls - 1);
-        next_->SetBegin(end_, max_calls - 1);
-      } else if (next_ == constrained_edge_) {
+      if (next == other) {
+        const auto begin = Begin(edge);
+        const auto next_end = End(next);
         const auto projection_onto_this =
-            ((end_ - begin_) * DotProduct(end - end_, end_ - begin_)) /
-            DistanceSquared(end_, begin_);
+            ((old_end - begin) * DotProduct(end - old_end, old_end - begin)) /
+            DistanceSquared(old_end, begin);
         const auto projection_onto_next =
-            ((next_->end_ - next_->begin_) *
-             DotProduct(end - end_, next_->end_ - next_->begin_)) /
-            DistanceSquared(next_->end_, next_->begin_);
-        next_->begin_ = end_ = end_ + projection_onto_this;
-        next_->SetPerpendicularByEnd(this, max_calls - 1);
-        begin_ = begin_ + projection_onto_next;
-        next_->begin_ = end_ = end_ + projection_onto_next;
-        SetPerpendicularByBegin(next_, max_calls - 1);
+            ((next_end - old_end) *
+             DotProduct(end - old_end, next_end - old_end)) /
+            DistanceSquared(next_end, old_end);
+        const auto moved_end = old_end + projection_onto_this;
+        SetVertex(next, moved_end);
+        Schedule(Step::SetPerpendicularByBegin(edge, next,
+                                               begin + projection_onto_next,
+                                               max_calls - 1));
+        Schedule(Step::SetVertex(next, moved_end + projection_onto_next));
+        Schedule(Step::SetPerpendicularByEnd(next, edge, End(next),
+                                             max_calls - 1));
       } else {
-        end_ = end;
-        constrained_edge_->SetPerpendicularByBegin(this, max_calls - 1);
-        next_->SetBegin(end_, max_calls - 1);
+        SetVertex(next, end);
+        if (update_next)
+          Schedule(Step::SetBegin(next, end, old_end, max_calls - 1, false));
+        Schedule(Step::SetPerpendicularByBegin(other, edge, Begin(other),
+                                               max_calls - 1));
       }
       break;
     case Constraint::EQUAL_LENGTH: {
-      if (prev_ == constrained_edge_) {
-        end_ = end;
-        constrained_edge_->SetLengthByBegin(Length(), max_calls - 1);
-        next_->SetBegin(end_, max_calls - 1);
-      } else if (next_ == constrained_edge_) {
-        const auto vec = end_ - begin_ - next_->end_ + next_->begin_;
-        const auto projection = ((vec * DotProduct(end - end_, vec)) /
+      if (next == other) {
+        // The next edge may have already moved the shared vertex.
+        const auto vec = old_end - Begin(edge) - End(next) + End(edge);
+        const auto projection = ((vec * DotProduct(end - old_end, vec)) /
                                  DistanceSquared(vec, {0, 0}));
-        next_->begin_ = end_ = end_ + projection;
-        next_->SetLengthByEnd(Length(), max_calls - 1);
+        SetVertex(next, old_end + projection);
+        Schedule(Step::SetLengthByEnd(next, Length(edge), max_calls - 1));
       } else {
-        end_ = end;
-        constrained_edge_->SetLengthByEnd(Length(), max_calls - 1);
-        next_->SetBegin(end_, max_calls - 1);
+        SetVertex(next, end);
+        if (update_next)
+          Schedule(Step::SetBegin(next, end, old_end, max_calls - 1, false));
+        if (Prev(edge) == other)
+          Schedule(Step::SetLengthByBegin(other, Length(edge), max_calls - 1));
+        else
+          Schedule(Step::SetLengthByEnd(other, Length(edge), max_calls - 1));
       }
     } break;
   }
 }
 
-void Polygon::PolygonEdge::MoveByVector(DrawingBoard::Point2d const& vector,
-                                        int max_calls) {
+void Polygon::MoveByVector(Index edge,
+                           DrawingBoard::Point2d const& vector,
+                           int max_calls) {
   if (vector == DrawingBoard::Point2d{0, 0})
     return;
-  const auto old_end = end_;
-  SetBegin(begin_ + vector, max_calls - 1);
-  SetEnd(old_end + vector, max_calls - 1);
+  const auto old_end = End(edge);
+  Schedule(
+      Step::SetBegin(edge, Begin(edge) + vector, Begin(edge), max_calls - 1,
+                     true));
+  Propagate();
+  // The end has to be looked up again, it may have been moved while
+  // propagating the change of the beginning.
+  Schedule(Step::SetEnd(edge, old_end + vector, End(edge), max_calls - 1,
+                        true));
+  Propagate();
 }
 
-bool Polygon::PolygonEdge::SetPerpendicular(PolygonEdge* edge, int max_calls) {
-  if (constraint_ != Constraint::NONE ||
-      edge->constraint_ != Constraint::NONE || constrained_edge_ ||
-      edge->constrained_edge_)
+bool Polygon::SetPerpendicular(Index edge, Index other, int max_calls) {
+  if (constraint_[edge] != Constraint::NONE ||
+      constraint_[other] != Constraint::NONE)
     return false;
-  if (edge->next_ == this || edge->prev_ == this) {
-    if (edge->next_ != this)
-      return edge->SetPerpendicular(this, max_calls - 1);
-    constraint_ = edge->constraint_ = Constraint::PERPENDICULAR;
-    constrained_edge_ = edge;
-    edge->constrained_edge_ = this;
-    constraint_id_ = edge->constraint_id_ = id_manager::Get();
-    const auto circle_center = (end_ + edge->begin_) / 2;
-    if (Colinear(end_, edge->begin_, circle_center)) {
-      const auto edge_len = edge->Length();
-      begin_ = edge->end_ =
-          edge->end_ + ((edge->end_ - edge->begin_) / edge_len *
-                        std::sqrt(edge_len * Length())) *
-                           DrawingBoard::Point2d{0, 1};
+  if (Next(other) == edge || Prev(other) == edge) {
+    if (Next(other) != edge)
+      return SetPerpendicular(other, edge, max_calls - 1);
+    JournalConstraint(edge);
+    JournalConstraint(other);
+    constraint_[edge] = constraint_[other] = Constraint::PERPENDICULAR;
+    constrained_edge_[edge] = other;
+    constrained_edge_[other] = edge;
+    constraint_id_[edge] = constraint_id_[other] = AcquireId();
+    ++constraints_;
+    // |other| precedes |edge|, so they share |edge|'s first vertex.
+    const auto end = End(edge);
+    const auto other_begin = Begin(other);
+    const auto circle_center = (end + other_begin) / 2;
+    if (Colinear(end, other_begin, circle_center)) {
+      const auto other_len = Length(other);
+      SetVertex(edge, Begin(edge) + ((Begin(edge) - other_begin) / other_len *
+                                     std::sqrt(other_len * Length(edge))) *
+                                        DrawingBoard::Point2d{0, 1});
     } else {
-      begin_ = edge->end_ = ClosestPointOnCircle(
-          circle_center, std::sqrt(DistanceSquared(end_, circle_center)),
-          begin_);
+      SetVertex(edge, ClosestPointOnCircle(
+                          circle_center,
+                          std::sqrt(DistanceSquared(end, circle_center)),
+                          Begin(edge)));
     }
   } else {
-    constraint_ = edge->constraint_ = Constraint::PERPENDICULAR;
-    constrained_edge_ = edge;
-    edge->constrained_edge_ = this;
-    constraint_id_ = edge->constraint_id_ = id_manager::Get();
-    edge->SetPerpendicularByBegin(this, max_calls);
+    JournalConstraint(edge);
+    JournalConstraint(other);
+    constraint_[edge] = constraint_[other] = Constraint::PERPENDICULAR;
+    constrained_edge_[edge] = other;
+    constrained_edge_[other] = edge;
+    constraint_id_[edge] = constraint_id_[other] = AcquireId();
+    ++constraints_;
+    Schedule(Step::SetPerpendicularByBegin(other, edge, Begin(other),
+                                           max_calls));
+    Propagate();
   }
   return true;
 }
 
-bool Polygon::PolygonEdge::SetEqualLength(PolygonEdge* edge, int max_calls) {
-  if (constraint_ != Constraint::NONE ||
-      edge->constraint_ != Constraint::NONE || constrained_edge_ ||
-      edge->constrained_edge_)
+bool Polygon::SetEqualLength(Index edge, Index other, int max_calls) {
+  if (constraint_[edge] != Constraint::NONE ||
+      constraint_[other] != Constraint::NONE)
     return false;
-  constraint_ = edge->constraint_ = Constraint::EQUAL_LENGTH;
-  constrained_edge_ = edge;
-  edge->constrained_edge_ = this;
-  constraint_id_ = edge->constraint_id_ = id_manager::Get();
-  if (edge == next_)
-    edge->SetLengthByBegin(Length(), max_calls);
-  else if (edge == prev_)
-    edge->SetLengthByEnd(Length(), max_calls);
+  JournalConstraint(edge);
+  JournalConstraint(other);
+  constraint_[edge] = constraint_[other] = Constraint::EQUAL_LENGTH;
+  constrained_edge_[edge] = other;
+  constrained_edge_[other] = edge;
+  constraint_id_[edge] = constraint_id_[other] = AcquireId();
+  ++constraints_;
+  if (other == Prev(edge))
+    Schedule(Step::SetLengthByEnd(other, Length(edge), max_calls));
   else
-    edge->SetLengthByBegin(Length(), max_calls);
-
+    Schedule(Step::SetLengthByBegin(other, Length(edge), max_calls));
+  Propagate();
   return true;
 }
 
-void Polygon::PolygonEdge::RemoveConstraint() {
-  id_manager::Release(constraint_id_);
-  constraint_id_ = 0;
-  constraint_ = Constraint::NONE;
-  if (constrained_edge_) {
-    constrained_edge_->constraint_id_ = 0;
-    constrained_edge_->constraint_ = Constraint::NONE;
-    constrained_edge_->constrained_edge_ = nullptr;
-    constrained_edge_ = nullptr;
-  }
-}
-
-bool Polygon::PolygonEdge::RemoveConstraint(
-    DrawingBoard::Point2d const& point) {
-  if (DistanceToSegmentSquared(begin_, end_, point) <
-      kMinDistanceFromEdgeSquared) {
-    RemoveConstraint();
-    return true;
+void Polygon::RemoveConstraint(Index edge) {
+  JournalConstraint(edge);
+  ReleaseId(constraint_id_[edge]);
+  constraint_id_[edge] = 0;
+  if (constraint_[edge] != Constraint::NONE) {
+    const auto other = constrained_edge_[edge];
+    JournalConstraint(other);
+    constraint_id_[other] = 0;
+    constraint_[other] = Constraint::NONE;
+    --constraints_;
   }
-  return false;
+  constraint_[edge] = Constraint::NONE;
 }
 
-void Polygon::PolygonEdge::SetLengthByBegin(double length, int max_calls) {
-  if (std::abs(length * length - DistanceSquared(begin_, end_)) <
+void Polygon::SetLengthByBegin(Index edge, double length, int max_calls) {
+  const auto old_begin = Begin(edge);
+  const auto end = End(edge);
+  if (std::abs(length * length - DistanceSquared(old_begin, end)) <
       kVerySmallValue)
     return;
-  auto vec = begin_ - end_;
-  vec = vec / Length();
+  auto vec = old_begin - end;
+  vec = vec / Length(edge);
   vec = vec * length;
-  begin_ = end_ + vec;
-  if (prev_->constraint_ == Constraint::EQUAL_LENGTH) {
+  const auto begin = end + vec;
+  SetVertex(edge, begin);
+  const auto prev = Prev(edge);
+  if (constraint_[prev] == Constraint::EQUAL_LENGTH) {
     auto intersection =
-        CircleIntersection(end_, prev_->begin_, begin_, prev_->end_);
+        CircleIntersection(end, Begin(prev), begin, old_begin);
     if (intersection.has_value()) {
-      if (DistanceSquared(begin_, intersection->p1) <
-          DistanceSquared(begin_, intersection->p2)) {
-        prev_->end_ = begin_ = intersection->p1;
+      if (DistanceSquared(begin, intersection->p1) <
+          DistanceSquared(begin, intersection->p2)) {
+        SetVertex(edge, intersection->p1);
       } else {
-        prev_->end_ = begin_ = intersection->p2;
+        SetVertex(edge, intersection->p2);
       }
       return;
     }
   }
-  prev_->SetEnd(begin_, max_calls - 1);
+  Schedule(Step::SetEnd(prev, begin, old_begin, max_calls - 1, false));
 }
 
-void Polygon::PolygonEdge::SetLengthByEnd(double length, int max_calls) {
-  if (std::abs(length * length - DistanceSquared(begin_, end_)) <
+void Polygon::SetLengthByEnd(Index edge, double length, int max_calls) {
+  const auto begin = Begin(edge);
+  const auto old_end = End(edge);
+  if (std::abs(length * length - DistanceSquared(begin, old_end)) <
       kVerySmallValue)
     return;
-  auto vec = end_ - begin_;
-  vec = vec / Length();
+  auto vec = old_end - begin;
+  vec = vec / Length(edge);
   vec = vec * length;
-  end_ = begin_ + vec;
-  if (next_->constraint_ == Constraint::EQUAL_LENGTH) {
-    auto intersection =
-        CircleIntersection(begin_, next_->end_, end_, next_->begin_);
+  const auto end = begin + vec;
+  const auto next = Next(edge);
+  SetVertex(next, end);
+  if (constraint_[next] == Constraint::EQUAL_LENGTH) {
+    auto intersection = CircleIntersection(begin, End(next), end, old_end);
     if (intersection.has_value()) {
-      if (DistanceSquared(end_, intersection->p1) <
-          DistanceSquared(end_, intersection->p2)) {
-        next_->begin_ = end_ = intersection->p1;
+      if (DistanceSquared(end, intersection->p1) <
+          DistanceSquared(end, intersection->p2)) {
+        SetVertex(next, intersection->p1);
       } else {
-        next_->begin_ = end_ = intersection->p2;
+        SetVertex(next, intersection->p2);
       }
       return;
     }
   }
-  next_->SetBegin(end_, max_calls - 1);
+  Schedule(Step::SetBegin(next, end, old_end, max_calls - 1, false));
 }
 
-void Polygon::PolygonEdge::SetPerpendicularByBegin(PolygonEdge* edge,
-                                                   int max_calls) {
-  auto vec = edge->end_ - edge->begin_;
+void Polygon::SetPerpendicularByBegin(Index edge,
+                                      Index other,
+                                      DrawingBoard::Point2d const& begin,
+                                      int max_calls) {
+  const auto end = End(edge);
+  // The previous edge hasn't been told about |begin| yet.
+  const auto prev = Prev(edge);
+  const auto prev_end = Begin(edge);
+  auto vec = End(other) - Begin(other);
   vec = vec / std::sqrt(DistanceSquared(vec, {0, 0}));
-  vec = vec * Length();
+  vec = vec * std::sqrt(DistanceSquared(begin, end));
   vec = vec * DrawingBoard::Point2d{0, 1};
-  if (DistanceSquared(begin_, end_ + vec) < DistanceSquared(begin_, end_ - vec))
-    begin_ = end_ + vec;
-  else
-    begin_ = end_ - vec;
-  if (Colinear(begin_, end_, prev_->end_)) {
-    begin_ = prev_->end_;
+  const auto new_begin =
+      DistanceSquared(begin, end + vec) < DistanceSquared(begin, end - vec)
+          ? end + vec
+          : end - vec;
+  if (Colinear(new_begin, end, prev_end))
+    return;
+  if (constraint_[prev] == Constraint::PERPENDICULAR) {
+    const auto intersection =
+        IntersectLines(new_begin, end, Begin(prev), prev_end);
+    if (intersection.has_value())
+      SetVertex(edge, intersection.value());
+    else
+      RemoveConstraint(edge);
   } else {
-    if (prev_->constraint_ == Constraint::PERPENDICULAR) {
-      const auto intersection =
-          IntersectLines(begin_, end_, prev_->begin_, prev_->end_);
-      if (intersection.has_value()) {
-        begin_ = prev_->end_ = intersection.value();
-      } else {
-        RemoveConstraint();
-        SetBegin(prev_->end_, max_calls - 1);
-      }
-    } else {
-      prev_->SetEnd(begin_, max_calls - 1);
-    }
+    SetVertex(edge, new_begin);
+    Schedule(Step::SetEnd(prev, new_begin, prev_end, max_calls - 1, false));
   }
 }
 
-void Polygon::PolygonEdge::SetPerpendicularByEnd(PolygonEdge* edge,
-                                                 int max_calls) {
-  auto vec = edge->end_ - edge->begin_;
+void Polygon::SetPerpendicularByEnd(Index edge,
+                                    Index other,
+                                    DrawingBoard::Point2d const& end,
+                                    int max_calls) {
+  const auto begin = Begin(edge);
+  // The next edge hasn't been told about |end| yet.
+  const auto next = Next(edge);
+  const auto next_begin = Begin(next);
+  auto vec = End(other) - Begin(other);
   vec = vec / std::sqrt(DistanceSquared(vec, {0, 0}));
-  vec = vec * Length();
+  vec = vec * std::sqrt(DistanceSquared(begin, end));
   vec = vec * DrawingBoard::Point2d{0, 1};
-  if (DistanceSquared(end_, begin_ + vec) < DistanceSquared(end_, begin_ - vec))
-    end_ = begin_ + vec;
-  else
-    end_ = begin_ - vec;
-  if (Colinear(begin_, end_, next_->begin_)) {
-    end_ = next_->begin_;
+  const auto new_end =
+      DistanceSquared(end, begin + vec) < DistanceSquared(end, begin - vec)
+          ? begin + vec
+          : begin - vec;
+  if (Colinear(begin, new_end, next_begin))
+    return;
+  if (constraint_[next] == Constraint::PERPENDICULAR) {
+    const auto intersection =
+        IntersectLines(begin, new_end, next_begin, End(next));
+    if (intersection.has_value())
+      SetVertex(next, intersection.value());
+    else
+      RemoveConstraint(edge);
   } else {
-    if (next_->constraint_ == Constraint::PERPENDICULAR) {
-      const auto intersection =
-          IntersectLines(begin_, end_, next_->begin_, next_->end_);
-      if (intersection.has_value()) {
-        end_ = next_->begin_ = intersection.value();
-      } else {
-        RemoveConstraint();
-        SetBegin(next_->begin_, max_calls - 1);
-      }
+    SetVertex(next, new_end);
+    Schedule(Step::SetBegin(next, new_end, next_begin, max_calls - 1, false));
+  }
+}
+
+Polygon::Index Polygon::CollectComponent(
+    std::initializer_list<Index> verticies) {
+  if (edge_marks_.size() != Size() || ++visit_epoch_ == 0) {
+    edge_marks_.assign(Size(), 0);
+    vertex_marks_.assign(Size(), 0);
+    visit_epoch_ = 1;
+  }
+  component_.clear();
+  Index moved = 0;
+  const auto mark_vertex = [this, &moved](Index vertex) {
+    if (vertex_marks_[vertex] != visit_epoch_) {
+      vertex_marks_[vertex] = visit_epoch_;
+      ++moved;
+    }
+  };
+  const auto visit = [this](Index edge) {
+    if (constraint_[edge] != Constraint::NONE &&
+        edge_marks_[edge] != visit_epoch_) {
+      edge_marks_[edge] = visit_epoch_;
+      component_.push_back(edge);
+    }
+  };
+  for (auto vertex : verticies) {
+    mark_vertex(vertex);
+    visit(Prev(vertex));
+    visit(vertex);
+  }
+  for (size_t i = 0; i < component_.size(); ++i) {
+    const auto edge = component_[i];
+    mark_vertex(edge);
+    mark_vertex(Next(edge));
+    visit(constrained_edge_[edge]);
+    visit(Prev(edge));
+    visit(Next(edge));
+  }
+  return moved;
+}
+
+void Polygon::SolveLeastSquares(std::initializer_list<Index> fixed) {
+  CollectComponent(fixed);
+  solver_constraints_.clear();
+  for (auto e : component_) {
+    JournalVertex(e);
+    JournalVertex(Next(e));
+    // Each pair is reported once.
+    if (constrained_edge_[e] < e)
+      continue;
+    solver_constraints_.push_back(
+        {constraint_[e] == Constraint::PERPENDICULAR
+             ? solver::ConstraintType::PERPENDICULAR
+             : solver::ConstraintType::EQUAL_LENGTH,
+         e, constrained_edge_[e]});
+  }
+  if (!least_squares_solver_
+           .Solve(Size(), x_, y_, solver_constraints_, fixed, cancel_)
+           .converged)
+    correct_ = false;
+  // Only verticies of constrained edges are moved by the solver.
+  for (auto e : component_) {
+    OnVertexMoved(e);
+    OnVertexMoved(Next(e));
+  }
+}
+
+void Polygon::UpdateEdgeGrid() {
+  if (edge_cells_.size() != Size()) {
+    edge_cells_.resize(Size());
+    for (Index e = 0; e < Size(); ++e)
+      edge_cells_[e] = edge_grid_->GetCells(Begin(e), End(e));
+    edge_grid_->InsertAll(this, edge_cells_);
+  } else {
+    const auto update = [this](Index e) {
+      const auto cells = edge_grid_->GetCells(Begin(e), End(e));
+      if (cells == edge_cells_[e])
+        return;
+      edge_grid_->Erase(this, e, edge_cells_[e]);
+      edge_grid_->Insert(this, e, cells);
+      edge_cells_[e] = cells;
+    };
+    // Once every edge may have moved, e.g. after a transform, each is
+    // updated once instead of once per record.
+    if (moved_edges_.size() >= Size()) {
+      for (Index e = 0; e < Size(); ++e)
+        update(e);
     } else {
-      next_->SetBegin(end_, max_calls - 1);
+      for (auto e : moved_edges_)
+        update(e);
     }
   }
+  moved_edges_.clear();
+}
+
+void Polygon::UnregisterEdges() {
+  for (Index e = 0; e < edge_cells_.size(); ++e)
+    edge_grid_->Erase(this, e, edge_cells_[e]);
+  edge_cells_.clear();
+  moved_edges_.clear();
 }
 
-void Polygon::PolygonEdge::SetIncorrect() {
-  if (!correct_)
+void Polygon::UnregisterEdges(std::vector<Polygon*> polygons) {
+  if (polygons.empty())
     return;
-  correct_ = false;
-  next_->SetIncorrect();
-  prev_->SetIncorrect();
+  std::sort(polygons.begin(), polygons.end(), std::less<Polygon*>());
+  polygons.erase(std::unique(polygons.begin(), polygons.end()),
+                 polygons.end());
+  polygons.front()->edge_grid_->EraseAll(polygons);
+  for (auto* polygon : polygons) {
+    polygon->edge_cells_.clear();
+    polygon->moved_edges_.clear();
+  }
+}
+
+void Polygon::JournalVerticies() {
+  if (!in_transaction_ || verticies_journaled_)
+    return;
+  for (Index i = 0; i < Size(); ++i)
+    JournalVertex(i);
+  verticies_journaled_ = true;
+}
+
+void Polygon::JournalConstraint(Index edge) {
+  InvalidateSnapshot(edge);
+  if (in_transaction_)
+    journal_.push_back({JournalEntry::Type::CONSTRAINT, constraint_[edge], edge,
+                        constrained_edge_[edge], constraint_id_[edge], 0, 0});
+}
+
+IdManager::ID Polygon::AcquireId() {
+  const auto id = id_manager_->Get();
+  if (in_transaction_)
+    journal_.push_back(
+        {JournalEntry::Type::ID_ACQUIRED, Constraint::NONE, 0, 0, id, 0, 0});
+  return id;
+}
+
+void Polygon::ReleaseId(IdManager::ID id) {
+  if (in_transaction_)
+    journal_.push_back(
+        {JournalEntry::Type::ID_RELEASED, Constraint::NONE, 0, 0, id, 0, 0});
+  else
+    id_manager_->Release(id);
+}
+
+void Polygon::Replay(std::vector<JournalEntry> const& entries) {
+  // Constrained edges come and go in pairs.
+  int constrained_edges = 0;
+  for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+    switch (it->type) {
+      case JournalEntry::Type::VERTEX:
+        SetVertex(it->index, {it->x, it->y});
+        break;
+      case JournalEntry::Type::TRANSLATION:
+        Translate({-it->x, -it->y});
+        break;
+      case JournalEntry::Type::MULTIPLICATION:
+        Multiply(DrawingBoard::Point2d{1, 0} /
+                 DrawingBoard::Point2d{it->x, it->y});
+        break;
+      case JournalEntry::Type::CONSTRAINT:
+        if ((constraint_[it->index] == Constraint::NONE) !=
+            (it->constraint == Constraint::NONE))
+          constrained_edges += it->constraint == Constraint::NONE ? -1 : 1;
+        JournalConstraint(it->index);
+        constraint_[it->index] = it->constraint;
+        constrained_edge_[it->index] = it->constrained_edge;
+        constraint_id_[it->index] = it->id;
+        break;
+      case JournalEntry::Type::ID_ACQUIRED:
+        ReleaseId(it->id);
+        break;
+      case JournalEntry::Type::ID_RELEASED:
+        // The id has been kept reserved, it's taken back without asking
+        // the id manager.
+        if (in_transaction_)
+          journal_.push_back({JournalEntry::Type::ID_ACQUIRED,
+                              Constraint::NONE, 0, 0, it->id, 0, 0});
+        break;
+      case JournalEntry::Type::VERTEX_INSERTED:
+        EraseVertex(it->index);
+        break;
+      case JournalEntry::Type::VERTEX_ERASED:
+        InsertVertex(it->index, {it->x, it->y});
+        break;
+    }
+  }
+  constraints_ += constrained_edges / 2;
+}
+
+void Polygon::FitBounds() {
+  const auto [min_x, max_x] = std::minmax_element(x_, x_ + Size());
+  const auto [min_y, max_y] = std::minmax_element(y_, y_ + Size());
+  min_x_ = *min_x;
+  min_y_ = *min_y;
+  max_x_ = *max_x;
+  max_y_ = *max_y;
+}
+
+void Polygon::Translate(DrawingBoard::Point2d const& vector) {
+  JournalVerticies();
+  if (in_transaction_)
+    journal_.push_back({JournalEntry::Type::TRANSLATION, Constraint::NONE, 0, 0,
+                        0, vector.x, vector.y});
+  for (Index i = 0; i < Size(); ++i) {
+    x_[i] += vector.x;
+    y_[i] += vector.y;
+  }
+  OnAllVerticiesMoved();
+  // The latest snapshot is still valid, only drawn elsewhere.
+  if (snapshot_)
+    snapshot_offset_ = snapshot_offset_ + vector;
+  else
+    InvalidateSnapshotFrom(0);
+  min_x_ += vector.x;
+  max_x_ += vector.x;
+  min_y_ += vector.y;
+  max_y_ += vector.y;
+}
+
+void Polygon::Multiply(DrawingBoard::Point2d const& factor) {
+  JournalVerticies();
+  if (in_transaction_)
+    journal_.push_back({JournalEntry::Type::MULTIPLICATION, Constraint::NONE,
+                        0, 0, 0, factor.x, factor.y});
+  // Local pointers let the loop be vectorized.
+  double* const x = x_;
+  double* const y = y_;
+  for (Index i = 0; i < Size(); ++i) {
+    const double old_x = x[i];
+    x[i] = old_x * factor.x - y[i] * factor.y;
+    y[i] = old_x * factor.y + y[i] * factor.x;
+  }
+  OnAllVerticiesMoved();
+  InvalidateSnapshotFrom(0);
+  FitBounds();
+}
+
+void Polygon::OnGeometryChanged(Rect const& old_rect) {
+  // Copies made for solving aren't displayed.
+  if (!drawing_board_) {
+    moved_edges_.clear();
+    return;
+  }
+  UpdateEdgeGrid();
+  drawing_board_->Invalidate(old_rect.Union(GetBoundingRect()));
+}
+
+void Polygon::InvalidateSnapshotFrom(Index vertex) {
+  ResetSnapshot();
+  for (Index c = vertex / kChunkSize; c < chunks_.size(); ++c)
+    chunks_[c].reset();
+}
+
+void Polygon::ResetSnapshot() {
+  snapshot_.reset();
+  if (snapshot_offset_.x == 0 && snapshot_offset_.y == 0)
+    return;
+  snapshot_offset_ = {0, 0};
+  for (auto& chunk : chunks_)
+    chunk.reset();
+}
+
+DrawingBoard::Point2d Polygon::Snapshot::Vertex(
+    Index vertex,
+    DrawingBoard::Point2d const& offset) const {
+  auto const& chunk = *chunks_[vertex / kChunkSize];
+  return {chunk.edges.Get<Chunk::kX>()[vertex % kChunkSize] + offset.x,
+          chunk.edges.Get<Chunk::kY>()[vertex % kChunkSize] + offset.y};
+}
+
+void Polygon::Snapshot::Draw(Canvas* canvas,
+                             DrawingBoard::Point2d const& offset) const {
+  auto* framebuffer = canvas->GetFramebuffer();
+  if (fill_rule_.has_value()) {
+    if (!edge_table_.has_value() || edge_table_offset_.x != offset.x ||
+        edge_table_offset_.y != offset.y) {
+      std::vector<double> x, y;
+      x.reserve(size_);
+      y.reserve(size_);
+      for (auto const& chunk : chunks_) {
+        auto const& edges = chunk->edges;
+        for (size_t i = 0; i < edges.Size(); ++i) {
+          x.push_back(edges.Get<Chunk::kX>()[i] + offset.x);
+          y.push_back(edges.Get<Chunk::kY>()[i] + offset.y);
+        }
+      }
+      edge_table_.emplace(x, y);
+      edge_table_offset_ = offset;
+    }
+    edge_table_->Fill(framebuffer, fill_rule_.value(),
+                      DrawingBoard::ToPixel(kFillColor));
+  }
+  const auto edge_color = DrawingBoard::ToPixel(edge_color_);
+  const auto vertex_color = DrawingBoard::ToPixel(vertex_color_);
+  // Draws the edge of the outline from vertex |e| to vertex |next|.
+  const auto draw_edge = [&](Index e, Index next) {
+    const auto begin = Vertex(e, offset);
+    const auto end = Vertex(next, offset);
+    rasterizer::DrawLine(framebuffer, static_cast<int>(begin.x),
+                         static_cast<int>(begin.y), static_cast<int>(end.x),
+                         static_cast<int>(end.y), edge_color);
+    framebuffer->SetPixel(static_cast<int>(begin.x), static_cast<int>(begin.y),
+                          vertex_color);
+    framebuffer->SetPixel(static_cast<int>(end.x), static_cast<int>(end.y),
+                          vertex_color);
+    // Both verticies of constrained edges are always in the outline.
+    auto const& chunk = *chunks_[e / kChunkSize];
+    const auto id = chunk.edges.Get<Chunk::kConstraintId>()[e % kChunkSize];
+    switch (chunk.edges.Get<Chunk::kConstraint>()[e % kChunkSize]) {
+      case Constraint::PERPENDICULAR:
+        DisplayLabel(canvas, (begin + end) / 2,
+                     std::wstring(kUpTack).append(std::to_wstring(id)));
+        break;
+      case Constraint::EQUAL_LENGTH:
+        DisplayLabel(canvas, (begin + end) / 2,
+                     std::wstring(kEqualSign).append(std::to_wstring(id)));
+        break;
+      case Constraint::NONE:
+        break;
+    }
+  };
+  // Verticies left out of the outline lie within kOutlineTolerance of the
+  // edges drawn instead, so drawing takes time proportional to the detail
+  // which can be seen rather than to the number of verticies.
+  Index previous = 0;
+  for (Index c = 0; c < chunks_.size(); ++c) {
+    chunks_[c]->Simplify();
+    for (auto v : chunks_[c]->outline) {
+      const Index vertex = c * kChunkSize + v;
+      if (vertex)
+        draw_edge(previous, vertex);
+      previous = vertex;
+    }
+  }
+  draw_edge(previous, 0);
+}
+
+Polygon::Delta::Delta(Delta&& other)
+    : id_manager_(other.id_manager_),
+      verticies_journaled_(other.verticies_journaled_) {
+  entries_.swap(other.entries_);
+  other.verticies_journaled_ = false;
+}
+
+Polygon::Delta& Polygon::Delta::operator=(Delta&& other) {
+  ReleaseIds();
+  entries_.clear();
+  entries_.swap(other.entries_);
+  id_manager_ = other.id_manager_;
+  verticies_journaled_ = other.verticies_journaled_;
+  other.verticies_journaled_ = false;
+  return *this;
+}
+
+Polygon::Delta::~Delta() {
+  ReleaseIds();
+}
+
+void Polygon::Delta::Append(Delta&& later) {
+  if (!later.Empty())
+    id_manager_ = later.id_manager_;
+  const auto moves_verticies = [](JournalEntry const& entry) {
+    return entry.type == JournalEntry::Type::VERTEX ||
+           entry.type == JournalEntry::Type::TRANSLATION ||
+           entry.type == JournalEntry::Type::MULTIPLICATION;
+  };
+  for (auto& entry : later.entries_) {
+    // Reverting restores all verticies from the earlier records last.
+    if (verticies_journaled_ && moves_verticies(entry))
+      continue;
+    if (entry.type == JournalEntry::Type::TRANSLATION && !entries_.empty() &&
+        entries_.back().type == JournalEntry::Type::TRANSLATION) {
+      entries_.back().x += entry.x;
+      entries_.back().y += entry.y;
+    } else {
+      entries_.push_back(entry);
+    }
+  }
+  verticies_journaled_ = verticies_journaled_ || later.verticies_journaled_;
+  later.entries_.clear();
+  later.verticies_journaled_ = false;
+}
+
+void Polygon::Delta::Compact() {
+  // Indices of verticies stay valid only as long as none is inserted or
+  // erased.
+  for (auto& entry : entries_)
+    if (entry.type == JournalEntry::Type::VERTEX_INSERTED ||
+        entry.type == JournalEntry::Type::VERTEX_ERASED)
+      return;
+  // Reverting restores each vertex from its first record last, overwriting
+  // whatever later records restored.
+  std::unordered_set<Index> seen;
+  const auto last = std::remove_if(
+      entries_.begin(), entries_.end(), [&seen](JournalEntry const& entry) {
+        return entry.type == JournalEntry::Type::VERTEX &&
+               !seen.insert(entry.index).second;
+      });
+  entries_.erase(last, entries_.end());
+  entries_.shrink_to_fit();
+}
+
+size_t Polygon::Delta::GetMemoryUsage() const {
+  return sizeof(*this) + entries_.capacity() * sizeof(JournalEntry);
+}
+
+void Polygon::Delta::ReleaseIds() {
+  for (auto& entry : entries_)
+    if (entry.type == JournalEntry::Type::ID_RELEASED)
+      id_manager_->Release(entry.id);
 }
 }  // namespace gk
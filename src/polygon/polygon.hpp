@@ -4,121 +4,554 @@
 
 #include <Windows.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
 #include <memory>
+#include <optional>
+#include <vector>
 
 #include "../drawing_board/drawing_board.hpp"
+#include "../drawing_board/rect.hpp"
+#include "../drawing_board/snapshot.hpp"
 #include "../id_manager/id_manager.hpp"
+#include "array_block.hpp"
+#include "edge_grid.hpp"
+#include "../rasterizer/edge_table.hpp"
+#include "../solver/least_squares_solver.hpp"
 
 namespace gk {
 class PolygonController;
 
 class Polygon {
  public:
+  using Index = unsigned int;
+  // Candidate edges near a point, as found with EdgeGrid::Query(), in
+  // increasing order.
+  using Edges = std::vector<Index>;
+
+  class Delta;
+  class Snapshot;
+  // Snapshot of the polygon, drawn translated by |offset|.
+  struct PlacedSnapshot {
+    std::shared_ptr<const Snapshot> snapshot;
+    DrawingBoard::Point2d offset;
+    Rect bounding_rect;
+  };
+
+  // Geometry, constraints and colors of a polygon, laid out like in scene
+  // files, see SceneReader. Each array holds |size| elements.
+  struct Data {
+    Index size;
+    double const* x;
+    double const* y;
+    // 0 for unconstrained edges, 1 for perpendicular and 2 for equal length
+    // ones, which are paired with |constrained_edge|.
+    uint8_t const* constraint;
+    uint32_t const* constrained_edge;
+    COLORREF edge_color, vertex_color;
+    std::optional<rasterizer::FillRule> fill_rule;
+  };
+
+  // Method used to satisfy constraints while verticies are being dragged.
+  enum class Solver {
+    // Local propagation described in
+    // Brief_description_of_constraint_algorithm.txt.
+    PROPAGATION,
+    // Global Levenberg-Marquardt, see solver::LeastSquaresSolver.
+    LEAST_SQUARES,
+  };
+
+  // Largest distance from an edge at which it's still picked with the
+  // mouse.
+  static double PickMargin();
+  // Created polygons keep their edges registered in |edge_grid| and take
+  // constraint ids from |id_manager|, both of which have to outlive them.
   static std::unique_ptr<Polygon> CreateSamplePolygon(
-      DrawingBoard* drawing_board);
+      DrawingBoard* drawing_board,
+      EdgeGrid* edge_grid,
+      IdManager* id_manager);
   static std::unique_ptr<Polygon> Create(DrawingBoard* drawing_board,
+                                         EdgeGrid* edge_grid,
+                                         IdManager* id_manager,
                                          DrawingBoard::Point2d const& p1,
                                          DrawingBoard::Point2d const& p2,
                                          DrawingBoard::Point2d const& p3,
                                          COLORREF edge_color,
                                          COLORREF vertex_color);
+  // Copies |data| in bulk, without solving constraints. Returns nothing if
+  // |data| doesn't describe a valid polygon.
+  static std::unique_ptr<Polygon> Create(DrawingBoard* drawing_board,
+                                         EdgeGrid* edge_grid,
+                                         IdManager* id_manager,
+                                         Data const& data);
+
+  Polygon() = default;
+  ~Polygon();
 
-  void Display();
-  bool OnMouseLButtonDown(DrawingBoard::Point2d const& mouse_pos);
+  // Returns the polygon as it is now, reusing the previous snapshot if
+  // nothing changed since but the position of the whole polygon. Verticies
+  // are shared between snapshots in chunks, so that after a drag only chunks
+  // of moved verticies are copied.
+  PlacedSnapshot TakeSnapshot();
+  // Methods picking edges with the mouse only consider candidate |edges|.
+  bool OnMouseLButtonDown(DrawingBoard::Point2d const& mouse_pos,
+                          Edges const& edges);
   bool OnMouseLButtonUp(DrawingBoard::Point2d const& mouse_pos);
-  bool OnMouseMove(DrawingBoard::Point2d const& mouse_pos, bool move_whole);
+  // Moves the grabbed part of the polygon, or the whole polygon if
+  // |move_whole|, after the mouse moved from |from| to |to|. Neither the
+  // edge grid nor the board are touched, so that drags can be solved on a
+  // copy made by CloneForSolving() on another thread. Solving stops early,
+  // leaving the polygon incorrect, once |cancel| is set.
+  void Drag(DrawingBoard::Point2d const& from,
+            DrawingBoard::Point2d const& to,
+            bool move_whole,
+            Solver solver,
+            std::atomic<bool> const* cancel = nullptr);
+  // Copy of the polygon's geometry, constraints and grab. The copy is never
+  // displayed, doesn't register its edges and doesn't own its constraint
+  // ids.
+  std::unique_ptr<Polygon> CloneForSolving() const;
+  // Moves verticies and changes constraints the way the transaction in
+  // progress on |solved|, a copy of the polygon, did. The changes are
+  // journaled by this polygon, |solved| keeps them and drops its journal.
+  void ApplySolved(Polygon* solved);
+  // Maps every vertex z, seen as a complex number, to z * |factor| +
+  // |offset|: rotates and scales the polygon about the origin and moves it,
+  // which keeps constraints satisfied. Like Drag(), touches neither the edge
+  // grid nor the board, so that polygons can be transformed in parallel,
+  // and has to be followed by OnGeometryChanged().
+  void Transform(DrawingBoard::Point2d const& factor,
+                 DrawingBoard::Point2d const& offset);
+  // Whether constrained edges stay long enough for their constraints to be
+  // kept once the polygon is scaled by |scale|.
+  bool CanScale(double scale) const;
+  // Brings the edge grid up to date and reports both |old_rect| and the new
+  // bounding rect as damaged.
+  void OnGeometryChanged(Rect const& old_rect);
   void OnControllerStateChanged(PolygonController* controller);
-  bool AddVertex(DrawingBoard::Point2d const& pos);
-  bool Remove(DrawingBoard::Point2d const& point);
+  bool AddVertex(DrawingBoard::Point2d const& pos, Edges const& edges);
+  bool Remove(DrawingBoard::Point2d const& point, Edges const& edges);
   bool SetPerpendicular(DrawingBoard::Point2d const& p1,
-                        DrawingBoard::Point2d const& p2);
+                        Edges const& edges1,
+                        DrawingBoard::Point2d const& p2,
+                        Edges const& edges2);
   bool SetEqualLength(DrawingBoard::Point2d const& p1,
-                      DrawingBoard::Point2d const& p2);
+                      Edges const& edges1,
+                      DrawingBoard::Point2d const& p2,
+                      Edges const& edges2);
+  // Polygon's interior is filled according to |fill_rule| or not at all.
+  void SetFillRule(std::optional<rasterizer::FillRule> fill_rule);
+  std::optional<rasterizer::FillRule> GetFillRule() const { return fill_rule_; }
+  // Even-odd point in polygon test.
+  bool Contains(DrawingBoard::Point2d const& point);
 
-  std::unique_ptr<Polygon> Clone();
-  bool Correct() { return body_->Correct(); }
-  bool Active();
+  // Starts recording changes, so that RollbackTransaction() can undo them
+  // in time proportional to their size.
+  void BeginTransaction();
+  // If |delta| is given, recorded changes are moved into it so that they can
+  // be reverted later on.
+  void CommitTransaction(Delta* delta = nullptr);
+  // Restores the state from the beginning of the transaction.
+  void RollbackTransaction();
+  // Undoes changes of |delta|, which have to be the latest ones made to the
+  // polygon, leaving it empty. |inverse| receives the changes made by the
+  // call, reverting which redoes |delta|. Bounds aren't fitted again, so
+  // that the call takes time proportional to the size of |delta|.
+  void Revert(Delta* delta, Delta* inverse);
+  // Brings the polygon's entries in the edge grid up to date with verticies
+  // moved since the last update.
+  void UpdateEdgeGrid();
+  // Removes all edges from the edge grid, they are registered again by the
+  // next UpdateEdgeGrid().
+  void UnregisterEdges();
+  // Does what UnregisterEdges() would to each of |polygons|, which share an
+  // edge grid, in a single pass over the grid, see EdgeGrid::EraseAll().
+  static void UnregisterEdges(std::vector<Polygon*> polygons);
+  bool Correct() { return correct_; }
+  bool Active() { return grab_ != Grab::NONE; }
+  // Area covered by the polygon's pixels, including constraint labels. It
+  // may be larger than needed while a vertex is being dragged.
+  Rect GetBoundingRect() const;
+  // Whether |point| is within the pick margin of the polygon's bounding
+  // box. Queries about points failing this test don't look at edges.
+  bool InPickRange(DrawingBoard::Point2d const& point) const;
+  // Approximate number of bytes owned by the polygon.
+  size_t GetMemoryUsage() const;
+  // Hash of the geometry, constraints and fill of the polygon.
+  uint64_t GetFingerprint() const;
+  // Points into the polygon, valid until it changes.
+  Data GetData() const;
 
  private:
-  class PolygonEdge {
-   public:
-    friend std::unique_ptr<Polygon> Polygon::CreateSamplePolygon(
-        DrawingBoard* drawing_board);
-    friend std::unique_ptr<Polygon> Polygon::Clone();
-
-    ~PolygonEdge();
-    PolygonEdge(DrawingBoard* drawing_board,
+  enum class Constraint : unsigned char {
+    NONE,
+    PERPENDICULAR,
+    EQUAL_LENGTH,
+  };
+  // Part of the polygon dragged with the mouse.
+  enum class Grab {
+    NONE,
+    BEGIN,
+    END,
+    EDGE,
+  };
+
+  // Per edge arrays, see |edges_|.
+  using EdgeArrays =
+      ArrayBlock<double, double, Constraint, Index, IdManager::ID>;
+  static constexpr size_t kX = 0, kY = 1, kConstraint = 2,
+                          kConstrainedEdge = 3, kConstraintId = 4;
+
+  // Edge i goes from vertex i to vertex Next(i).
+  Index Size() const { return static_cast<Index>(edges_.Size()); }
+  Index Next(Index edge) const { return edge + 1 == Size() ? 0 : edge + 1; }
+  Index Prev(Index edge) const { return edge == 0 ? Size() - 1 : edge - 1; }
+  DrawingBoard::Point2d Begin(Index edge) const {
+    return {x_[edge], y_[edge]};
+  }
+  DrawingBoard::Point2d End(Index edge) const { return Begin(Next(edge)); }
+  // Number of verticies in a chunk of a snapshot.
+  static constexpr Index kChunkSize = 1024;
+  struct Chunk;
+  // Makes the next TakeSnapshot() copy the chunk of |vertex| again.
+  void InvalidateSnapshot(Index vertex) {
+    ResetSnapshot();
+    if (vertex / kChunkSize < chunks_.size())
+      chunks_[vertex / kChunkSize].reset();
+  }
+  // Drops chunks of all verticies from |vertex| on, e.g. after they
+  // shifted.
+  void InvalidateSnapshotFrom(Index vertex);
+  // Drops the latest snapshot, together with its chunks if the polygon has
+  // been translated since they were copied.
+  void ResetSnapshot();
+
+  void SetVertex(Index vertex, DrawingBoard::Point2d const& pos) {
+    JournalVertex(vertex);
+    x_[vertex] = pos.x;
+    y_[vertex] = pos.y;
+    OnVertexMoved(vertex);
+  }
+  // Schedules both edges of |vertex| for the next UpdateEdgeGrid() and
+  // grows the bounding box to contain the vertex.
+  void OnVertexMoved(Index vertex) {
+    InvalidateSnapshot(vertex);
+    moved_edges_.push_back(Prev(vertex));
+    moved_edges_.push_back(vertex);
+    min_x_ = std::min(min_x_, x_[vertex]);
+    min_y_ = std::min(min_y_, y_[vertex]);
+    max_x_ = std::max(max_x_, x_[vertex]);
+    max_y_ = std::max(max_y_, y_[vertex]);
+  }
+  // Schedules all edges for the next UpdateEdgeGrid().
+  void OnAllVerticiesMoved() {
+    for (Index e = static_cast<Index>(moved_edges_.size()); e < Size(); ++e)
+      moved_edges_.push_back(e);
+  }
+  // Points the per edge arrays into |edges_|, after it may have been
+  // reallocated.
+  void BindEdges() {
+    x_ = edges_.Get<kX>();
+    y_ = edges_.Get<kY>();
+    constraint_ = edges_.Get<kConstraint>();
+    constrained_edge_ = edges_.Get<kConstrainedEdge>();
+    constraint_id_ = edges_.Get<kConstraintId>();
+  }
+  // Shrinks the bounding box back to fit the verticies.
+  void FitBounds();
+  void Translate(DrawingBoard::Point2d const& vector);
+  // Multiplies verticies by |factor| as complex numbers.
+  void Multiply(DrawingBoard::Point2d const& factor);
+  double Length(Index edge) const;
+  // Inserts an unconstrained vertex before |vertex| (or at the end). Both
+  // this and EraseVertex() re-register the whole polygon in the edge grid.
+  void InsertVertex(Index vertex, DrawingBoard::Point2d const& pos);
+  // Erases |vertex| merging both of its edges into one, which keeps the
+  // attributes of the previous one. Edge |vertex| has to be unconstrained.
+  void EraseVertex(Index vertex);
+
+  // Deferred call of one of the solver methods below. Instead of calling
+  // each other recursively, which overflows the stack on large polygons,
+  // solver methods schedule steps on |worklist_|. Steps run in LIFO order,
+  // so a step scheduled last runs first, together with everything it
+  // schedules, just like a nested call would.
+  struct Step {
+    enum class Type : unsigned char {
+      SET_BEGIN,
+      SET_END,
+      SET_VERTEX,
+      SET_LENGTH_BY_BEGIN,
+      SET_LENGTH_BY_END,
+      SET_PERPENDICULAR_BY_BEGIN,
+      SET_PERPENDICULAR_BY_END,
+    };
+    static Step SetBegin(Index edge,
+                         DrawingBoard::Point2d const& begin,
+                         DrawingBoard::Point2d const& old_begin,
+                         int max_calls,
+                         bool update_prev);
+    static Step SetEnd(Index edge,
+                       DrawingBoard::Point2d const& end,
+                       DrawingBoard::Point2d const& old_end,
+                       int max_calls,
+                       bool update_next);
+    static Step SetVertex(Index vertex, DrawingBoard::Point2d const& pos);
+    static Step SetLengthByBegin(Index edge, double length, int max_calls);
+    static Step SetLengthByEnd(Index edge, double length, int max_calls);
+    static Step SetPerpendicularByBegin(Index edge,
+                                        Index other,
+                                        DrawingBoard::Point2d const& begin,
+                                        int max_calls);
+    static Step SetPerpendicularByEnd(Index edge,
+                                      Index other,
+                                      DrawingBoard::Point2d const& end,
+                                      int max_calls);
+
+    Type type;
+    Index edge;
+    Index other;
+    DrawingBoard::Point2d point;
+    DrawingBoard::Point2d old_point;
+    double length;
+    int max_calls;
+    bool update_neighbour;
+  };
+  void Schedule(Step const& step) { worklist_.push_back(step); }
+  // Runs scheduled steps until the worklist is empty.
+  void Propagate();
+
+  // Constraint solver, see Brief_description_of_constraint_algorithm.txt.
+  // |old_begin| (|old_end|) is the position of the vertex as seen by
+  // |edge| before the call. Unless |update_prev| (|update_next|), the
+  // neighbour sharing the vertex is the caller and is left alone.
+  void SetBegin(Index edge,
                 DrawingBoard::Point2d const& begin,
-                DrawingBoard::Point2d const& end,
-                COLORREF edge_color,
-                COLORREF vertex_color);
-    PolygonEdge(PolygonEdge const& other);
-
-    void Display();
-    void AddAfter(PolygonEdge* edge);
-    void AddBefore(PolygonEdge* point);
-    PolygonEdge* Next() { return next_; }
-    DrawingBoard::Point2d const& Begin() const { return begin_; }
-    DrawingBoard::Point2d const& End() const { return end_; }
-    double Length() const;
-    bool Correct() { return correct_; }
-    bool Active() { return is_clicked_; }
-
-    bool OnMouseLButtonDown(DrawingBoard::Point2d const& mouse_pos);
-    bool OnMouseLButtonUp(DrawingBoard::Point2d const& mouse_pos);
-    bool OnMouseMove(DrawingBoard::Point2d const& mouse_pos,
-                     DrawingBoard::Point2d const& prev_mouse_pos,
-                     int max_calls);
-    bool MoveWhole(DrawingBoard::Point2d const& mouse_pos,
-                   DrawingBoard::Point2d const& prev_mouse_pos);
-    void OnControllerStateChanged(PolygonController* controller);
-    bool Split(DrawingBoard::Point2d const& mouse_pos);
-    bool RemoveVertex(DrawingBoard::Point2d const& point,
-                      PolygonEdge** head,
-                      int max_calls);
-    void SetBegin(DrawingBoard::Point2d const& begin, int max_calls);
-    void SetEnd(DrawingBoard::Point2d const& end, int max_calls);
-    void MoveByVector(DrawingBoard::Point2d const& vector, int max_calls);
-
-    bool SetPerpendicular(PolygonEdge* edge, int max_calls);
-    bool SetEqualLength(PolygonEdge* edge, int max_calls);
-    void RemoveConstraint();
-    bool RemoveConstraint(DrawingBoard::Point2d const& point);
-
-   private:
-    void SetLengthByBegin(double length, int max_calls);
-    void SetLengthByEnd(double length, int max_calls);
-    void SetPerpendicularByBegin(PolygonEdge* edge, int max_calls);
-    void SetPerpendicularByEnd(PolygonEdge* edge, int max_calls);
-
-    void SetIncorrect();
-
-    enum class Constraint {
-      NONE,
-      PERPENDICULAR,
-      EQUAL_LENGTH,
+                DrawingBoard::Point2d const& old_begin,
+                int max_calls,
+                bool update_prev);
+  void SetEnd(Index edge,
+              DrawingBoard::Point2d const& end,
+              DrawingBoard::Point2d const& old_end,
+              int max_calls,
+              bool update_next);
+  void MoveByVector(Index edge,
+                    DrawingBoard::Point2d const& vector,
+                    int max_calls);
+  bool SetPerpendicular(Index edge, Index other, int max_calls);
+  bool SetEqualLength(Index edge, Index other, int max_calls);
+  void RemoveConstraint(Index edge);
+  void SetLengthByBegin(Index edge, double length, int max_calls);
+  void SetLengthByEnd(Index edge, double length, int max_calls);
+  // |begin| (|end|) is the position of the moved vertex as seen by |edge|,
+  // the neighbour still sees the one stored in the polygon.
+  void SetPerpendicularByBegin(Index edge,
+                               Index other,
+                               DrawingBoard::Point2d const& begin,
+                               int max_calls);
+  void SetPerpendicularByEnd(Index edge,
+                             Index other,
+                             DrawingBoard::Point2d const& end,
+                             int max_calls);
+
+  // Collects into |component_| constrained edges which may have to be
+  // adjusted after |verticies| move: constrained edges sharing one of them
+  // and, transitively, their partners and constrained neighbours. Returns
+  // the number of verticies that may move, which bounds the work needed to
+  // correct the polygon. Runs in time proportional to the component, not to
+  // the size of the polygon.
+  Index CollectComponent(std::initializer_list<Index> verticies);
+  // Propagation budget for a change of |verticies|.
+  int MaxCalls(std::initializer_list<Index> verticies) {
+    return static_cast<int>(3 * CollectComponent(verticies));
+  }
+  // Undo record of a transaction. Fields other than |type| are meaningful
+  // only for some types.
+  struct JournalEntry {
+    enum class Type : unsigned char {
+      // Vertex |index| was at (|x|, |y|).
+      VERTEX,
+      // All verticies were moved by (|x|, |y|).
+      TRANSLATION,
+      // All verticies were multiplied by (|x|, |y|) as complex numbers.
+      MULTIPLICATION,
+      // Undoing either of the above only brings verticies close to where
+      // they were, VERTEX records of all verticies made before the first of
+      // them in a transaction restore the exact coordinates.
+      // Edge |index| had |constraint|, |constrained_edge| and |id|.
+      CONSTRAINT,
+      // |id| was taken from the id manager.
+      ID_ACQUIRED,
+      // |id| is to be returned to the id manager once the transaction
+      // commits, or once its delta is destroyed.
+      ID_RELEASED,
+      // Vertex |index| was inserted at (|x|, |y|).
+      VERTEX_INSERTED,
+      // Vertex |index| at (|x|, |y|) was erased.
+      VERTEX_ERASED,
     };
+    Type type;
+    Constraint constraint;
+    Index index;
+    Index constrained_edge;
+    IdManager::ID id;
+    double x, y;
+  };
+  void JournalVertex(Index vertex) {
+    if (in_transaction_ && !verticies_journaled_)
+      journal_.push_back({JournalEntry::Type::VERTEX, Constraint::NONE, vertex,
+                          0, 0, x_[vertex], y_[vertex]});
+  }
+  // Records all verticies once per transaction, records of single verticies
+  // made afterwards are redundant.
+  void JournalVerticies();
+  // Has to be called before any of |edge|'s constraint attributes change.
+  void JournalConstraint(Index edge);
+  // Constraint ids are handed out and returned through these, so that ids
+  // aren't reused before a transaction is known to commit.
+  IdManager::ID AcquireId();
+  void ReleaseId(IdManager::ID id);
+  // Undoes |entries| in reverse order. Changes made are journaled if a
+  // transaction is in progress.
+  void Replay(std::vector<JournalEntry> const& entries);
 
-    DrawingBoard* drawing_board_;
+  // Solves constraints affected by moving verticies in |fixed|, which stay
+  // pinned.
+  void SolveLeastSquares(std::initializer_list<Index> fixed);
 
-    DrawingBoard::Point2d begin_, end_;
-    PolygonEdge *next_ = this, *prev_ = this;
-    COLORREF edge_color_ = 0, vertex_color_ = 0;
+  DrawingBoard* drawing_board_ = nullptr;
+  EdgeGrid* edge_grid_ = nullptr;
+  IdManager* id_manager_ = nullptr;
+  COLORREF edge_color_ = 0, vertex_color_ = 0;
 
-    bool is_edge_clicked_ = false;
-    bool is_clicked_ = false;
-    bool begin_clicked_ = false;
+  // Verticies and per edge attributes in a single allocation, so that
+  // creating, cloning and destroying a polygon of any size allocates and
+  // frees them at once.
+  EdgeArrays edges_;
+  // Point into |edges_|, see BindEdges(). Vertex i is the beginning of edge
+  // i and the end of edge i - 1. |constrained_edge_| and |constraint_id_|
+  // are meaningful only if the edge is constrained.
+  double* x_ = nullptr;
+  double* y_ = nullptr;
+  Constraint* constraint_ = nullptr;
+  Index* constrained_edge_ = nullptr;
+  IdManager::ID* constraint_id_ = nullptr;
 
-    Constraint constraint_ = Constraint::NONE;
-    PolygonEdge* constrained_edge_ = nullptr;
-    id_manager::ID constraint_id_ = 0;
+  Grab grab_ = Grab::NONE;
+  Index grabbed_edge_ = 0;
+  bool correct_ = true;
+  // Set while a drag is solved, see Drag().
+  std::atomic<bool> const* cancel_ = nullptr;
 
-    bool correct_ = true;
-  };
+  // Kept between solves, so that propagation doesn't allocate once it has
+  // grown to the size a polygon needs.
+  std::vector<Step> worklist_;
+  solver::LeastSquaresSolver least_squares_solver_;
+  std::vector<solver::Constraint> solver_constraints_;
+  std::vector<Index> component_;
+  // Edges and verticies visited by CollectComponent() are marked with the
+  // current |visit_epoch_|, so marks never have to be cleared.
+  std::vector<unsigned int> edge_marks_, vertex_marks_;
+  unsigned int visit_epoch_ = 0;
+
+  // Cells each edge is registered in, empty if the polygon isn't
+  // registered.
+  std::vector<Rect> edge_cells_;
+  // Edges which may have moved since the last UpdateEdgeGrid(), possibly
+  // repeated. Once there are as many as edges, all edges are updated.
+  std::vector<Index> moved_edges_;
+
+  bool in_transaction_ = false;
+  std::vector<JournalEntry> journal_;
+  // Set once JournalVerticies() recorded all verticies in the transaction.
+  bool verticies_journaled_ = false;
+  // Value from the beginning of the transaction.
+  bool saved_correct_ = true;
+
+  // Bounding box of the verticies. It only grows as verticies move and is
+  // fitted again once a drag ends or verticies are removed.
+  double min_x_ = 0, min_y_ = 0, max_x_ = 0, max_y_ = 0;
+  // Number of constrained pairs of edges, which have labels.
+  unsigned int constraints_ = 0;
+
+  std::optional<rasterizer::FillRule> fill_rule_;
+
+  // Latest snapshot, reset by every change.
+  std::shared_ptr<const Snapshot> snapshot_;
+  // Chunks of the latest snapshot, those which have to be copied again are
+  // null.
+  std::vector<std::shared_ptr<const Chunk>> chunks_;
+  // Translation of the polygon since |snapshot_| was taken.
+  DrawingBoard::Point2d snapshot_offset_ = {0, 0};
+
+  // Disallow copy and assign
+  Polygon& operator=(Polygon&) = delete;
+  Polygon(Polygon&) = delete;
+};
+
+// Immutable copy of a polygon, drawn by the render thread.
+class Polygon::Snapshot {
+ public:
+  // Draws the polygon translated by |offset|.
+  void Draw(Canvas* canvas, DrawingBoard::Point2d const& offset) const;
+
+ private:
+  friend class Polygon;
+
+  Snapshot() = default;
+  DrawingBoard::Point2d Vertex(Index vertex,
+                               DrawingBoard::Point2d const& offset) const;
+
+  Index size_ = 0;
+  std::vector<std::shared_ptr<const Chunk>> chunks_;
+  COLORREF edge_color_ = 0, vertex_color_ = 0;
+  std::optional<rasterizer::FillRule> fill_rule_;
+  // Built by the render thread when the snapshot is first filled, or filled
+  // at another offset.
+  mutable std::optional<rasterizer::EdgeTable> edge_table_;
+  mutable DrawingBoard::Point2d edge_table_offset_ = {0, 0};
+
+  // Disallow copy and assign
+  Snapshot& operator=(Snapshot&) = delete;
+  Snapshot(Snapshot&) = delete;
+};
+
+// Changes made to a polygon by a transaction, stored as the undo records of
+// its journal: only what changed is kept. Ids of constraints removed by the
+// changes stay reserved while the delta exists, so that reverting it can
+// bring back the same labels.
+class Polygon::Delta {
+ public:
+  Delta() = default;
+  Delta(Delta&& other);
+  Delta& operator=(Delta&& other);
+  ~Delta();
+
+  bool Empty() const { return entries_.empty(); }
+  // Appends |later| changes of the same polygon, leaving |later| empty.
+  // Consecutive translations are merged and records of verticies made after
+  // all of them have been recorded are dropped.
+  void Append(Delta&& later);
+  // Drops records which don't affect the result of reverting the delta,
+  // i.e. all but the first record of each moved vertex.
+  void Compact();
+  size_t GetMemoryUsage() const;
+
+ private:
+  friend class Polygon;
+
+  // Returns ids reserved by |entries_| to |id_manager_|.
+  void ReleaseIds();
 
-  DrawingBoard* drawing_board_;
+  std::vector<JournalEntry> entries_;
+  IdManager* id_manager_ = nullptr;
+  // Set if |entries_| record all verticies, see JournalVerticies().
+  bool verticies_journaled_ = false;
 
-  std::unique_ptr<PolygonEdge> body_;
-  unsigned int nverticies_ = 0;
+  // Disallow copy and assign
+  Delta& operator=(Delta&) = delete;
+  Delta(Delta&) = delete;
 };
 }  // namespace gk
@@ -0,0 +1,98 @@
+// Copyright Wojciech Replin 2019
+
+#include "edge_table.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "rasterizer.hpp"
+
+namespace gk {
+namespace rasterizer {
+namespace {
+// Index of the first pixel whose center is at or after |coordinate|.
+int FirstPixelAtOrAfter(double coordinate) {
+  return static_cast<int>(std::ceil(coordinate - 0.5));
+}
+}  // namespace
+
+EdgeTable::EdgeTable(std::vector<double> const& x,
+                     std::vector<double> const& y) {
+  const auto n = std::min(x.size(), y.size());
+  edges_.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    const auto j = i + 1 == n ? 0 : i + 1;
+    if (y[i] == y[j])
+      continue;
+    const bool downwards = y[i] < y[j];
+    const auto top = downwards ? i : j;
+    const auto bottom = downwards ? j : i;
+    Edge edge;
+    edge.row_begin = FirstPixelAtOrAfter(y[top]);
+    edge.row_end = FirstPixelAtOrAfter(y[bottom]);
+    if (edge.row_begin >= edge.row_end)
+      continue;
+    edge.x = x[top];
+    edge.y = y[top];
+    edge.dxdy = (x[bottom] - x[top]) / (y[bottom] - y[top]);
+    edge.winding = downwards ? 1 : -1;
+    edges_.push_back(edge);
+    row_end_ = std::max(row_end_, edge.row_end);
+  }
+  std::sort(edges_.begin(), edges_.end(), [](Edge const& a, Edge const& b) {
+    return a.row_begin < b.row_begin;
+  });
+}
+
+void EdgeTable::Fill(Framebuffer* framebuffer,
+                     FillRule rule,
+                     Framebuffer::Pixel color) const {
+  if (edges_.empty())
+    return;
+  const auto& clip = framebuffer->GetClipRect();
+  const int row_begin = std::max(clip.top, edges_.front().row_begin);
+  const int row_end = std::min(clip.bottom, row_end_);
+  if (row_begin >= row_end || clip.Empty())
+    return;
+
+  struct Crossing {
+    double x;
+    int winding;
+  };
+  std::vector<Edge const*> active;
+  std::vector<Crossing> crossings;
+  auto next = edges_.begin();
+  for (int row = row_begin; row < row_end; ++row) {
+    for (; next != edges_.end() && next->row_begin <= row; ++next)
+      active.push_back(&*next);
+    active.erase(std::remove_if(active.begin(), active.end(),
+                                [row](Edge const* edge) {
+                                  return edge->row_end <= row;
+                                }),
+                 active.end());
+
+    const double center = row + 0.5;
+    crossings.clear();
+    for (auto const* edge : active)
+      crossings.push_back(
+          {edge->x + (center - edge->y) * edge->dxdy, edge->winding});
+    std::sort(crossings.begin(), crossings.end(),
+              [](Crossing const& a, Crossing const& b) { return a.x < b.x; });
+
+    int winding = 0;
+    for (size_t i = 0; i + 1 < crossings.size(); ++i) {
+      winding +=
+          rule == FillRule::EVEN_ODD ? 1 : crossings[i].winding;
+      const bool inside =
+          rule == FillRule::EVEN_ODD ? winding % 2 != 0 : winding != 0;
+      if (!inside)
+        continue;
+      const int x_begin = FirstPixelAtOrAfter(crossings[i].x);
+      const int x_end = FirstPixelAtOrAfter(crossings[i + 1].x) - 1;
+      if (x_begin <= x_end)
+        DrawHorizontalSpan(framebuffer, x_begin, x_end, row, color);
+    }
+  }
+}
+}  // namespace rasterizer
+}  // namespace gk
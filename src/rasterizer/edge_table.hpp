@@ -0,0 +1,45 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+#include <vector>
+
+#include "../drawing_board/framebuffer.hpp"
+
+namespace gk {
+namespace rasterizer {
+enum class FillRule {
+  EVEN_ODD,
+  NON_ZERO,
+};
+
+// Sorted edge table of a closed polygon used for scanline filling. It only
+// depends on the polygon's geometry, so it should be built once after every
+// change and reused for subsequent redraws.
+class EdgeTable {
+ public:
+  EdgeTable() = default;
+  // |x| and |y| hold consecutive verticies of the polygon.
+  EdgeTable(std::vector<double> const& x, std::vector<double> const& y);
+
+  // Fills pixels whose centers lie inside the polygon with |color|, one
+  // scanline at a time, using an active edge table.
+  void Fill(Framebuffer* framebuffer,
+            FillRule rule,
+            Framebuffer::Pixel color) const;
+
+ private:
+  struct Edge {
+    // Scanlines crossed by the edge, [row_begin, row_end).
+    int row_begin, row_end;
+    // Upper vertex and inverse slope.
+    double x, y, dxdy;
+    // +1 if the edge goes downwards, -1 otherwise.
+    int winding;
+  };
+  // Sorted by |row_begin|.
+  std::vector<Edge> edges_;
+  int row_end_ = 0;
+};
+}  // namespace rasterizer
+}  // namespace gk
@@ -0,0 +1,216 @@
+// Copyright Wojciech Replin 2019
+
+#include "rasterizer.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GK_RASTERIZER_SSE2
+#endif
+
+namespace gk {
+namespace rasterizer {
+namespace {
+using Pixel = Framebuffer::Pixel;
+
+void FillSpan(Pixel* dst, int length, Pixel color) {
+#if defined(GK_RASTERIZER_SSE2)
+  const __m128i value = _mm_set1_epi32(static_cast<int>(color));
+  for (; length >= 4; length -= 4, dst += 4)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), value);
+#endif
+  for (; length > 0; --length)
+    *dst++ = color;
+}
+
+// Draws pixels from (x, y_begin) to (x, y_end) inclusive.
+void DrawVerticalSpan(Framebuffer* framebuffer,
+                      int x,
+                      int y_begin,
+                      int y_end,
+                      Pixel color) {
+  const auto& clip = framebuffer->GetClipRect();
+  if (x < clip.left || x >= clip.right)
+    return;
+  if (y_begin > y_end)
+    std::swap(y_begin, y_end);
+  y_begin = std::max(y_begin, clip.top);
+  y_end = std::min(y_end, clip.bottom - 1);
+  if (y_begin > y_end)
+    return;
+  const auto stride = framebuffer->GetStride();
+  auto* dst = framebuffer->GetRow(y_begin) + x;
+  for (int y = y_begin; y <= y_end; ++y, dst += stride)
+    *dst = color;
+}
+
+// Same as DrawLine below, for lines which lie entirely inside the clip rect.
+// Walks the framebuffer with raw pointers, |p0| from the beginning and |p1|
+// from the end of the line.
+void DrawUnclippedLine(Framebuffer* framebuffer,
+                       int x0,
+                       int y0,
+                       int x1,
+                       int y1,
+                       Pixel color) {
+  const auto dx = std::abs(x1 - x0);
+  const auto dy = -std::abs(y1 - y0);
+  const auto sx = x0 < x1 ? 1 : -1;
+  const auto step_y = (y0 < y1 ? 1 : -1) * framebuffer->GetStride();
+  auto err = dx + dy;
+  auto* p0 = framebuffer->GetRow(y0) + x0;
+  auto* p1 = framebuffer->GetRow(y1) + x1;
+  if (err > 0) {
+    // Every step moves along x, so pixels between two steps along y make up
+    // a horizontal run.
+    const auto steps = dx / 2;
+    Pixel *run0 = p0, *run1 = p1;
+    int length = 0;
+    const auto fill_runs = [&] {
+      if (sx > 0) {
+        FillSpan(run0, length, color);
+        FillSpan(run1 - (length - 1), length, color);
+      } else {
+        FillSpan(run0 - (length - 1), length, color);
+        FillSpan(run1, length, color);
+      }
+    };
+    for (int i = 0; i < steps; ++i) {
+      const auto e2 = 2 * err;
+      err += dy;
+      p0 += sx;
+      p1 -= sx;
+      if (e2 <= dx) {
+        err += dx;
+        p0 += step_y;
+        p1 -= step_y;
+        if (length) {
+          fill_runs();
+          length = 0;
+        }
+      }
+      if (!length) {
+        run0 = p0;
+        run1 = p1;
+      }
+      ++length;
+    }
+    if (length)
+      fill_runs();
+  } else {
+    // Every step moves along y, runs are at most a couple of pixels long.
+    const auto steps = -dy / 2;
+    for (int i = 0; i < steps; ++i) {
+      const auto e2 = 2 * err;
+      if (e2 >= dy) {
+        err += dy;
+        p0 += sx;
+        p1 -= sx;
+      }
+      err += dx;
+      p0 += step_y;
+      p1 -= step_y;
+      *p0 = color;
+      *p1 = color;
+    }
+  }
+}
+}  // namespace
+
+void DrawHorizontalSpan(Framebuffer* framebuffer,
+                        int x_begin,
+                        int x_end,
+                        int y,
+                        Pixel color) {
+  const auto& clip = framebuffer->GetClipRect();
+  if (y < clip.top || y >= clip.bottom)
+    return;
+  if (x_begin > x_end)
+    std::swap(x_begin, x_end);
+  x_begin = std::max(x_begin, clip.left);
+  x_end = std::min(x_end, clip.right - 1);
+  if (x_begin <= x_end)
+    FillSpan(framebuffer->GetRow(y) + x_begin, x_end - x_begin + 1, color);
+}
+
+// Produces exactly the pixels of the symmetric (double step) Bresenham
+// algorithm: the line is traced from both ends towards the middle and the
+// second half is the first one mirrored about the center. Instead of plotting
+// pixel by pixel, consecutive pixels along the major axis are gathered into
+// runs which are then filled at once.
+void DrawLine(Framebuffer* framebuffer,
+              int x0,
+              int y0,
+              int x1,
+              int y1,
+              Framebuffer::Pixel color) {
+  const Rect bounds(std::min(x0, x1), std::min(y0, y1), std::max(x0, x1) + 1,
+                    std::max(y0, y1) + 1);
+  if (!framebuffer->GetClipRect().Intersects(bounds))
+    return;
+  const auto dx = std::abs(x1 - x0);
+  const auto dy = -std::abs(y1 - y0);
+  const auto sx = x0 < x1 ? 1 : -1;
+  const auto sy = y0 < y1 ? 1 : -1;
+  auto err = dx + dy;
+  const bool x_major = err > 0;
+  const auto steps = x_major ? dx / 2 : -dy / 2;
+  if (steps <= 0)
+    return;
+
+  if (dy == 0) {
+    DrawHorizontalSpan(framebuffer, x0 + sx, x0 + sx * steps, y0, color);
+    DrawHorizontalSpan(framebuffer, x1 - sx * steps, x1 - sx, y1, color);
+    return;
+  }
+  if (dx == 0) {
+    DrawVerticalSpan(framebuffer, x0, y0 + sy, y0 + sy * steps, color);
+    DrawVerticalSpan(framebuffer, x1, y1 - sy * steps, y1 - sy, color);
+    return;
+  }
+
+  if (framebuffer->GetClipRect().Contains(bounds)) {
+    DrawUnclippedLine(framebuffer, x0, y0, x1, y1, color);
+    return;
+  }
+
+  // Draws the run from (ax, ay) to (bx, by) and its mirror image.
+  const auto draw_run = [=](int ax, int ay, int bx, int by) {
+    if (x_major) {
+      DrawHorizontalSpan(framebuffer, ax, bx, ay, color);
+      DrawHorizontalSpan(framebuffer, x0 + x1 - bx, x0 + x1 - ax, y0 + y1 - ay,
+                         color);
+    } else {
+      DrawVerticalSpan(framebuffer, ax, ay, by, color);
+      DrawVerticalSpan(framebuffer, x0 + x1 - ax, y0 + y1 - by, y0 + y1 - ay,
+                       color);
+    }
+  };
+  int x = x0, y = y0;
+  int run_x = 0, run_y = 0, last_x = 0, last_y = 0;
+  for (int i = 0; i < steps; ++i) {
+    const auto e2 = 2 * err;
+    if (e2 >= dy) {
+      err += dy;
+      x += sx;
+    }
+    if (e2 <= dx) {
+      err += dx;
+      y += sy;
+    }
+    if (i == 0 || (x_major ? y != run_y : x != run_x)) {
+      if (i != 0)
+        draw_run(run_x, run_y, last_x, last_y);
+      run_x = x;
+      run_y = y;
+    }
+    last_x = x;
+    last_y = y;
+  }
+  draw_run(run_x, run_y, last_x, last_y);
+}
+}  // namespace rasterizer
+}  // namespace gk
@@ -0,0 +1,26 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+#include "../drawing_board/framebuffer.hpp"
+
+namespace gk {
+namespace rasterizer {
+// Draws pixels from (x_begin, y) to (x_end, y) inclusive. Pixels outside of
+// |framebuffer|'s clip rect are skipped.
+void DrawHorizontalSpan(Framebuffer* framebuffer,
+                        int x_begin,
+                        int x_end,
+                        int y,
+                        Framebuffer::Pixel color);
+
+// Draws a line segment between (x0, y0) and (x1, y1) excluding its endpoints.
+// Pixels outside of |framebuffer| are clipped.
+void DrawLine(Framebuffer* framebuffer,
+              int x0,
+              int y0,
+              int x1,
+              int y1,
+              Framebuffer::Pixel color);
+}  // namespace rasterizer
+}  // namespace gk
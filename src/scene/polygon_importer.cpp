@@ -0,0 +1,350 @@
+// Copyright Wojciech Replin 2019
+
+#include "polygon_importer.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <string_view>
+#include <utility>
+
+namespace gk {
+namespace {
+constexpr std::string_view kByteOrderMark = "\xEF\xBB\xBF";
+
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' ||
+         c == '\v';
+}
+
+bool IsLetter(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+char const* SkipSeparators(char const* p, char const* end) {
+  while (p != end && (IsSpace(*p) || *p == ','))
+    ++p;
+  return p;
+}
+
+// Parses a number following separators at |*p| and moves |*p| past it.
+bool ParseNumber(char const** p, char const* end, double* value) {
+  char const* begin = SkipSeparators(*p, end);
+  // Unlike SVG, std::from_chars doesn't take a plus sign.
+  if (begin != end && *begin == '+')
+    ++begin;
+  const auto result = std::from_chars(begin, end, *value);
+  if (result.ec != std::errc())
+    return false;
+  *p = result.ptr;
+  return true;
+}
+
+// Whether |tag|, the inside of <...>, opens element |name|.
+bool IsElement(std::string_view tag, std::string_view name) {
+  return tag.substr(0, name.size()) == name &&
+         (tag.size() == name.size() || IsSpace(tag[name.size()]) ||
+          tag[name.size()] == '/');
+}
+
+// Value of attribute |name| of |tag|, empty if there's none.
+std::string_view GetAttribute(std::string_view tag, std::string_view name) {
+  for (size_t pos = tag.find(name); pos != std::string_view::npos;
+       pos = tag.find(name, pos + 1)) {
+    if (pos == 0 || !IsSpace(tag[pos - 1]))
+      continue;
+    size_t value = pos + name.size();
+    while (value < tag.size() && IsSpace(tag[value]))
+      ++value;
+    if (value == tag.size() || tag[value] != '=')
+      continue;
+    ++value;
+    while (value < tag.size() && IsSpace(tag[value]))
+      ++value;
+    if (value == tag.size() || (tag[value] != '"' && tag[value] != '\''))
+      continue;
+    const size_t end = tag.find(tag[value], value + 1);
+    if (end == std::string_view::npos)
+      return {};
+    return tag.substr(value + 1, end - value - 1);
+  }
+  return {};
+}
+}  // namespace
+
+void PolygonImporter::Chunk::EndPolygon() {
+  size_t size = x.size() - polygon_begin;
+  if (size > 1 && x.back() == x[polygon_begin] &&
+      y.back() == y[polygon_begin]) {
+    x.pop_back();
+    y.pop_back();
+    --size;
+  }
+  const auto finite = [](double value) { return std::isfinite(value); };
+  if (size < 3 || !std::all_of(x.begin() + polygon_begin, x.end(), finite) ||
+      !std::all_of(y.begin() + polygon_begin, y.end(), finite)) {
+    if (size)
+      SkipPolygon();
+    return;
+  }
+  sizes.push_back(static_cast<Polygon::Index>(size));
+  polygon_begin = x.size();
+}
+
+void PolygonImporter::Chunk::SkipPolygon() {
+  x.resize(polygon_begin);
+  y.resize(polygon_begin);
+  ++skipped;
+}
+
+PolygonImporter::PolygonImporter(WorkerPool* worker_pool, size_t chunk_bytes)
+    : worker_pool_(worker_pool),
+      chunk_bytes_(std::max<size_t>(chunk_bytes, 1)) {}
+
+bool PolygonImporter::Import(std::filesystem::path const& path,
+                             Sink const& sink) {
+  const auto start = std::chrono::steady_clock::now();
+  stats_ = Stats();
+  format_.reset();
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    return false;
+  // As many chunks as there are threads are parsed at once.
+  chunks_.resize(worker_pool_ ? worker_pool_->GetThreads() : 1);
+  std::string carry;
+  bool eof = false;
+  while (!eof) {
+    size_t filled = 0;
+    while (filled < chunks_.size() && !eof) {
+      auto& text = chunks_[filled].text;
+      text.swap(carry);
+      carry.clear();
+      const size_t old_size = text.size();
+      text.resize(old_size + chunk_bytes_);
+      in.read(&text[old_size], chunk_bytes_);
+      const auto read = static_cast<size_t>(in.gcount());
+      text.resize(old_size + read);
+      stats_.bytes += read;
+      eof = read < chunk_bytes_;
+      if (!format_.has_value()) {
+        if (std::string_view(text).substr(0, kByteOrderMark.size()) ==
+            kByteOrderMark) {
+          text.erase(0, kByteOrderMark.size());
+        }
+        const auto first = std::find_if_not(text.begin(), text.end(), IsSpace);
+        if (first != text.end())
+          format_ = *first == '<' ? Format::SVG : Format::TEXT;
+      }
+      if (eof) {
+        ++filled;
+        break;
+      }
+      // Polygons cut by the end of the chunk are carried over to the next
+      // one, which grows until a boundary is found.
+      const size_t boundary =
+          format_.has_value()
+              ? text.find_last_of(format_ == Format::SVG ? '>' : '\n')
+              : std::string::npos;
+      if (boundary == std::string::npos) {
+        carry.swap(text);
+        continue;
+      }
+      carry.assign(text, boundary + 1, std::string::npos);
+      text.resize(boundary + 1);
+      ++filled;
+    }
+    const auto parse = [this](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+        Parse(&chunks_[i]);
+    };
+    if (worker_pool_)
+      worker_pool_->ParallelFor(filled, 1, parse);
+    else
+      parse(0, filled);
+    for (size_t i = 0; i < filled; ++i)
+      Emit(chunks_[i], sink);
+  }
+  stats_.seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  return !in.bad();
+}
+
+void PolygonImporter::Parse(Chunk* chunk) const {
+  chunk->x.clear();
+  chunk->y.clear();
+  chunk->sizes.clear();
+  chunk->skipped = 0;
+  chunk->polygon_begin = 0;
+  if (format_ == Format::SVG)
+    ParseSvg(chunk);
+  else
+    ParseText(chunk);
+}
+
+void PolygonImporter::ParseSvg(Chunk* chunk) {
+  const std::string_view text = chunk->text;
+  size_t pos = 0;
+  while ((pos = text.find('<', pos)) != std::string_view::npos) {
+    if (text.substr(pos, 4) == "<!--") {
+      pos = text.find("-->", pos);
+      if (pos == std::string_view::npos)
+        return;
+      continue;
+    }
+    const size_t tag_end = text.find('>', pos);
+    if (tag_end == std::string_view::npos)
+      return;
+    const auto tag = text.substr(pos + 1, tag_end - pos - 1);
+    if (IsElement(tag, "polygon")) {
+      const auto points = GetAttribute(tag, "points");
+      ParsePoints(points.data(), points.data() + points.size(), chunk);
+    } else if (IsElement(tag, "path")) {
+      const auto d = GetAttribute(tag, "d");
+      ParsePath(d.data(), d.data() + d.size(), chunk);
+    }
+    pos = tag_end + 1;
+  }
+}
+
+void PolygonImporter::ParseText(Chunk* chunk) {
+  char const* p = chunk->text.data();
+  char const* const end = p + chunk->text.size();
+  while (p != end) {
+    char const* const line_end = std::find(p, end, '\n');
+    p = SkipSeparators(p, line_end);
+    if (p != line_end && *p != '#')
+      ParsePoints(p, line_end, chunk);
+    p = line_end == end ? end : line_end + 1;
+  }
+}
+
+void PolygonImporter::ParsePoints(char const* begin,
+                                  char const* end,
+                                  Chunk* chunk) {
+  double x, y;
+  while (ParseNumber(&begin, end, &x)) {
+    if (!ParseNumber(&begin, end, &y)) {
+      chunk->SkipPolygon();
+      return;
+    }
+    chunk->x.push_back(x);
+    chunk->y.push_back(y);
+  }
+  if (SkipSeparators(begin, end) != end)
+    chunk->SkipPolygon();
+  else
+    chunk->EndPolygon();
+}
+
+void PolygonImporter::ParsePath(char const* begin,
+                                char const* end,
+                                Chunk* chunk) {
+  // Polygons of the path are dropped together if any part of it can't be
+  // imported.
+  const size_t path_begin = chunk->x.size();
+  const size_t path_polygons = chunk->sizes.size();
+  const size_t skipped = chunk->skipped;
+  const auto skip_path = [&] {
+    chunk->x.resize(path_begin);
+    chunk->y.resize(path_begin);
+    chunk->sizes.resize(path_polygons);
+    chunk->polygon_begin = path_begin;
+    chunk->skipped = skipped + 1;
+  };
+  const auto add = [chunk](double x, double y) {
+    chunk->x.push_back(x);
+    chunk->y.push_back(y);
+  };
+  char command = 0;
+  // Current point and the beginning of the current subpath.
+  double x = 0, y = 0, start_x = 0, start_y = 0;
+  bool open = false;
+  for (;;) {
+    begin = SkipSeparators(begin, end);
+    if (begin == end)
+      break;
+    if (IsLetter(*begin)) {
+      command = *begin++;
+      if (command == 'Z' || command == 'z') {
+        chunk->EndPolygon();
+        open = false;
+        x = start_x;
+        y = start_y;
+      } else if (std::string_view("MmLlHhVv").find(command) ==
+                 std::string_view::npos) {
+        skip_path();
+        return;
+      }
+      continue;
+    }
+    const bool relative = command >= 'a';
+    double a, b = 0;
+    if (!ParseNumber(&begin, end, &a) ||
+        ((command == 'M' || command == 'm' || command == 'L' ||
+          command == 'l') &&
+         !ParseNumber(&begin, end, &b))) {
+      skip_path();
+      return;
+    }
+    switch (command) {
+      case 'M':
+      case 'm':
+        if (open)
+          chunk->EndPolygon();
+        x = relative ? x + a : a;
+        y = relative ? y + b : b;
+        start_x = x;
+        start_y = y;
+        add(x, y);
+        open = true;
+        // Further pairs are lines.
+        command = relative ? 'l' : 'L';
+        continue;
+      case 'L':
+      case 'l':
+        x = relative ? x + a : a;
+        y = relative ? y + b : b;
+        break;
+      case 'H':
+      case 'h':
+        x = relative ? x + a : a;
+        break;
+      case 'V':
+      case 'v':
+        y = relative ? y + a : a;
+        break;
+      default:
+        // Numbers before any command.
+        skip_path();
+        return;
+    }
+    // A subpath drawn right after Z starts where the previous one did.
+    if (!open) {
+      add(start_x, start_y);
+      open = true;
+    }
+    add(x, y);
+  }
+  if (open)
+    chunk->EndPolygon();
+}
+
+void PolygonImporter::Emit(Chunk const& chunk, Sink const& sink) {
+  size_t first = 0;
+  for (const auto size : chunk.sizes) {
+    if (constraint_.size() < size) {
+      constraint_.resize(size);
+      constrained_edge_.resize(size);
+    }
+    sink({size, chunk.x.data() + first, chunk.y.data() + first,
+          constraint_.data(), constrained_edge_.data(), 0, 0, std::nullopt});
+    first += size;
+  }
+  stats_.polygons += chunk.sizes.size();
+  stats_.verticies += chunk.x.size();
+  stats_.skipped += chunk.skipped;
+}
+}  // namespace gk
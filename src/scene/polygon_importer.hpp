@@ -0,0 +1,99 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "../polygon/polygon.hpp"
+#include "../worker_pool/worker_pool.hpp"
+
+namespace gk {
+// Imports polygons made by other tools from files read chunk by chunk, so
+// that files of any size take memory proportional to the chunks. Numbers
+// are parsed in place in the chunks. The format is told by the first
+// character other than whitespace:
+//   '<' - SVG, every <polygon> element and every subpath of a <path>
+//       element is a polygon. Paths may only consist of straight lines, i.e.
+//       M, L, H, V and Z commands, absolute or relative, other paths are
+//       skipped. Transforms and styles are ignored.
+//   otherwise - text, every line holds "x y" pairs of verticies of one
+//       polygon, separated by whitespace or commas. Lines starting with '#'
+//       are comments.
+// Coordinates are taken as board pixels. A last vertex repeating the first
+// one is dropped, polygons left with fewer than three verticies are
+// skipped.
+class PolygonImporter {
+ public:
+  // Receives imported polygons, without constraints, colors and fill, in
+  // the order of the file, on the thread calling Import().
+  using Sink = std::function<void(Polygon::Data const& polygon)>;
+  struct Stats {
+    uint64_t bytes = 0;
+    size_t polygons = 0;
+    size_t verticies = 0;
+    // Polygons and paths which couldn't be imported.
+    size_t skipped = 0;
+    double seconds = 0;
+  };
+  static constexpr size_t kDefaultChunkBytes = 4 << 20;
+
+  // Chunks are parsed in parallel on |worker_pool|, if given, and passed to
+  // the sink in order.
+  explicit PolygonImporter(WorkerPool* worker_pool = nullptr,
+                           size_t chunk_bytes = kDefaultChunkBytes);
+
+  // Returns false if the file can't be read.
+  bool Import(std::filesystem::path const& path, Sink const& sink);
+  // Statistics of the last import, including time spent in the sink.
+  Stats const& GetStats() const { return stats_; }
+
+ private:
+  enum class Format {
+    SVG,
+    TEXT,
+  };
+  // Text ending at a boundary between polygons and polygons parsed from it.
+  struct Chunk {
+    // Ends the polygon made of verticies added since the previous one.
+    void EndPolygon();
+    // Drops verticies added since the previous polygon, which is skipped.
+    void SkipPolygon();
+
+    std::string text;
+    std::vector<double> x, y;
+    std::vector<Polygon::Index> sizes;
+    size_t skipped = 0;
+    // First vertex of the polygon being parsed.
+    size_t polygon_begin = 0;
+  };
+  void Parse(Chunk* chunk) const;
+  static void ParseSvg(Chunk* chunk);
+  static void ParseText(Chunk* chunk);
+  // Parses the "x y" pairs of a polygon.
+  static void ParsePoints(char const* begin, char const* end, Chunk* chunk);
+  // Parses the "d" attribute of a path.
+  static void ParsePath(char const* begin, char const* end, Chunk* chunk);
+  // Passes polygons of |chunk| to |sink|.
+  void Emit(Chunk const& chunk, Sink const& sink);
+
+  WorkerPool* const worker_pool_;
+  const size_t chunk_bytes_;
+  std::optional<Format> format_;
+  // Reused between batches of chunks parsed at once.
+  std::vector<Chunk> chunks_;
+  // Constraints of imported polygons, none.
+  std::vector<uint8_t> constraint_;
+  std::vector<uint32_t> constrained_edge_;
+  Stats stats_;
+
+  // Disallow copy and assign
+  PolygonImporter& operator=(PolygonImporter&) = delete;
+  PolygonImporter(PolygonImporter&) = delete;
+};
+}  // namespace gk
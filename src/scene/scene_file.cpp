@@ -0,0 +1,191 @@
+// Copyright Wojciech Replin 2019
+
+#include "scene_file.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <optional>
+
+namespace gk {
+namespace {
+constexpr char kMagic[] = {'G', 'K', 'S', 'C'};
+constexpr uint32_t kVersion = 1;
+constexpr uint64_t kAlignment = 8;
+
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint64_t polygons;
+  uint64_t verticies;
+  uint64_t polygon_table;
+  uint64_t x;
+  uint64_t y;
+  uint64_t constrained_edge;
+  uint64_t constraint;
+};
+
+struct PolygonEntry {
+  uint64_t first_vertex;
+  uint32_t size;
+  uint32_t edge_color;
+  uint32_t vertex_color;
+  // 0 if the polygon isn't filled, otherwise 1 + rasterizer::FillRule.
+  uint32_t fill_rule;
+};
+static_assert(sizeof(Header) == 64 && sizeof(PolygonEntry) == 24);
+
+uint64_t Align(uint64_t offset) {
+  return (offset + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// Whether |count| elements of |element_size| bytes at |offset| fit in a file
+// of |size| bytes.
+bool Fits(uint64_t offset,
+          uint64_t count,
+          uint64_t element_size,
+          uint64_t size) {
+  return offset % kAlignment == 0 && offset <= size &&
+         count <= (size - offset) / element_size;
+}
+
+void WritePadding(std::ofstream* out, uint64_t offset) {
+  static constexpr char kZeros[kAlignment] = {};
+  out->write(kZeros, Align(offset) - offset);
+}
+}  // namespace
+
+bool WriteScene(std::filesystem::path const& path,
+                std::vector<Polygon::Data> const& polygons) {
+  Header header = {};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.polygons = polygons.size();
+  for (auto& polygon : polygons)
+    header.verticies += polygon.size;
+  const uint64_t verticies = header.verticies;
+  header.polygon_table = Align(sizeof(Header));
+  header.x = Align(header.polygon_table + polygons.size() *
+                                              sizeof(PolygonEntry));
+  header.y = Align(header.x + verticies * sizeof(double));
+  header.constrained_edge = Align(header.y + verticies * sizeof(double));
+  header.constraint =
+      Align(header.constrained_edge + verticies * sizeof(uint32_t));
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+  WritePadding(&out, sizeof(header));
+  uint64_t first_vertex = 0;
+  for (auto& polygon : polygons) {
+    PolygonEntry entry = {};
+    entry.first_vertex = first_vertex;
+    entry.size = polygon.size;
+    entry.edge_color = polygon.edge_color;
+    entry.vertex_color = polygon.vertex_color;
+    if (polygon.fill_rule.has_value())
+      entry.fill_rule = static_cast<uint32_t>(polygon.fill_rule.value()) + 1;
+    out.write(reinterpret_cast<char const*>(&entry), sizeof(entry));
+    first_vertex += polygon.size;
+  }
+  WritePadding(&out, header.polygon_table +
+                         polygons.size() * sizeof(PolygonEntry));
+  for (auto& polygon : polygons)
+    out.write(reinterpret_cast<char const*>(polygon.x),
+              polygon.size * sizeof(double));
+  for (auto& polygon : polygons)
+    out.write(reinterpret_cast<char const*>(polygon.y),
+              polygon.size * sizeof(double));
+  for (auto& polygon : polygons)
+    out.write(reinterpret_cast<char const*>(polygon.constrained_edge),
+              polygon.size * sizeof(uint32_t));
+  WritePadding(&out, header.constrained_edge + verticies * sizeof(uint32_t));
+  for (auto& polygon : polygons)
+    out.write(reinterpret_cast<char const*>(polygon.constraint),
+              polygon.size);
+  out.flush();
+  return out.good();
+}
+
+SceneReader::SceneReader(std::filesystem::path const& path) {
+  file_ = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ,
+                      nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_ == INVALID_HANDLE_VALUE)
+    return;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file_, &size) ||
+      static_cast<uint64_t>(size.QuadPart) < sizeof(Header)) {
+    return;
+  }
+  mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping_)
+    return;
+  view_ = static_cast<char const*>(
+      MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+  if (!view_)
+    return;
+  good_ = Check(static_cast<uint64_t>(size.QuadPart));
+}
+
+SceneReader::~SceneReader() {
+  if (view_)
+    UnmapViewOfFile(view_);
+  if (mapping_)
+    CloseHandle(mapping_);
+  if (file_ != INVALID_HANDLE_VALUE)
+    CloseHandle(file_);
+}
+
+Polygon::Data SceneReader::GetPolygon(size_t index) const {
+  PolygonEntry entry;
+  std::memcpy(&entry, view_ + polygon_table_ + index * sizeof(PolygonEntry),
+              sizeof(entry));
+  Polygon::Data data = {
+      entry.size,
+      reinterpret_cast<double const*>(view_ + x_) + entry.first_vertex,
+      reinterpret_cast<double const*>(view_ + y_) + entry.first_vertex,
+      reinterpret_cast<uint8_t const*>(view_ + constraint_) +
+          entry.first_vertex,
+      reinterpret_cast<uint32_t const*>(view_ + constrained_edge_) +
+          entry.first_vertex,
+      entry.edge_color,
+      entry.vertex_color,
+      std::nullopt};
+  if (entry.fill_rule)
+    data.fill_rule = static_cast<rasterizer::FillRule>(entry.fill_rule - 1);
+  return data;
+}
+
+bool SceneReader::Check(uint64_t size) {
+  Header header;
+  std::memcpy(&header, view_, sizeof(header));
+  if (!std::equal(header.magic, header.magic + sizeof(kMagic), kMagic) ||
+      header.version != kVersion ||
+      !Fits(header.polygon_table, header.polygons, sizeof(PolygonEntry),
+            size) ||
+      !Fits(header.x, header.verticies, sizeof(double), size) ||
+      !Fits(header.y, header.verticies, sizeof(double), size) ||
+      !Fits(header.constrained_edge, header.verticies, sizeof(uint32_t),
+            size) ||
+      !Fits(header.constraint, header.verticies, sizeof(uint8_t), size)) {
+    return false;
+  }
+  for (uint64_t i = 0; i < header.polygons; ++i) {
+    PolygonEntry entry;
+    std::memcpy(&entry, view_ + header.polygon_table + i * sizeof(entry),
+                sizeof(entry));
+    if (entry.first_vertex > header.verticies ||
+        entry.size > header.verticies - entry.first_vertex ||
+        entry.fill_rule >
+            static_cast<uint32_t>(rasterizer::FillRule::NON_ZERO) + 1) {
+      return false;
+    }
+  }
+  polygons_ = static_cast<size_t>(header.polygons);
+  polygon_table_ = header.polygon_table;
+  x_ = header.x;
+  y_ = header.y;
+  constrained_edge_ = header.constrained_edge;
+  constraint_ = header.constraint;
+  return true;
+}
+}  // namespace gk
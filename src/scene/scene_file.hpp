@@ -0,0 +1,62 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+#include <Windows.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "../polygon/polygon.hpp"
+
+namespace gk {
+// Scene files keep polygons in the layout of Polygon::Data, so that they are
+// loaded by mapping the file into memory and copying arrays in bulk. A file
+// consists of parts following each other, each aligned to 8 bytes:
+//   header: magic, version, numbers of polygons and verticies and offsets
+//       of the parts below,
+//   polygon table: first vertex, size, colors and fill rule of every
+//       polygon,
+//   x and y of all verticies, as doubles,
+//   constrained edge of every edge, as uint32_t, relative to its polygon,
+//   constraint of every edge, as uint8_t.
+// Verticies of a polygon take consecutive elements of every array. Numbers
+// are little-endian.
+
+// Writes |polygons| into a scene file at |path|, part after part.
+bool WriteScene(std::filesystem::path const& path,
+                std::vector<Polygon::Data> const& polygons);
+
+// Maps a scene file into memory. The file is checked when opened in time
+// proportional to the number of polygons, not verticies.
+class SceneReader {
+ public:
+  explicit SceneReader(std::filesystem::path const& path);
+  ~SceneReader();
+
+  // False if the file couldn't be mapped or isn't a scene file.
+  bool Good() const { return good_; }
+  size_t GetPolygonCount() const { return polygons_; }
+  // Points into the mapped file, valid as long as the reader.
+  Polygon::Data GetPolygon(size_t index) const;
+
+ private:
+  // Checks the header and the polygon table.
+  bool Check(uint64_t size);
+
+  HANDLE file_ = INVALID_HANDLE_VALUE;
+  HANDLE mapping_ = NULL;
+  char const* view_ = nullptr;
+  bool good_ = false;
+  size_t polygons_ = 0;
+  // Offsets of the parts of the file.
+  uint64_t polygon_table_ = 0;
+  uint64_t x_ = 0, y_ = 0, constrained_edge_ = 0, constraint_ = 0;
+
+  // Disallow copy and assign
+  SceneReader& operator=(SceneReader&) = delete;
+  SceneReader(SceneReader&) = delete;
+};
+}  // namespace gk
@@ -0,0 +1,316 @@
+// Copyright Wojciech Replin 2019
+
+#include "least_squares_solver.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace gk {
+namespace solver {
+namespace {
+constexpr int kMaxIterations = 50;
+constexpr int kMaxConjugateGradientIterations = 200;
+// Constraints are considered satisfied once every residual drops below this
+// value. For perpendicular edges it's the cosine of the angle between them.
+constexpr double kTolerance = 1e-9;
+constexpr double kInitialDamping = 1e-3;
+constexpr double kMinDamping = 1e-9;
+constexpr double kMaxDamping = 1e9;
+// Columns of the Jacobian are never scaled down below this fraction of the
+// largest one, so that damping keeps the system positive definite.
+constexpr double kMinRelativeDiagonal = 1e-6;
+constexpr double kVerySmallValue = 1e-12;
+// Collapsing an edge to a point trivially satisfies both kinds of
+// constraints, such solutions are rejected.
+constexpr double kMinRelativeLengthSquared = 1e-6;
+
+double DotProduct(std::vector<double> const& a, std::vector<double> const& b) {
+  double ret = 0;
+  for (size_t i = 0; i < a.size(); ++i)
+    ret += a[i] * b[i];
+  return ret;
+}
+
+double MaxAbs(std::vector<double> const& values) {
+  double ret = 0;
+  for (auto value : values)
+    ret = std::max(ret, std::abs(value));
+  return ret;
+}
+}  // namespace
+
+LeastSquaresSolver::Result LeastSquaresSolver::Solve(
+    unsigned int size,
+    double* x,
+    double* y,
+    std::vector<Constraint> const& constraints,
+    std::initializer_list<unsigned int> fixed,
+    std::atomic<bool> const* cancel) {
+  Gather(size, x, y, constraints, fixed);
+  Rescale();
+  initial_scale_ = scale_;
+
+  Result result;
+  const auto verticies = verticies_.size();
+  auto cost = Evaluate(x_, y_);
+  auto damping = kInitialDamping;
+  for (; result.iterations < kMaxIterations; ++result.iterations) {
+    if (MaxAbs(residuals_) < kTolerance ||
+        (cancel && cancel->load(std::memory_order_relaxed)))
+      break;
+    Linearize();
+    bool improved = false;
+    while (!improved && damping < kMaxDamping) {
+      SolveNormalEquations(damping);
+      trial_x_.resize(verticies);
+      trial_y_.resize(verticies);
+      for (size_t i = 0; i < verticies; ++i) {
+        trial_x_[i] = x_[i] + step_[2 * i];
+        trial_y_[i] = y_[i] + step_[2 * i + 1];
+      }
+      if (Evaluate(trial_x_, trial_y_) < cost) {
+        x_.swap(trial_x_);
+        y_.swap(trial_y_);
+        Rescale();
+        cost = Evaluate(x_, y_);
+        damping = std::max(damping / 3, kMinDamping);
+        improved = true;
+      } else {
+        damping *= 4;
+      }
+    }
+    if (!improved) {
+      // Residuals describe the last rejected step.
+      Evaluate(x_, y_);
+      break;
+    }
+  }
+  result.residual = MaxAbs(residuals_);
+  result.converged = result.residual < kTolerance && !Degenerate();
+
+  for (size_t i = 0; i < verticies; ++i) {
+    x[verticies_[i]] = x_[i];
+    y[verticies_[i]] = y_[i];
+  }
+  return result;
+}
+
+void LeastSquaresSolver::Gather(unsigned int size,
+                                double const* x,
+                                double const* y,
+                                std::vector<Constraint> const& constraints,
+                                std::initializer_list<unsigned int> fixed) {
+  const auto next = [size](unsigned int vertex) {
+    return vertex + 1 == size ? 0 : vertex + 1;
+  };
+  verticies_.clear();
+  for (const auto& constraint : constraints) {
+    verticies_.push_back(constraint.edge);
+    verticies_.push_back(next(constraint.edge));
+    verticies_.push_back(constraint.other);
+    verticies_.push_back(next(constraint.other));
+  }
+  std::sort(verticies_.begin(), verticies_.end());
+  verticies_.erase(std::unique(verticies_.begin(), verticies_.end()),
+                   verticies_.end());
+  const auto local = [this](unsigned int vertex) {
+    return static_cast<unsigned int>(
+        std::lower_bound(verticies_.begin(), verticies_.end(), vertex) -
+        verticies_.begin());
+  };
+
+  equations_.resize(constraints.size());
+  for (size_t i = 0; i < constraints.size(); ++i) {
+    const auto& constraint = constraints[i];
+    equations_[i] = {constraint.type, local(constraint.edge),
+                     local(next(constraint.edge)), local(constraint.other),
+                     local(next(constraint.other))};
+  }
+  x_.resize(verticies_.size());
+  y_.resize(verticies_.size());
+  for (size_t i = 0; i < verticies_.size(); ++i) {
+    x_[i] = x[verticies_[i]];
+    y_[i] = y[verticies_[i]];
+  }
+  fixed_.assign(verticies_.size(), false);
+  for (auto vertex : fixed) {
+    const auto i = local(vertex);
+    if (i < verticies_.size() && verticies_[i] == vertex)
+      fixed_[i] = true;
+  }
+}
+
+void LeastSquaresSolver::Rescale() {
+  scale_.resize(equations_.size());
+  for (size_t i = 0; i < equations_.size(); ++i) {
+    const auto& equation = equations_[i];
+    const auto edge_length_squared =
+        std::pow(x_[equation.edge_end] - x_[equation.edge_begin], 2) +
+        std::pow(y_[equation.edge_end] - y_[equation.edge_begin], 2);
+    const auto other_length_squared =
+        std::pow(x_[equation.other_end] - x_[equation.other_begin], 2) +
+        std::pow(y_[equation.other_end] - y_[equation.other_begin], 2);
+    scale_[i] = equation.type == ConstraintType::PERPENDICULAR
+                    ? std::sqrt(edge_length_squared * other_length_squared)
+                    : (edge_length_squared + other_length_squared) / 2;
+    if (scale_[i] < kVerySmallValue)
+      scale_[i] = 1;
+  }
+}
+
+bool LeastSquaresSolver::Degenerate() const {
+  for (size_t i = 0; i < equations_.size(); ++i) {
+    const auto& equation = equations_[i];
+    for (auto [begin, end] : {std::make_pair(equation.edge_begin,
+                                             equation.edge_end),
+                              std::make_pair(equation.other_begin,
+                                             equation.other_end)}) {
+      const auto length_squared =
+          std::pow(x_[end] - x_[begin], 2) + std::pow(y_[end] - y_[begin], 2);
+      if (length_squared < kMinRelativeLengthSquared * initial_scale_[i])
+        return true;
+    }
+  }
+  return false;
+}
+
+double LeastSquaresSolver::Evaluate(std::vector<double> const& x,
+                                    std::vector<double> const& y) {
+  residuals_.resize(equations_.size());
+  double cost = 0;
+  for (size_t i = 0; i < equations_.size(); ++i) {
+    const auto& equation = equations_[i];
+    const auto edge_x = x[equation.edge_end] - x[equation.edge_begin];
+    const auto edge_y = y[equation.edge_end] - y[equation.edge_begin];
+    const auto other_x = x[equation.other_end] - x[equation.other_begin];
+    const auto other_y = y[equation.other_end] - y[equation.other_begin];
+    residuals_[i] =
+        equation.type == ConstraintType::PERPENDICULAR
+            ? (edge_x * other_x + edge_y * other_y) / scale_[i]
+            : (edge_x * edge_x + edge_y * edge_y - other_x * other_x -
+               other_y * other_y) /
+                  scale_[i];
+    cost += residuals_[i] * residuals_[i];
+  }
+  return cost;
+}
+
+void LeastSquaresSolver::Linearize() {
+  rows_.resize(equations_.size());
+  for (size_t i = 0; i < equations_.size(); ++i) {
+    const auto& equation = equations_[i];
+    const auto edge_x = x_[equation.edge_end] - x_[equation.edge_begin];
+    const auto edge_y = y_[equation.edge_end] - y_[equation.edge_begin];
+    const auto other_x = x_[equation.other_end] - x_[equation.other_begin];
+    const auto other_y = y_[equation.other_end] - y_[equation.other_begin];
+
+    auto& row = rows_[i];
+    row.size = 0;
+    // Adjacent edges share a vertex, whose derivatives have to be summed.
+    const auto add = [this, &row](unsigned int vertex, double dx, double dy) {
+      if (fixed_[vertex])
+        return;
+      for (int j = 0; j < row.size; j += 2) {
+        if (row.column[j] == 2 * vertex) {
+          row.value[j] += dx;
+          row.value[j + 1] += dy;
+          return;
+        }
+      }
+      row.column[row.size] = 2 * vertex;
+      row.value[row.size++] = dx;
+      row.column[row.size] = 2 * vertex + 1;
+      row.value[row.size++] = dy;
+    };
+    const auto scale = scale_[i];
+    if (equation.type == ConstraintType::PERPENDICULAR) {
+      add(equation.edge_end, other_x / scale, other_y / scale);
+      add(equation.edge_begin, -other_x / scale, -other_y / scale);
+      add(equation.other_end, edge_x / scale, edge_y / scale);
+      add(equation.other_begin, -edge_x / scale, -edge_y / scale);
+    } else {
+      add(equation.edge_end, 2 * edge_x / scale, 2 * edge_y / scale);
+      add(equation.edge_begin, -2 * edge_x / scale, -2 * edge_y / scale);
+      add(equation.other_end, -2 * other_x / scale, -2 * other_y / scale);
+      add(equation.other_begin, 2 * other_x / scale, 2 * other_y / scale);
+    }
+  }
+
+  diagonal_.assign(2 * verticies_.size(), 0);
+  gradient_.assign(2 * verticies_.size(), 0);
+  for (size_t i = 0; i < rows_.size(); ++i) {
+    const auto& row = rows_[i];
+    for (int j = 0; j < row.size; ++j) {
+      diagonal_[row.column[j]] += row.value[j] * row.value[j];
+      gradient_[row.column[j]] += row.value[j] * residuals_[i];
+    }
+  }
+  const auto min_diagonal =
+      kMinRelativeDiagonal *
+      *std::max_element(diagonal_.begin(), diagonal_.end());
+  for (auto& value : diagonal_)
+    value = std::max(value, min_diagonal);
+}
+
+void LeastSquaresSolver::SolveNormalEquations(double damping) {
+  const auto size = gradient_.size();
+  step_.assign(size, 0);
+  cg_residual_.resize(size);
+  for (size_t i = 0; i < size; ++i)
+    cg_residual_[i] = -gradient_[i];
+  const auto preconditioned = [this, damping](size_t i) {
+    return cg_residual_[i] / (diagonal_[i] * (1 + damping));
+  };
+
+  const auto tolerance_squared =
+      kVerySmallValue * DotProduct(cg_residual_, cg_residual_);
+  cg_direction_.resize(size);
+  for (size_t i = 0; i < size; ++i)
+    cg_direction_[i] = preconditioned(i);
+  auto rz = DotProduct(cg_residual_, cg_direction_);
+  for (int iteration = 0; iteration < kMaxConjugateGradientIterations;
+       ++iteration) {
+    Multiply(cg_direction_, damping, &cg_product_);
+    const auto curvature = DotProduct(cg_direction_, cg_product_);
+    if (curvature <= 0)
+      break;
+    const auto alpha = rz / curvature;
+    for (size_t i = 0; i < size; ++i) {
+      step_[i] += alpha * cg_direction_[i];
+      cg_residual_[i] -= alpha * cg_product_[i];
+    }
+    if (DotProduct(cg_residual_, cg_residual_) <= tolerance_squared)
+      break;
+    double next_rz = 0;
+    for (size_t i = 0; i < size; ++i)
+      next_rz += cg_residual_[i] * preconditioned(i);
+    const auto beta = next_rz / rz;
+    rz = next_rz;
+    for (size_t i = 0; i < size; ++i)
+      cg_direction_[i] = preconditioned(i) + beta * cg_direction_[i];
+  }
+}
+
+void LeastSquaresSolver::Multiply(std::vector<double> const& in,
+                                  double damping,
+                                  std::vector<double>* out) {
+  jv_.resize(rows_.size());
+  for (size_t i = 0; i < rows_.size(); ++i) {
+    const auto& row = rows_[i];
+    double value = 0;
+    for (int j = 0; j < row.size; ++j)
+      value += row.value[j] * in[row.column[j]];
+    jv_[i] = value;
+  }
+  out->resize(in.size());
+  for (size_t i = 0; i < in.size(); ++i)
+    (*out)[i] = damping * diagonal_[i] * in[i];
+  for (size_t i = 0; i < rows_.size(); ++i) {
+    const auto& row = rows_[i];
+    for (int j = 0; j < row.size; ++j)
+      (*out)[row.column[j]] += row.value[j] * jv_[i];
+  }
+}
+}  // namespace solver
+}  // namespace gk
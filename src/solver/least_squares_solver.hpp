@@ -0,0 +1,117 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+#include <atomic>
+#include <initializer_list>
+#include <vector>
+
+namespace gk {
+namespace solver {
+enum class ConstraintType {
+  PERPENDICULAR,
+  EQUAL_LENGTH,
+};
+
+// Constraint between edges |edge| and |other| of a closed polygon. Edge i
+// goes from vertex i to vertex i + 1.
+struct Constraint {
+  ConstraintType type;
+  unsigned int edge;
+  unsigned int other;
+};
+
+// Global alternative to the propagation solver. Given constraints are
+// solved at once as a nonlinear least squares problem with
+// Levenberg-Marquardt. Each constraint contributes one residual:
+//   perpendicular: dot(e, o) / (|e| |o|)
+//   equal length:  (|e|^2 - |o|^2) / ((|e|^2 + |o|^2) / 2)
+// with the denominators frozen for the duration of a single iteration.
+// The Jacobian has at most 8 nonzeros per row and damped normal equations
+// are solved with preconditioned conjugate gradients, never forming J^T J.
+// Only verticies of constrained edges take part in the solve, so its cost
+// depends on the number of constraints and not on the size of the polygon.
+// Scratch buffers are kept between solves.
+class LeastSquaresSolver {
+ public:
+  struct Result {
+    bool converged = false;
+    int iterations = 0;
+    // Largest absolute residual after the solve.
+    double residual = 0;
+  };
+
+  LeastSquaresSolver() = default;
+
+  // Moves verticies of the polygon (|x|, |y|), of |size| verticies each,
+  // so that |constraints| hold,
+  // keeping verticies listed in |fixed| in place. Verticies not touched by
+  // any of |constraints| don't move either. Solutions in which a
+  // constrained edge collapses to a point are not considered converged.
+  // Iterations stop early once |cancel| is set.
+  Result Solve(unsigned int size,
+               double* x,
+               double* y,
+               std::vector<Constraint> const& constraints,
+               std::initializer_list<unsigned int> fixed,
+               std::atomic<bool> const* cancel = nullptr);
+
+ private:
+  // Constraint with verticies translated to indices into |x_| and |y_|.
+  struct Equation {
+    ConstraintType type;
+    unsigned int edge_begin, edge_end;
+    unsigned int other_begin, other_end;
+  };
+  struct Row {
+    static constexpr int kMaxEntries = 8;
+    int size;
+    unsigned int column[kMaxEntries];
+    double value[kMaxEntries];
+  };
+
+  // Copies verticies of constrained edges into |x_| and |y_| and fills
+  // |equations_| and |fixed_|.
+  void Gather(unsigned int size,
+              double const* x,
+              double const* y,
+              std::vector<Constraint> const& constraints,
+              std::initializer_list<unsigned int> fixed);
+  // Recomputes residual denominators from current edge lengths, so that
+  // residuals stay meaningful as edges change their lengths.
+  void Rescale();
+  // Fills |residuals_| and returns the sum of their squares.
+  double Evaluate(std::vector<double> const& x, std::vector<double> const& y);
+  // Whether any constrained edge has collapsed.
+  bool Degenerate() const;
+  // Fills |rows_| with the Jacobian at (|x_|, |y_|).
+  void Linearize();
+  // Solves (J^T J + damping * D) step = -J^T r for |step_|.
+  void SolveNormalEquations(double damping);
+  // |out| = (J^T J + damping * D) |in|.
+  void Multiply(std::vector<double> const& in,
+                double damping,
+                std::vector<double>* out);
+
+  // Polygon's verticies taking part in the solve, sorted, and their
+  // positions.
+  std::vector<unsigned int> verticies_;
+  std::vector<double> x_, y_;
+  std::vector<char> fixed_;
+  std::vector<Equation> equations_;
+  // Residual denominators, one per equation, and their values at the start
+  // of the solve.
+  std::vector<double> scale_, initial_scale_;
+  std::vector<double> residuals_;
+  std::vector<Row> rows_;
+  // Per local variable: x of vertex i at 2i, y at 2i + 1.
+  std::vector<double> diagonal_, gradient_, step_;
+  std::vector<double> cg_residual_, cg_direction_, cg_product_, jv_;
+  std::vector<double> trial_x_, trial_y_;
+
+  // Disallow copy and assign
+  LeastSquaresSolver& operator=(LeastSquaresSolver&) = delete;
+  LeastSquaresSolver(LeastSquaresSolver&) = delete;
+};
+}  // namespace solver
+}  // namespace gk
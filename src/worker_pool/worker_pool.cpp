@@ -0,0 +1,77 @@
+// Copyright Wojciech Replin 2019
+
+#include "worker_pool.hpp"
+
+#include <algorithm>
+
+namespace gk {
+WorkerPool::WorkerPool(unsigned int threads) {
+  if (!threads)
+    threads = std::max(std::thread::hardware_concurrency(), 1u);
+  workers_.reserve(threads - 1);
+  for (unsigned int i = 1; i < threads; ++i)
+    workers_.emplace_back(&WorkerPool::Run, this);
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_up_.notify_all();
+  for (auto& worker : workers_)
+    worker.join();
+}
+
+void WorkerPool::ParallelFor(size_t count, size_t grain, Body const& body) {
+  grain = std::max<size_t>(grain, 1);
+  if (count <= grain || workers_.empty()) {
+    for (size_t begin = 0; begin < count; begin += grain)
+      body(begin, std::min(begin + grain, count));
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    body_ = &body;
+    count_ = count;
+    grain_ = grain;
+    next_ = 0;
+    ++loop_;
+    busy_ = static_cast<unsigned int>(workers_.size());
+  }
+  wake_up_.notify_all();
+  RunRanges();
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return busy_ == 0; });
+  body_ = nullptr;
+}
+
+void WorkerPool::Run() {
+  uint64_t joined = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    wake_up_.wait(lock, [this, joined] { return stop_ || loop_ != joined; });
+    if (stop_)
+      return;
+    joined = loop_;
+    lock.unlock();
+    RunRanges();
+    lock.lock();
+    if (--busy_ == 0)
+      done_.notify_one();
+  }
+}
+
+void WorkerPool::RunRanges() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (next_ < count_) {
+    const size_t begin = next_;
+    const size_t end = std::min(begin + grain_, count_);
+    next_ = end;
+    Body const& body = *body_;
+    lock.unlock();
+    body(begin, end);
+    lock.lock();
+  }
+}
+}  // namespace gk
@@ -0,0 +1,60 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gk {
+// Threads kept around to run parallel loops, so that a loop doesn't pay for
+// starting threads. Only one loop runs at a time, the calling thread takes
+// part in it.
+class WorkerPool {
+ public:
+  // Body of a loop, called for consecutive ranges [begin, end).
+  using Body = std::function<void(size_t begin, size_t end)>;
+
+  // Runs loops on |threads| threads including the calling one, by default
+  // on as many as there are cores.
+  explicit WorkerPool(unsigned int threads = 0);
+  ~WorkerPool();
+
+  unsigned int GetThreads() const {
+    return static_cast<unsigned int>(workers_.size()) + 1;
+  }
+  // Calls |body| for ranges of at most |grain| indices covering [0, count)
+  // and returns once all calls returned. Loops no longer than |grain| run
+  // on the calling thread alone.
+  void ParallelFor(size_t count, size_t grain, Body const& body);
+
+ private:
+  void Run();
+  // Calls |body_| for ranges not taken yet by other threads.
+  void RunRanges();
+
+  // Guards members below.
+  std::mutex mutex_;
+  std::condition_variable wake_up_;
+  std::condition_variable done_;
+  Body const* body_ = nullptr;
+  size_t count_ = 0;
+  size_t grain_ = 0;
+  size_t next_ = 0;
+  // Incremented for every loop, so that workers join each loop once.
+  uint64_t loop_ = 0;
+  // Workers which haven't finished the current loop.
+  unsigned int busy_ = 0;
+  bool stop_ = false;
+
+  std::vector<std::thread> workers_;
+
+  // Disallow copy and assign
+  WorkerPool& operator=(WorkerPool&) = delete;
+  WorkerPool(WorkerPool&) = delete;
+};
+}  // namespace gk
@@ -0,0 +1,322 @@
+// Copyright Wojciech Replin 2019
+
+// Headless stand-in for the part of Win32 the app uses, which lets the
+// unchanged sources run on any platform. Windows only receive messages sent
+// with SendMessageW, device contexts draw into memory and text is drawn as
+// solid boxes, one per character.
+
+#pragma once
+
+// Like the real header, pulls in the C runtime.
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#define WINAPI
+#define CALLBACK
+#define TEXT(quote) L##quote
+
+using HANDLE = void*;
+using HWND = HANDLE;
+using HDC = HANDLE;
+using HGDIOBJ = HANDLE;
+using HBITMAP = HANDLE;
+using HFONT = HANDLE;
+using HINSTANCE = HANDLE;
+using HCURSOR = HANDLE;
+using HICON = HANDLE;
+using HBRUSH = HANDLE;
+using HMENU = HANDLE;
+using HLOCAL = HANDLE;
+
+using BOOL = int;
+using BYTE = uint8_t;
+using WORD = uint16_t;
+using DWORD = uint32_t;
+using UINT = unsigned int;
+using SHORT = int16_t;
+using LONG = int32_t;
+using LONG_PTR = intptr_t;
+using WPARAM = uintptr_t;
+using LPARAM = intptr_t;
+using LRESULT = intptr_t;
+using COLORREF = DWORD;
+using LPWSTR = wchar_t*;
+using LPTSTR = wchar_t*;
+using PWSTR = wchar_t*;
+using LPCWSTR = const wchar_t*;
+using LPVOID = void*;
+using LPCVOID = const void*;
+
+using WNDPROC = LRESULT (*)(HWND, UINT, WPARAM, LPARAM);
+
+struct POINT {
+  LONG x;
+  LONG y;
+};
+
+struct RECT {
+  LONG left;
+  LONG top;
+  LONG right;
+  LONG bottom;
+};
+
+struct MSG {
+  HWND hwnd;
+  UINT message;
+  WPARAM wParam;
+  LPARAM lParam;
+  DWORD time;
+  POINT pt;
+};
+
+struct WNDCLASSW {
+  UINT style;
+  WNDPROC lpfnWndProc;
+  int cbClsExtra;
+  int cbWndExtra;
+  HINSTANCE hInstance;
+  HICON hIcon;
+  HCURSOR hCursor;
+  HBRUSH hbrBackground;
+  LPCWSTR lpszMenuName;
+  LPCWSTR lpszClassName;
+};
+
+union LARGE_INTEGER {
+  struct {
+    DWORD LowPart;
+    LONG HighPart;
+  };
+  int64_t QuadPart;
+};
+
+struct BITMAPINFOHEADER {
+  DWORD biSize;
+  LONG biWidth;
+  LONG biHeight;
+  WORD biPlanes;
+  WORD biBitCount;
+  DWORD biCompression;
+  DWORD biSizeImage;
+  LONG biXPelsPerMeter;
+  LONG biYPelsPerMeter;
+  DWORD biClrUsed;
+  DWORD biClrImportant;
+};
+
+struct RGBQUAD {
+  BYTE rgbBlue;
+  BYTE rgbGreen;
+  BYTE rgbRed;
+  BYTE rgbReserved;
+};
+
+struct BITMAPINFO {
+  BITMAPINFOHEADER bmiHeader;
+  RGBQUAD bmiColors[1];
+};
+
+#define RGB(r, g, b)                                 \
+  (static_cast<COLORREF>(static_cast<BYTE>(r) |      \
+                         static_cast<BYTE>(g) << 8 | \
+                         static_cast<BYTE>(b) << 16))
+#define GetRValue(rgb) (static_cast<BYTE>(rgb))
+#define GetGValue(rgb) (static_cast<BYTE>((rgb) >> 8))
+#define GetBValue(rgb) (static_cast<BYTE>((rgb) >> 16))
+#define LOWORD(l) (static_cast<WORD>(static_cast<uintptr_t>(l) & 0xffff))
+#define HIWORD(l) (static_cast<WORD>(static_cast<uintptr_t>(l) >> 16 & 0xffff))
+#define MAKELPARAM(low, high)                             \
+  (static_cast<LPARAM>(static_cast<WORD>(low) |           \
+                       static_cast<DWORD>(static_cast<WORD>(high)) << 16))
+#define IDC_CROSS (reinterpret_cast<LPTSTR>(32515))
+#define INVALID_HANDLE_VALUE \
+  (reinterpret_cast<HANDLE>(static_cast<LONG_PTR>(-1)))
+
+constexpr BOOL FALSE = 0;
+constexpr BOOL TRUE = 1;
+
+constexpr UINT WM_DESTROY = 0x0002;
+constexpr UINT WM_PAINT = 0x000F;
+constexpr UINT WM_ERASEBKGND = 0x0014;
+constexpr UINT WM_KEYDOWN = 0x0100;
+constexpr UINT WM_KEYUP = 0x0101;
+constexpr UINT WM_MOUSEMOVE = 0x0200;
+constexpr UINT WM_LBUTTONDOWN = 0x0201;
+constexpr UINT WM_LBUTTONUP = 0x0202;
+constexpr UINT WM_LBUTTONDBLCLK = 0x0203;
+constexpr UINT WM_APP = 0x8000;
+
+constexpr int VK_CONTROL = 0x11;
+constexpr int VK_SPACE = 0x20;
+
+constexpr UINT PM_NOREMOVE = 0x0000;
+constexpr UINT PM_REMOVE = 0x0001;
+
+constexpr DWORD WS_OVERLAPPEDWINDOW = 0x00CF0000;
+constexpr DWORD WS_THICKFRAME = 0x00040000;
+constexpr DWORD WS_MAXIMIZEBOX = 0x00010000;
+constexpr UINT CS_DBLCLKS = 0x0008;
+constexpr int GWLP_USERDATA = -21;
+constexpr int SW_MINIMIZE = 6;
+constexpr int SW_RESTORE = 9;
+
+constexpr DWORD BI_RGB = 0;
+constexpr UINT DIB_RGB_COLORS = 0;
+constexpr DWORD SRCCOPY = 0x00CC0020;
+constexpr int TRANSPARENT = 1;
+constexpr UINT DT_SINGLELINE = 0x0020;
+constexpr UINT DT_NOCLIP = 0x0100;
+constexpr UINT DT_CALCRECT = 0x0400;
+
+constexpr int FW_THIN = 100;
+constexpr DWORD DEFAULT_CHARSET = 1;
+constexpr DWORD OUT_OUTLINE_PRECIS = 8;
+constexpr DWORD CLIP_DEFAULT_PRECIS = 0;
+constexpr DWORD NONANTIALIASED_QUALITY = 3;
+constexpr DWORD VARIABLE_PITCH = 2;
+
+constexpr UINT MB_ICONERROR = 0x00000010;
+constexpr UINT MB_APPLMODAL = 0x00000000;
+constexpr UINT MB_SETFOREGROUND = 0x00010000;
+
+constexpr DWORD GENERIC_READ = 0x80000000;
+constexpr DWORD FILE_SHARE_READ = 0x00000001;
+constexpr DWORD OPEN_EXISTING = 3;
+constexpr DWORD FILE_ATTRIBUTE_NORMAL = 0x00000080;
+constexpr DWORD PAGE_READONLY = 0x02;
+constexpr DWORD FILE_MAP_READ = 0x0004;
+
+constexpr DWORD FORMAT_MESSAGE_ALLOCATE_BUFFER = 0x0100;
+constexpr DWORD FORMAT_MESSAGE_IGNORE_INSERTS = 0x0200;
+constexpr DWORD FORMAT_MESSAGE_FROM_SYSTEM = 0x1000;
+constexpr DWORD LANG_SYSTEM_DEFAULT = 0x0800;
+
+// Windows.
+BOOL RegisterClassW(WNDCLASSW const* window_class);
+HWND CreateWindowW(LPCWSTR class_name,
+                   LPCWSTR window_name,
+                   DWORD style,
+                   int x,
+                   int y,
+                   int width,
+                   int height,
+                   HWND parent,
+                   HMENU menu,
+                   HINSTANCE instance,
+                   void* param);
+// Finds a window by its class name only.
+HWND FindWindowW(LPCWSTR class_name, LPCWSTR window_name);
+BOOL DestroyWindow(HWND window);
+BOOL AdjustWindowRect(RECT* rect, DWORD style, BOOL menu);
+BOOL ShowWindow(HWND window, int command);
+BOOL SetWindowTextW(HWND window, LPCWSTR text);
+int GetWindowTextW(HWND window, LPWSTR text, int max_count);
+LONG_PTR SetWindowLongPtr(HWND window, int index, LONG_PTR value);
+LONG_PTR GetWindowLongPtr(HWND window, int index);
+LRESULT SendMessageW(HWND window, UINT message, WPARAM wParam, LPARAM lParam);
+// Messages are posted to a single queue, shared by all windows.
+BOOL PostMessageW(HWND window, UINT message, WPARAM wParam, LPARAM lParam);
+BOOL PeekMessageW(MSG* message,
+                  HWND window,
+                  UINT filter_min,
+                  UINT filter_max,
+                  UINT remove);
+LRESULT DefWindowProcW(HWND window,
+                       UINT message,
+                       WPARAM wParam,
+                       LPARAM lParam);
+void PostQuitMessage(int exit_code);
+HCURSOR LoadCursor(HINSTANCE instance, LPTSTR name);
+BOOL GetCursorPos(POINT* point);
+BOOL ScreenToClient(HWND window, POINT* point);
+SHORT GetAsyncKeyState(int key);
+int MessageBoxW(HWND window, LPCWSTR text, LPCWSTR caption, UINT type);
+
+// GDI.
+HDC GetDC(HWND window);
+int ReleaseDC(HWND window, HDC hdc);
+HDC CreateCompatibleDC(HDC hdc);
+BOOL DeleteDC(HDC hdc);
+HGDIOBJ SelectObject(HDC hdc, HGDIOBJ object);
+BOOL DeleteObject(HGDIOBJ object);
+HBITMAP CreateDIBSection(HDC hdc,
+                         BITMAPINFO const* info,
+                         UINT usage,
+                         void** bits,
+                         HANDLE section,
+                         DWORD offset);
+BOOL StretchBlt(HDC destination,
+                int x,
+                int y,
+                int width,
+                int height,
+                HDC source,
+                int source_x,
+                int source_y,
+                int source_width,
+                int source_height,
+                DWORD rop);
+HFONT CreateFont(int height,
+                 int width,
+                 int escapement,
+                 int orientation,
+                 int weight,
+                 DWORD italic,
+                 DWORD underline,
+                 DWORD strike_out,
+                 DWORD charset,
+                 DWORD out_precision,
+                 DWORD clip_precision,
+                 DWORD quality,
+                 DWORD pitch_and_family,
+                 LPCWSTR face_name);
+int SetBkMode(HDC hdc, int mode);
+COLORREF SetTextColor(HDC hdc, COLORREF color);
+int DrawTextW(HDC hdc, LPCWSTR text, int length, RECT* rect, UINT format);
+BOOL GdiFlush();
+
+// Files, mapped into memory with mmap.
+HANDLE CreateFileW(LPCWSTR name,
+                   DWORD access,
+                   DWORD share_mode,
+                   void* security,
+                   DWORD disposition,
+                   DWORD flags,
+                   HANDLE template_file);
+BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER* size);
+HANDLE CreateFileMappingW(HANDLE file,
+                          void* security,
+                          DWORD protection,
+                          DWORD max_size_high,
+                          DWORD max_size_low,
+                          LPCWSTR name);
+LPVOID MapViewOfFile(HANDLE mapping,
+                     DWORD access,
+                     DWORD offset_high,
+                     DWORD offset_low,
+                     size_t bytes);
+BOOL UnmapViewOfFile(LPCVOID address);
+BOOL CloseHandle(HANDLE object);
+
+// Errors.
+DWORD GetLastError();
+DWORD FormatMessageW(DWORD flags,
+                     void const* source,
+                     DWORD message_id,
+                     DWORD language_id,
+                     LPWSTR buffer,
+                     DWORD size,
+                     void* arguments);
+HLOCAL LocalFree(HLOCAL memory);
+
+// Not a part of Win32, lets the host of the headless app drive it.
+namespace headless {
+// Sets the state reported by GetAsyncKeyState.
+void SetKeyDown(int key, bool down);
+// Pixels of what has been blitted to |window| so far.
+uint32_t const* GetWindowPixels(HWND window, int* width, int* height);
+}  // namespace headless
@@ -0,0 +1,39 @@
+// Copyright Wojciech Replin 2019
+
+#include "allocation_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+// Per thread, so that allocations of other threads running meanwhile, e.g.
+// the render thread, don't show up.
+thread_local uint64_t g_allocations = 0;
+thread_local uint64_t g_allocated_bytes = 0;
+}  // namespace
+
+void* operator new(size_t size) {
+  ++g_allocations;
+  g_allocated_bytes += size;
+  if (void* block = std::malloc(size ? size : 1))
+    return block;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* block) noexcept {
+  std::free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+  std::free(block);
+}
+
+namespace allocation_counter {
+uint64_t GetAllocations() {
+  return g_allocations;
+}
+
+uint64_t GetAllocatedBytes() {
+  return g_allocated_bytes;
+}
+}  // namespace allocation_counter
@@ -0,0 +1,12 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+#include <cstdint>
+
+namespace allocation_counter {
+// Number and total size of heap allocations made so far on the calling
+// thread, counted by the replaced global operator new.
+uint64_t GetAllocations();
+uint64_t GetAllocatedBytes();
+}  // namespace allocation_counter
@@ -0,0 +1,156 @@
+// Copyright Wojciech Replin 2019
+
+#include "id_bench.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "../../src/id_manager/id_manager.hpp"
+
+namespace id_bench {
+namespace {
+using Clock = std::chrono::steady_clock;
+using ID = gk::IdManager::ID;
+
+// Random gets, releases of used ids and releases of unused ones, compared
+// with the smallest id missing from a set of used ids.
+bool CheckSmallestFree(int operations, std::mt19937* random) {
+  gk::SequentialIdManager ids;
+  std::set<ID> used;
+  std::uniform_int_distribution<int> operation(0, 9);
+  for (int i = 0; i < operations; ++i) {
+    const auto op = operation(*random);
+    if (op < 4) {
+      ID expected = 1;
+      for (auto id : used) {
+        if (id != expected)
+          break;
+        ++expected;
+      }
+      const auto id = ids.Get();
+      if (id != expected) {
+        std::printf("MISMATCH: got id %u, the smallest free one is %u\n", id,
+                    expected);
+        return false;
+      }
+      used.insert(id);
+    } else if (op < 8 && !used.empty()) {
+      auto it = used.begin();
+      std::advance(it, std::uniform_int_distribution<size_t>(
+                           0, used.size() - 1)(*random));
+      ids.Release(*it);
+      used.erase(it);
+    } else {
+      // Releasing ids which aren't used, including 0, does nothing.
+      const auto id =
+          std::uniform_int_distribution<ID>(0, 2 * used.size() + 2)(*random);
+      if (!used.count(id))
+        ids.Release(id);
+    }
+  }
+  return true;
+}
+
+// Builds |live| ids and runs |cycles| of releasing a random one and getting
+// it back, as the smallest free one. Prints the time taken.
+bool MeasureCycles(int live, int cycles, std::mt19937* random) {
+  const auto start = Clock::now();
+  gk::SequentialIdManager ids;
+  std::vector<ID> used;
+  for (int i = 0; i < live; ++i)
+    used.push_back(ids.Get());
+  std::uniform_int_distribution<int> index(0, live - 1);
+  for (int i = 0; i < cycles; ++i) {
+    const auto released = used[index(*random)];
+    ids.Release(released);
+    const auto id = ids.Get();
+    if (id != released) {
+      std::printf("MISMATCH: got id %u instead of released %u\n", id,
+                  released);
+      return false;
+    }
+  }
+  const std::chrono::duration<double, std::milli> elapsed =
+      Clock::now() - start;
+  std::printf("%6d live ids, %7d release/get cycles: %8.1f ms\n", live,
+              cycles, elapsed.count());
+  return true;
+}
+
+// Threads keep |live| ids each and release and get them back concurrently.
+// Every id handed out is marked as owned and unmarked before release, so an
+// id handed out twice while in use is marked already.
+bool CheckConcurrent(int threads, int live, int cycles) {
+  gk::ConcurrentIdManager ids;
+  // Even with all threads in one shard its local ids stay within the total
+  // number of ids in use.
+  const size_t bound = (static_cast<size_t>(threads) * live + 1) *
+                           gk::ConcurrentIdManager::kShards +
+                       1;
+  std::unique_ptr<std::atomic<bool>[]> owned(new std::atomic<bool>[bound]);
+  for (size_t i = 0; i < bound; ++i)
+    owned[i] = false;
+  std::atomic<bool> failed(false);
+  auto get = [&]() -> ID {
+    const auto id = ids.Get();
+    if (!id || id >= bound || owned[id].exchange(true)) {
+      std::printf("MISMATCH: id %u handed out while in use or invalid\n",
+                  id);
+      failed = true;
+    }
+    return id;
+  };
+  const auto start = Clock::now();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t]() {
+      std::mt19937 random(t + 1);
+      std::uniform_int_distribution<int> index(0, live - 1);
+      std::vector<ID> used;
+      for (int i = 0; i < live; ++i)
+        used.push_back(get());
+      for (int i = 0; i < cycles && !failed; ++i) {
+        auto& id = used[index(random)];
+        if (id < bound)
+          owned[id] = false;
+        ids.Release(id);
+        id = get();
+      }
+      for (auto id : used) {
+        if (id < bound)
+          owned[id] = false;
+        ids.Release(id);
+      }
+    });
+  }
+  for (auto& worker : workers)
+    worker.join();
+  if (failed)
+    return false;
+  const std::chrono::duration<double, std::milli> elapsed =
+      Clock::now() - start;
+  std::printf("%d threads with %d live ids each, %d release/get cycles "
+              "each: %.1f ms, no id handed out twice\n",
+              threads, live, cycles, elapsed.count());
+  return true;
+}
+}  // namespace
+
+bool Run() {
+  std::mt19937 random(1);
+  constexpr int kOperations = 200000;
+  if (!CheckSmallestFree(kOperations, &random))
+    return false;
+  std::printf("%d random operations handed out the smallest free id\n\n",
+              kOperations);
+  return MeasureCycles(100, 1000000, &random) &&
+         MeasureCycles(50000, 1000000, &random) &&
+         CheckConcurrent(8, 64, 200000);
+}
+}  // namespace id_bench
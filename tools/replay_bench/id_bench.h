@@ -0,0 +1,11 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+namespace id_bench {
+// Checks that gk::SequentialIdManager hands out the smallest free id, which
+// labels depend on, against a reference and while timing release/get
+// cycles, and that gk::ConcurrentIdManager never hands out an id in use to
+// concurrent threads. Returns false on the first violation.
+bool Run();
+}  // namespace id_bench
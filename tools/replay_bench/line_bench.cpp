@@ -0,0 +1,186 @@
+// Copyright Wojciech Replin 2019
+
+#include "line_bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../../src/drawing_board/framebuffer.hpp"
+#include "../../src/rasterizer/rasterizer.hpp"
+
+namespace line_bench {
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Line {
+  int x0, y0, x1, y1;
+};
+
+// DrawLine before it drew spans: symmetric Bresenham from both ends, one
+// clipped SetPixel() per pixel.
+void DrawLinePerPixel(gk::Framebuffer* framebuffer,
+                      int x0,
+                      int y0,
+                      int x1,
+                      int y1,
+                      gk::Framebuffer::Pixel color) {
+  const auto dx = std::abs(x1 - x0);
+  const auto dy = -std::abs(y1 - y0);
+  const auto sx = x0 < x1 ? 1 : -1;
+  const auto sy = y0 < y1 ? 1 : -1;
+  auto err = dx + dy;
+  auto iters = (err > 0 ? dx / 2 : -dy / 2) + 1;
+  while (--iters > 0) {
+    auto e2 = 2 * err;
+    if (e2 >= dy) {
+      err += dy;
+      x0 += sx;
+      x1 -= sx;
+    }
+    if (e2 <= dx) {
+      err += dx;
+      y0 += sy;
+      y1 -= sy;
+    }
+    framebuffer->SetPixel(x0, y0, color);
+    framebuffer->SetPixel(x1, y1, color);
+  }
+}
+
+// Pixels drawn by either implementation without clipping.
+long long CountPixels(Line const& line) {
+  const auto dx = std::abs(line.x1 - line.x0);
+  const auto dy = std::abs(line.y1 - line.y0);
+  return 2 * ((dx > dy ? dx : dy) / 2);
+}
+
+bool SamePixels(gk::Framebuffer const& a, gk::Framebuffer const& b) {
+  for (int y = 0; y < a.GetHeight(); ++y)
+    for (int x = 0; x < a.GetWidth(); ++x)
+      if (a.GetPixel(x, y) != b.GetPixel(x, y))
+        return false;
+  return true;
+}
+
+// Lines with endpoints up to a board away from a |width| x |height| board
+// under random clip rects, each line compared on its own.
+bool CheckIdentity(int width, int height, int lines, std::mt19937* random) {
+  gk::MemoryFramebuffer expected(width, height);
+  gk::MemoryFramebuffer actual(width, height);
+  std::uniform_int_distribution<int> x(-width, 2 * width);
+  std::uniform_int_distribution<int> y(-height, 2 * height);
+  std::uniform_int_distribution<int> kind(0, 3);
+  for (int i = 0; i < lines; ++i) {
+    Line line{x(*random), y(*random), x(*random), y(*random)};
+    // A quarter of the lines is horizontal, vertical or diagonal.
+    switch (kind(*random)) {
+      case 0:
+        line.y1 = line.y0;
+        break;
+      case 1:
+        line.x1 = line.x0;
+        break;
+      case 2:
+        line.y1 = line.y0 + (line.x1 - line.x0);
+        break;
+    }
+    const int cx[] = {x(*random), x(*random)};
+    const int cy[] = {y(*random), y(*random)};
+    const gk::Rect clip(std::min(cx[0], cx[1]), std::min(cy[0], cy[1]),
+                        std::max(cx[0], cx[1]), std::max(cy[0], cy[1]));
+    for (auto* framebuffer : {&expected, &actual}) {
+      framebuffer->ResetClipRect();
+      framebuffer->Fill(0);
+      framebuffer->SetClipRect(i % 2 ? clip : framebuffer->GetBounds());
+    }
+    DrawLinePerPixel(&expected, line.x0, line.y0, line.x1, line.y1, 1);
+    gk::rasterizer::DrawLine(&actual, line.x0, line.y0, line.x1, line.y1, 1);
+    if (!SamePixels(expected, actual)) {
+      std::printf("MISMATCH on a %dx%d board: line (%d, %d) - (%d, %d)\n",
+                  width, height, line.x0, line.y0, line.x1, line.y1);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Lines inside a |width| x |height| board: axis aligned, mostly horizontal
+// and mostly vertical.
+std::vector<Line> MakeLines(int width,
+                            int height,
+                            int kind,
+                            int count,
+                            std::mt19937* random) {
+  std::uniform_int_distribution<int> x(0, width - 1);
+  std::uniform_int_distribution<int> y(0, height - 1);
+  std::vector<Line> lines;
+  while (static_cast<int>(lines.size()) < count) {
+    Line line{x(*random), y(*random), x(*random), y(*random)};
+    if (kind == 0) {
+      if (lines.size() % 2)
+        line.y1 = line.y0;
+      else
+        line.x1 = line.x0;
+    } else {
+      const auto dx = std::abs(line.x1 - line.x0);
+      const auto dy = std::abs(line.y1 - line.y0);
+      if ((kind == 1) != (dx > dy) || dx == 0 || dy == 0)
+        continue;
+    }
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+template <typename Draw>
+double MeasureMegapixelsPerSecond(gk::Framebuffer* framebuffer,
+                                  std::vector<Line> const& lines,
+                                  Draw draw) {
+  long long pixels = 0;
+  for (auto const& line : lines)
+    pixels += CountPixels(line);
+  // The first round warms up caches.
+  double seconds = 0;
+  for (int round = 0; round < 2; ++round) {
+    const auto start = Clock::now();
+    gk::Framebuffer::Pixel color = 0;
+    for (auto const& line : lines)
+      draw(framebuffer, line.x0, line.y0, line.x1, line.y1, ++color);
+    seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  }
+  return pixels / seconds / 1e6;
+}
+}  // namespace
+
+bool Run() {
+  std::mt19937 random(1);
+  constexpr int kIdentityLines = 200000;
+  if (!CheckIdentity(64, 48, kIdentityLines, &random))
+    return false;
+  std::printf("%d random lines drawn pixel-identical to the per pixel "
+              "Bresenham\n\n",
+              kIdentityLines);
+
+  const char* const kinds[] = {"axis aligned", "x-major", "y-major"};
+  const int boards[][2] = {{400, 200}, {1920, 1080}};
+  for (auto const& board : boards) {
+    gk::MemoryFramebuffer framebuffer(board[0], board[1]);
+    std::printf("%4dx%-4d board   per pixel [Mpx/s]   spans [Mpx/s]\n",
+                board[0], board[1]);
+    for (int kind = 0; kind < 3; ++kind) {
+      const auto lines = MakeLines(board[0], board[1], kind, 20000, &random);
+      const auto per_pixel =
+          MeasureMegapixelsPerSecond(&framebuffer, lines, DrawLinePerPixel);
+      const auto spans = MeasureMegapixelsPerSecond(
+          &framebuffer, lines, gk::rasterizer::DrawLine);
+      std::printf("%-15s %19.0f %15.0f\n", kinds[kind], per_pixel, spans);
+    }
+    std::printf("\n");
+  }
+  return true;
+}
+}  // namespace line_bench
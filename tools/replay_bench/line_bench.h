@@ -0,0 +1,10 @@
+// Copyright Wojciech Replin 2019
+
+#pragma once
+
+namespace line_bench {
+// Checks that gk::rasterizer::DrawLine sets exactly the pixels of the per
+// pixel Bresenham it replaced, for random lines and clip rects, then
+// reports the throughput of both. Returns false on the first difference.
+bool Run();
+}  // namespace line_bench
@@ -0,0 +1,731 @@
+// Copyright Wojciech Replin 2019
+
+// Replays a script of input events or an input log recorded by the app
+// against PolygonController running on a headless DrawingBoard and reports
+// latency percentiles of every kind of event, split into the time spent by
+// the controller handling the event (solve) and taking a snapshot of the
+// scene (snapshot), together with the whole time the event kept the UI
+// thread busy (handled). Frames drawn by the render thread are reported
+// separately, split into drawing the damaged area (raster) and blitting it
+// to the window (blit). Heap allocations made by the UI thread while events
+// are handled are reported per event. Replays of finished logs fail unless
+// they reproduce the recorded scene exactly.
+//
+// Without --rate, each event is handled together with the drag step it
+// requested, so that drag steps are never cancelled.
+//
+// Script syntax, one command per line, coordinates in board pixels:
+//   down X Y / up X Y / move X Y / dblclick X Y
+//   drag X1 Y1 X2 Y2 STEPS  - down, STEPS moves in a line and up
+//   key K                   - key press, K is a letter or "space"
+//   ctrl 1 / ctrl 0         - holds or releases CTRL
+//   mark [N]                - remembers the scene fingerprint in slot N,
+//                             0 by default
+//   check [N]               - fails the run unless the scene fingerprint is
+//                             the one remembered by the last mark of slot N
+//   repeat N ... end        - repeats commands in between N times
+// Everything after '#' is a comment.
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../../src/controller/controller.hpp"
+#include "../../src/controller/polygon_controller.hpp"
+#include "../../src/drawing_board/drawing_board.hpp"
+#include "../../src/drawing_board/input_log.hpp"
+#include "../../src/drawing_board/renderer.hpp"
+#include "allocation_counter.h"
+#include "id_bench.h"
+#include "line_bench.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// Measures time spent in the event handlers of the wrapped controller and in
+// taking snapshots.
+class TimedController : public gk::Controller {
+ public:
+  TimedController(std::unique_ptr<gk::Controller> controller,
+                  double* solve_seconds,
+                  double* snapshot_seconds)
+      : controller_(std::move(controller)),
+        solve_seconds_(solve_seconds),
+        snapshot_seconds_(snapshot_seconds) {}
+  // Overridden from Controller
+  bool OnMouseLButtonDown(gk::DrawingBoard* board,
+                          gk::DrawingBoard::Point2d mouse_pos) override {
+    return Time(
+        [&] { return controller_->OnMouseLButtonDown(board, mouse_pos); });
+  }
+  bool OnMouseLButtonUp(gk::DrawingBoard* board,
+                        gk::DrawingBoard::Point2d mouse_pos) override {
+    return Time(
+        [&] { return controller_->OnMouseLButtonUp(board, mouse_pos); });
+  }
+  bool OnMouseLButtonDoubleClick(
+      gk::DrawingBoard* board,
+      gk::DrawingBoard::Point2d mouse_pos) override {
+    return Time([&] {
+      return controller_->OnMouseLButtonDoubleClick(board, mouse_pos);
+    });
+  }
+  bool OnMouseMove(gk::DrawingBoard* board,
+                   gk::DrawingBoard::Point2d mouse_pos) override {
+    return Time([&] { return controller_->OnMouseMove(board, mouse_pos); });
+  }
+  bool OnKeyDown(gk::DrawingBoard* board,
+                 WPARAM key_code,
+                 bool was_down) override {
+    return Time(
+        [&] { return controller_->OnKeyDown(board, key_code, was_down); });
+  }
+  bool OnKeyUp(gk::DrawingBoard* board, WPARAM key_code) override {
+    return Time([&] { return controller_->OnKeyUp(board, key_code); });
+  }
+  bool OnWorkDone(gk::DrawingBoard* board, uint16_t generation) override {
+    return Time([&] { return controller_->OnWorkDone(board, generation); });
+  }
+  std::shared_ptr<const gk::Snapshot> TakeSnapshot() override {
+    const auto start = Clock::now();
+    auto snapshot = controller_->TakeSnapshot();
+    *snapshot_seconds_ +=
+        std::chrono::duration<double>(Clock::now() - start).count();
+    return snapshot;
+  }
+  uint64_t GetSceneFingerprint() const override {
+    return controller_->GetSceneFingerprint();
+  }
+
+ private:
+  template <typename Handler>
+  bool Time(Handler handler) {
+    const auto start = Clock::now();
+    const bool result = handler();
+    *solve_seconds_ +=
+        std::chrono::duration<double>(Clock::now() - start).count();
+    return result;
+  }
+
+  std::unique_ptr<gk::Controller> controller_;
+  double* solve_seconds_;
+  double* snapshot_seconds_;
+};
+
+struct Event {
+  enum class Type {
+    MESSAGE,
+    CTRL,
+    // |lparam| is the slot.
+    MARK,
+    // |wparam| is the line of the script and |lparam| the slot.
+    CHECK,
+  } type;
+  UINT message;
+  WPARAM wparam;
+  LPARAM lparam;
+};
+
+const std::map<std::string, UINT> kMouseMessages = {
+    {"down", WM_LBUTTONDOWN},
+    {"up", WM_LBUTTONUP},
+    {"move", WM_MOUSEMOVE},
+    {"dblclick", WM_LBUTTONDBLCLK},
+};
+
+const char* GetEventName(gk::InputEvent::Type type) {
+  switch (type) {
+    case gk::InputEvent::Type::L_BUTTON_DOWN:
+      return "down";
+    case gk::InputEvent::Type::L_BUTTON_UP:
+      return "up";
+    case gk::InputEvent::Type::MOUSE_MOVE:
+      return "move";
+    case gk::InputEvent::Type::L_BUTTON_DOUBLE_CLICK:
+      return "dblclick";
+    case gk::InputEvent::Type::KEY_DOWN:
+      return "keydown";
+    case gk::InputEvent::Type::KEY_UP:
+      return "keyup";
+    case gk::InputEvent::Type::WORK_DONE:
+      return "solved";
+    default:
+      return "other";
+  }
+}
+
+const char* GetMessageName(UINT message) {
+  switch (message) {
+    case WM_LBUTTONDOWN:
+      return "down";
+    case WM_LBUTTONUP:
+      return "up";
+    case WM_MOUSEMOVE:
+      return "move";
+    case WM_LBUTTONDBLCLK:
+      return "dblclick";
+    case WM_KEYDOWN:
+      return "keydown";
+    case WM_KEYUP:
+      return "keyup";
+    case gk::DrawingBoard::kWorkDoneMessage:
+      return "solved";
+    default:
+      return "other";
+  }
+}
+
+class Script {
+ public:
+  Script(std::istream& in, int pixel_size) : in_(in), pixel_size_(pixel_size) {}
+
+  // Returns false and prints the reason if the script is malformed.
+  bool Parse(std::vector<Event>* events) { return ParseBlock(events, false); }
+
+ private:
+  bool ParseBlock(std::vector<Event>* events, bool nested) {
+    std::string line;
+    while (std::getline(in_, line)) {
+      ++line_number_;
+      line = line.substr(0, line.find('#'));
+      std::istringstream tokens(line);
+      std::string command;
+      if (!(tokens >> command))
+        continue;
+      if (command == "end") {
+        if (!nested)
+          return Error("'end' without 'repeat'");
+        return true;
+      } else if (command == "repeat") {
+        int count;
+        if (!(tokens >> count) || count < 0)
+          return Error("expected repeat count");
+        std::vector<Event> block;
+        if (!ParseBlock(&block, true))
+          return false;
+        for (int i = 0; i < count; ++i)
+          events->insert(events->end(), block.begin(), block.end());
+        continue;
+      } else if (kMouseMessages.count(command)) {
+        double x, y;
+        if (!(tokens >> x >> y))
+          return Error("expected coordinates");
+        events->push_back(Mouse(kMouseMessages.at(command), x, y));
+      } else if (command == "drag") {
+        double x1, y1, x2, y2;
+        int steps;
+        if (!(tokens >> x1 >> y1 >> x2 >> y2 >> steps) || steps <= 0)
+          return Error("expected drag start, end and number of steps");
+        events->push_back(Mouse(WM_LBUTTONDOWN, x1, y1));
+        for (int i = 1; i <= steps; ++i) {
+          events->push_back(Mouse(WM_MOUSEMOVE, x1 + (x2 - x1) * i / steps,
+                                  y1 + (y2 - y1) * i / steps));
+        }
+        events->push_back(Mouse(WM_LBUTTONUP, x2, y2));
+      } else if (command == "key") {
+        std::string key;
+        if (!(tokens >> key))
+          return Error("expected key");
+        WPARAM key_code;
+        if (key == "space")
+          key_code = VK_SPACE;
+        else if (key.size() == 1 && std::isalpha(key[0]))
+          key_code = std::toupper(key[0]);
+        else
+          return Error("unknown key");
+        events->push_back({Event::Type::MESSAGE, WM_KEYDOWN, key_code, 0});
+        events->push_back({Event::Type::MESSAGE, WM_KEYUP, key_code, 0});
+      } else if (command == "ctrl") {
+        int down;
+        if (!(tokens >> down))
+          return Error("expected 1 or 0");
+        events->push_back({Event::Type::CTRL, 0, down ? 1u : 0u, 0});
+      } else if (command == "mark" || command == "check") {
+        int slot = 0;
+        if (!(tokens >> slot))
+          slot = 0;
+        if (slot < 0)
+          return Error("expected a slot which isn't negative");
+        if (command == "mark") {
+          events->push_back({Event::Type::MARK, 0, 0, slot});
+        } else {
+          events->push_back({Event::Type::CHECK, 0,
+                             static_cast<WPARAM>(line_number_), slot});
+        }
+      } else {
+        return Error("unknown command");
+      }
+    }
+    if (nested)
+      return Error("'repeat' without 'end'");
+    return true;
+  }
+
+  Event Mouse(UINT message, double x, double y) const {
+    return {Event::Type::MESSAGE, message, 0,
+            MAKELPARAM(static_cast<int>(x * pixel_size_),
+                       static_cast<int>(y * pixel_size_))};
+  }
+
+  bool Error(const char* message) const {
+    std::cerr << "line " << line_number_ << ": " << message << "\n";
+    return false;
+  }
+
+  std::istream& in_;
+  const int pixel_size_;
+  int line_number_ = 0;
+};
+
+// Latencies of one kind of work, in seconds.
+class Samples {
+ public:
+  void Add(double seconds) { samples_.push_back(seconds); }
+  size_t Count() const { return samples_.size(); }
+  // Returns the |fraction| quantile in milliseconds.
+  double Quantile(double fraction) {
+    if (samples_.empty())
+      return 0;
+    std::sort(samples_.begin(), samples_.end());
+    const auto index = std::min(
+        static_cast<size_t>(fraction * samples_.size()), samples_.size() - 1);
+    return samples_[index] * 1000;
+  }
+
+ private:
+  std::vector<double> samples_;
+};
+
+struct Latencies {
+  Samples solve;
+  Samples snapshot;
+  Samples handled;
+  uint64_t allocations = 0;
+  uint64_t allocated_bytes = 0;
+};
+
+struct FrameLatencies {
+  Samples raster;
+  Samples blit;
+};
+
+// Board running PolygonController, with latencies of events it handled and
+// of frames it drew.
+class Bench {
+ public:
+  // The render thread starts at most |frame_rate| frames a second, or draws
+  // every snapshot if it's zero. CTRL+S and CTRL+O save and load the scene
+  // at |scene_path| and CTRL+I imports polygons from |import_path|, if
+  // given.
+  Bench(gk::InputLogHeader const& header,
+        double frame_rate,
+        const char* scene_path,
+        const char* import_path) {
+    auto polygon_controller = std::make_unique<gk::PolygonController>();
+    polygon_controller_ = polygon_controller.get();
+    if (scene_path)
+      polygon_controller->SetScenePath(scene_path);
+    if (import_path)
+      polygon_controller->SetImportPath(import_path);
+    auto controller = std::make_unique<TimedController>(
+        std::move(polygon_controller), &solve_time_, &snapshot_time_);
+    controller_ = controller.get();
+    gk::DrawingBoard::RegisterWindowClass(nullptr);
+    board_ = std::make_unique<gk::DrawingBoard>(
+        0, 0, header.width, header.height, header.pixel_size, nullptr,
+        std::move(controller));
+    window_ = FindWindowW(nullptr, nullptr);
+    auto* renderer = board_->GetRenderer();
+    renderer->SetFrameRate(frame_rate);
+    renderer->SetFrameCallback([this](double raster, double blit) {
+      std::lock_guard<std::mutex> lock(frames_mutex_);
+      frames_.raster.Add(raster);
+      frames_.blit.Add(blit);
+    });
+    board_->Display();
+  }
+
+  gk::DrawingBoard* GetBoard() { return board_.get(); }
+  HWND GetWindow() { return window_; }
+  uint64_t GetSceneFingerprint() const {
+    return controller_->GetSceneFingerprint();
+  }
+
+  // Handles an event of kind |name| by calling |dispatch|.
+  template <typename Dispatch>
+  void Measure(const char* name, Dispatch dispatch) {
+    const double solve_before = solve_time_;
+    const double snapshot_before = snapshot_time_;
+    const auto allocations_before = allocation_counter::GetAllocations();
+    const auto allocated_bytes_before =
+        allocation_counter::GetAllocatedBytes();
+    const auto start = Clock::now();
+    dispatch();
+    const double handled =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    for (auto* l : {&latencies_[name], &all_}) {
+      l->solve.Add(solve_time_ - solve_before);
+      l->snapshot.Add(snapshot_time_ - snapshot_before);
+      l->handled.Add(handled);
+      l->allocations +=
+          allocation_counter::GetAllocations() - allocations_before;
+      l->allocated_bytes +=
+          allocation_counter::GetAllocatedBytes() - allocated_bytes_before;
+    }
+  }
+
+  // Waits for the drag step requested by the last event, if any, to be
+  // solved, counting the wait as solve time.
+  void WaitUntilSolved() {
+    const auto start = Clock::now();
+    polygon_controller_->WaitUntilSolved();
+    solve_time_ += std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  // Waits for the render thread to finish drawing.
+  void Print() {
+    board_->GetRenderer()->WaitUntilIdle();
+    PrintHeader({"solve [ms]", "snapshot [ms]", "handled [ms]"}, "event");
+    for (auto& l : latencies_) {
+      PrintRow(l.first.c_str(),
+               {&l.second.solve, &l.second.snapshot, &l.second.handled});
+    }
+    PrintRow("all", {&all_.solve, &all_.snapshot, &all_.handled});
+
+    std::printf("\n%-9s %7s | %-24s\n%-9s %7s | %11s %12s\n", "", "",
+                "allocations per event", "event", "count", "count",
+                "bytes");
+    for (auto& l : latencies_)
+      PrintAllocations(l.first.c_str(), l.second);
+    PrintAllocations("all", all_);
+
+    const auto stats = board_->GetRenderer()->GetStats();
+    std::printf("\n");
+    PrintHeader({"raster [ms]", "blit [ms]"}, "");
+    {
+      std::lock_guard<std::mutex> lock(frames_mutex_);
+      PrintRow("frames", {&frames_.raster, &frames_.blit});
+    }
+    std::printf("%llu of %llu published snapshots drawn\n",
+                static_cast<unsigned long long>(stats.frames),
+                static_cast<unsigned long long>(stats.published));
+
+    const auto& moves = board_->GetMouseMoveStats();
+    std::printf("\nmouse moves: %llu received, %llu coalesced\n",
+                static_cast<unsigned long long>(moves.received),
+                static_cast<unsigned long long>(moves.coalesced));
+    wchar_t title[256];
+    GetWindowTextW(window_, title, 256);
+    std::printf("window title: %ls\n", title);
+  }
+
+ private:
+  static void PrintHeader(std::initializer_list<const char*> columns,
+                          const char* name) {
+    std::printf("%-9s %7s", "", "");
+    for (auto* column : columns)
+      std::printf(" | %-24s", column);
+    std::printf("\n%-9s %7s", name, "count");
+    for (size_t i = 0; i < columns.size(); ++i)
+      std::printf(" | %7s %7s %8s", "p50", "p99", "max");
+    std::printf("\n");
+  }
+
+  static void PrintRow(const char* name,
+                       std::initializer_list<Samples*> columns) {
+    std::printf("%-9s %7zu", name, (*columns.begin())->Count());
+    for (auto* samples : columns) {
+      std::printf(" | %7.3f %7.3f %8.3f", samples->Quantile(0.5),
+                  samples->Quantile(0.99), samples->Quantile(1));
+    }
+    std::printf("\n");
+  }
+
+  static void PrintAllocations(const char* name, Latencies const& latencies) {
+    const auto count = std::max<size_t>(latencies.handled.Count(), 1);
+    std::printf("%-9s %7zu | %11.1f %12.1f\n", name, latencies.handled.Count(),
+                static_cast<double>(latencies.allocations) / count,
+                static_cast<double>(latencies.allocated_bytes) / count);
+  }
+
+  // Written by the render thread, so they have to outlive |board_|.
+  std::mutex frames_mutex_;
+  FrameLatencies frames_;
+
+  double solve_time_ = 0;
+  double snapshot_time_ = 0;
+  gk::PolygonController* polygon_controller_;
+  TimedController* controller_;
+  std::unique_ptr<gk::DrawingBoard> board_;
+  HWND window_;
+  std::map<std::string, Latencies> latencies_;
+  Latencies all_;
+};
+
+int RunScript(const char* path,
+              gk::InputLogHeader const& header,
+              double rate,
+              double frame_rate,
+              const char* record_path,
+              const char* scene_path,
+              const char* import_path) {
+  std::ifstream file(path);
+  if (!file) {
+    std::cerr << "cannot open " << path << "\n";
+    return 1;
+  }
+  std::vector<Event> events;
+  if (!Script(file, header.pixel_size).Parse(&events))
+    return 1;
+
+  Bench bench(header, frame_rate, scene_path, import_path);
+  if (record_path && !bench.GetBoard()->RecordInput(record_path)) {
+    std::cerr << "cannot create " << record_path << "\n";
+    return 1;
+  }
+  std::map<LPARAM, uint64_t> marks;
+  bool failed = false;
+  // Handles events which aren't sent to the board.
+  const auto handle_script_event = [&](Event const& event) {
+    switch (event.type) {
+      case Event::Type::MESSAGE:
+        break;
+      case Event::Type::CTRL:
+        headless::SetKeyDown(VK_CONTROL, event.wparam);
+        break;
+      case Event::Type::MARK:
+        marks[event.lparam] = bench.GetSceneFingerprint();
+        break;
+      case Event::Type::CHECK: {
+        const auto fingerprint = bench.GetSceneFingerprint();
+        const auto mark = marks[event.lparam];
+        if (fingerprint != mark) {
+          std::printf("line %u: MISMATCH, scene fingerprint: %016llx, "
+                      "marked: %016llx\n",
+                      static_cast<unsigned>(event.wparam),
+                      static_cast<unsigned long long>(fingerprint),
+                      static_cast<unsigned long long>(mark));
+          failed = true;
+        }
+      } break;
+    }
+  };
+  if (rate <= 0) {
+    for (const auto& event : events) {
+      if (event.type != Event::Type::MESSAGE) {
+        handle_script_event(event);
+        continue;
+      }
+      // Each event is handled together with the drag step it requested.
+      bench.Measure(GetMessageName(event.message), [&] {
+        SendMessageW(bench.GetWindow(), event.message, event.wparam,
+                     event.lparam);
+        bench.WaitUntilSolved();
+        MSG message;
+        while (PeekMessageW(&message, nullptr, 0, 0, PM_REMOVE)) {
+          SendMessageW(message.hwnd, message.message, message.wParam,
+                       message.lParam);
+        }
+      });
+    }
+  } else {
+    // Events arrive at |rate| and wait in the message queue while earlier
+    // ones are being handled, like in the app.
+    const auto start = Clock::now();
+    const std::chrono::duration<double> interval(1.0 / rate);
+    size_t next = 0;
+    size_t posted = 0;
+    const auto arrival = [&] {
+      return start + std::chrono::duration_cast<Clock::duration>(
+                         interval * static_cast<double>(posted));
+    };
+    MSG message;
+    for (;;) {
+      while (next < events.size()) {
+        const auto& event = events[next];
+        if (event.type != Event::Type::MESSAGE) {
+          // Waits for events before it to be handled, as the state of keys
+          // is only checked while handling events. Fingerprints are taken
+          // once the last drag step is applied.
+          if (PeekMessageW(&message, nullptr, 0, 0, PM_NOREMOVE))
+            break;
+          if (event.type != Event::Type::CTRL) {
+            bench.WaitUntilSolved();
+            if (PeekMessageW(&message, nullptr, 0, 0, PM_NOREMOVE))
+              break;
+          }
+          handle_script_event(event);
+        } else if (arrival() <= Clock::now()) {
+          PostMessageW(bench.GetWindow(), event.message, event.wparam,
+                       event.lparam);
+          ++posted;
+        } else {
+          break;
+        }
+        ++next;
+      }
+      if (PeekMessageW(&message, nullptr, 0, 0, PM_REMOVE)) {
+        bench.Measure(GetMessageName(message.message), [&] {
+          SendMessageW(message.hwnd, message.message, message.wParam,
+                       message.lParam);
+        });
+      } else if (next < events.size()) {
+        std::this_thread::sleep_until(arrival());
+      } else {
+        // The last drag step may still be solved.
+        bench.WaitUntilSolved();
+        if (!PeekMessageW(&message, nullptr, 0, 0, PM_NOREMOVE))
+          break;
+      }
+    }
+  }
+  bench.Print();
+  std::printf("scene fingerprint: %016llx\n",
+              static_cast<unsigned long long>(bench.GetSceneFingerprint()));
+  return failed ? 1 : 0;
+}
+
+int ReplayLog(const char* path,
+              bool realtime,
+              double frame_rate,
+              const char* scene_path,
+              const char* import_path) {
+  gk::InputLogReader log(path);
+  if (!log.Good()) {
+    std::cerr << path << " is not an input log\n";
+    return 1;
+  }
+  Bench bench(log.GetHeader(), frame_rate, scene_path, import_path);
+  const auto start = Clock::now();
+  while (auto event = log.Next()) {
+    if (realtime)
+      std::this_thread::sleep_until(start +
+                                    std::chrono::microseconds(event->time));
+    if (event->type == gk::InputEvent::Type::CURSOR) {
+      bench.GetBoard()->Replay(event.value());
+      continue;
+    }
+    bench.Measure(GetEventName(event->type),
+                  [&] { bench.GetBoard()->Replay(event.value()); });
+  }
+  bench.Print();
+
+  const auto fingerprint = bench.GetSceneFingerprint();
+  std::printf("scene fingerprint: %016llx\n",
+              static_cast<unsigned long long>(fingerprint));
+  if (!log.GetFingerprint().has_value()) {
+    std::printf("the log isn't finished, the scene can't be verified\n");
+    return 0;
+  }
+  if (log.GetFingerprint().value() != fingerprint) {
+    std::printf("MISMATCH, recorded scene fingerprint: %016llx\n",
+                static_cast<unsigned long long>(log.GetFingerprint().value()));
+    return 1;
+  }
+  std::printf("matches the recorded scene\n");
+  return 0;
+}
+
+int Usage() {
+  std::cerr << "usage: replay_bench SCRIPT [PIXEL_SIZE [WIDTH HEIGHT]] "
+               "[--rate HZ] [--record LOG] [--fps FPS]\n"
+               "                    [--scene FILE] [--import FILE]\n"
+               "       replay_bench --replay LOG [--realtime] [--fps FPS] "
+               "[--scene FILE]\n"
+               "                    [--import FILE]\n"
+               "       replay_bench --lines | --ids\n"
+               "  WIDTH and HEIGHT of the window, defaults: 2 800 400\n"
+               "  --rate    events arrive at HZ per second instead of one\n"
+               "            after another is handled\n"
+               "  --record  also records the script's input into LOG\n"
+               "  --replay  replays an input log, e.g. recorded by gk1.exe, "
+               "at full\n"
+               "            speed or at the recorded pace with --realtime\n"
+               "  --fps     frame rate of the render thread, 0 draws every\n"
+               "            snapshot, default: 60\n"
+               "  --scene   scene file saved with CTRL+S and loaded with "
+               "CTRL+O\n"
+               "  --import  SVG or text file imported with CTRL+I\n"
+               "  --lines   checks that lines are drawn pixel-identical to "
+               "the per\n"
+               "            pixel Bresenham and compares their throughput\n"
+               "  --ids     checks that constraint ids are the smallest free "
+               "ones and\n"
+               "            times release/get cycles, also from concurrent "
+               "threads\n";
+  return 2;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+  if (args.size() == 1 && args[0] == "--lines")
+    return line_bench::Run() ? 0 : 1;
+  if (args.size() == 1 && args[0] == "--ids")
+    return id_bench::Run() ? 0 : 1;
+  std::vector<std::string> positional;
+  double rate = 0;
+  double frame_rate = gk::Renderer::kDefaultFrameRate;
+  const char* record_path = nullptr;
+  const char* replay_path = nullptr;
+  const char* scene_path = nullptr;
+  const char* import_path = nullptr;
+  bool realtime = false;
+  for (size_t i = 0; i < args.size(); ++i) {
+    if (args[i] == "--rate" && i + 1 < args.size())
+      rate = std::atof(args[++i].c_str());
+    else if (args[i] == "--fps" && i + 1 < args.size())
+      frame_rate = std::atof(args[++i].c_str());
+    else if (args[i] == "--record" && i + 1 < args.size())
+      record_path = argv[++i + 1];
+    else if (args[i] == "--replay" && i + 1 < args.size())
+      replay_path = argv[++i + 1];
+    else if (args[i] == "--scene" && i + 1 < args.size())
+      scene_path = argv[++i + 1];
+    else if (args[i] == "--import" && i + 1 < args.size())
+      import_path = argv[++i + 1];
+    else if (args[i] == "--realtime")
+      realtime = true;
+    else if (args[i].compare(0, 2, "--") == 0)
+      return Usage();
+    else
+      positional.push_back(args[i]);
+  }
+  if (frame_rate < 0)
+    return Usage();
+  if (replay_path) {
+    if (!positional.empty() || rate || record_path)
+      return Usage();
+    return ReplayLog(replay_path, realtime, frame_rate, scene_path,
+                     import_path);
+  }
+  if (realtime || (positional.size() != 1 && positional.size() != 2 &&
+                   positional.size() != 4))
+    return Usage();
+  const int pixel_size =
+      positional.size() > 1 ? std::atoi(positional[1].c_str()) : 2;
+  const int width =
+      positional.size() > 2 ? std::atoi(positional[2].c_str()) : 800;
+  const int height =
+      positional.size() > 2 ? std::atoi(positional[3].c_str()) : 400;
+  if (pixel_size <= 0 || width < pixel_size || height < pixel_size)
+    return Usage();
+  return RunScript(positional[0].c_str(),
+                   {width / pixel_size, height / pixel_size, pixel_size},
+                   rate, frame_rate, record_path, scene_path, import_path);
+}
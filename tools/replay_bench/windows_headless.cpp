@@ -0,0 +1,532 @@
+// Copyright Wojciech Replin 2019
+
+#include <Windows.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+struct Object {
+  virtual ~Object() = default;
+};
+
+struct Bitmap : Object {
+  int width = 1;
+  int height = 1;
+  std::vector<uint32_t> pixels = std::vector<uint32_t>(1);
+};
+
+struct Font : Object {
+  int height = 16;
+};
+
+struct DeviceContext : Object {
+  // Every device context starts with these selected, just like in GDI.
+  Bitmap* bitmap = &stock_bitmap;
+  Font* font = &stock_font;
+  COLORREF text_color = RGB(0, 0, 0);
+
+  static Bitmap stock_bitmap;
+  static Font stock_font;
+};
+Bitmap DeviceContext::stock_bitmap;
+Font DeviceContext::stock_font;
+
+struct File : Object {
+  ~File() override { close(fd); }
+  int fd = -1;
+};
+
+struct FileMapping : Object {
+  int fd = -1;
+  size_t size = 0;
+};
+
+struct Window : Object {
+  std::wstring class_name;
+  std::wstring text;
+  WNDPROC procedure;
+  LONG_PTR user_data = 0;
+  Bitmap surface;
+  DeviceContext hdc;
+};
+
+std::map<std::wstring, WNDPROC>& GetClasses() {
+  static std::map<std::wstring, WNDPROC> classes;
+  return classes;
+}
+
+std::vector<Window*>& GetWindows() {
+  static std::vector<Window*> windows;
+  return windows;
+}
+
+// Messages are posted by worker threads too.
+std::mutex& GetQueueMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::deque<MSG>& GetQueue() {
+  static std::deque<MSG> queue;
+  return queue;
+}
+
+// Sizes of views of mapped files, by address.
+std::map<void const*, size_t>& GetViews() {
+  static std::map<void const*, size_t> views;
+  return views;
+}
+
+std::array<bool, 256>& GetKeys() {
+  static std::array<bool, 256> keys = {};
+  return keys;
+}
+
+template <typename T>
+T* Cast(HANDLE handle) {
+  return dynamic_cast<T*>(static_cast<Object*>(handle));
+}
+
+// Characters are drawn as boxes this much smaller than the cell they take.
+constexpr int kGlyphMargin = 1;
+
+int GetCharWidth(Font const* font) {
+  return std::max(font->height / 2, 1);
+}
+}  // namespace
+
+BOOL RegisterClassW(WNDCLASSW const* window_class) {
+  return GetClasses()
+      .emplace(window_class->lpszClassName, window_class->lpfnWndProc)
+      .second;
+}
+
+HWND CreateWindowW(LPCWSTR class_name,
+                   LPCWSTR window_name,
+                   DWORD style,
+                   int x,
+                   int y,
+                   int width,
+                   int height,
+                   HWND parent,
+                   HMENU menu,
+                   HINSTANCE instance,
+                   void* param) {
+  const auto window_class = GetClasses().find(class_name);
+  if (window_class == GetClasses().end() || width <= 0 || height <= 0)
+    return nullptr;
+  auto* window = new Window();
+  window->class_name = class_name;
+  window->text = window_name;
+  window->procedure = window_class->second;
+  window->surface.width = width;
+  window->surface.height = height;
+  window->surface.pixels.assign(static_cast<size_t>(width) * height, 0);
+  window->hdc.bitmap = &window->surface;
+  GetWindows().push_back(window);
+  return static_cast<Object*>(window);
+}
+
+HWND FindWindowW(LPCWSTR class_name, LPCWSTR window_name) {
+  for (auto* window : GetWindows()) {
+    if (!class_name || window->class_name == class_name)
+      return static_cast<Object*>(window);
+  }
+  return nullptr;
+}
+
+BOOL DestroyWindow(HWND window) {
+  auto* w = Cast<Window>(window);
+  if (!w)
+    return FALSE;
+  auto& windows = GetWindows();
+  windows.erase(std::find(windows.begin(), windows.end(), w));
+  delete w;
+  return TRUE;
+}
+
+BOOL AdjustWindowRect(RECT* rect, DWORD style, BOOL menu) {
+  // Windows have no frame, the client area is the whole window.
+  return TRUE;
+}
+
+BOOL ShowWindow(HWND window, int command) {
+  return TRUE;
+}
+
+BOOL SetWindowTextW(HWND window, LPCWSTR text) {
+  auto* w = Cast<Window>(window);
+  if (!w)
+    return FALSE;
+  w->text = text;
+  return TRUE;
+}
+
+int GetWindowTextW(HWND window, LPWSTR text, int max_count) {
+  auto* w = Cast<Window>(window);
+  if (!w || max_count <= 0)
+    return 0;
+  const auto length = std::min<size_t>(w->text.size(), max_count - 1);
+  std::copy_n(w->text.data(), length, text);
+  text[length] = L'\0';
+  return static_cast<int>(length);
+}
+
+LONG_PTR SetWindowLongPtr(HWND window, int index, LONG_PTR value) {
+  auto* w = Cast<Window>(window);
+  if (!w || index != GWLP_USERDATA)
+    return 0;
+  return std::exchange(w->user_data, value);
+}
+
+LONG_PTR GetWindowLongPtr(HWND window, int index) {
+  auto* w = Cast<Window>(window);
+  if (!w || index != GWLP_USERDATA)
+    return 0;
+  return w->user_data;
+}
+
+LRESULT SendMessageW(HWND window, UINT message, WPARAM wParam, LPARAM lParam) {
+  auto* w = Cast<Window>(window);
+  if (!w)
+    return 0;
+  return w->procedure(window, message, wParam, lParam);
+}
+
+BOOL PostMessageW(HWND window, UINT message, WPARAM wParam, LPARAM lParam) {
+  std::lock_guard<std::mutex> lock(GetQueueMutex());
+  GetQueue().push_back({window, message, wParam, lParam, 0, {0, 0}});
+  return TRUE;
+}
+
+BOOL PeekMessageW(MSG* message,
+                  HWND window,
+                  UINT filter_min,
+                  UINT filter_max,
+                  UINT remove) {
+  std::lock_guard<std::mutex> lock(GetQueueMutex());
+  auto& queue = GetQueue();
+  for (auto it = queue.begin(); it != queue.end(); ++it) {
+    if (window && it->hwnd != window)
+      continue;
+    if ((filter_min || filter_max) &&
+        (it->message < filter_min || it->message > filter_max)) {
+      continue;
+    }
+    *message = *it;
+    if (remove & PM_REMOVE)
+      queue.erase(it);
+    return TRUE;
+  }
+  return FALSE;
+}
+
+LRESULT DefWindowProcW(HWND window,
+                       UINT message,
+                       WPARAM wParam,
+                       LPARAM lParam) {
+  return 0;
+}
+
+void PostQuitMessage(int exit_code) {}
+
+HCURSOR LoadCursor(HINSTANCE instance, LPTSTR name) {
+  return nullptr;
+}
+
+BOOL GetCursorPos(POINT* point) {
+  *point = {0, 0};
+  return TRUE;
+}
+
+BOOL ScreenToClient(HWND window, POINT* point) {
+  return TRUE;
+}
+
+SHORT GetAsyncKeyState(int key) {
+  if (key < 0 || key >= static_cast<int>(GetKeys().size()))
+    return 0;
+  return GetKeys()[key] ? static_cast<SHORT>(0x8000) : 0;
+}
+
+int MessageBoxW(HWND window, LPCWSTR text, LPCWSTR caption, UINT type) {
+  std::fprintf(stderr, "%ls\n", text);
+  return 0;
+}
+
+HDC GetDC(HWND window) {
+  auto* w = Cast<Window>(window);
+  return w ? static_cast<Object*>(&w->hdc) : nullptr;
+}
+
+int ReleaseDC(HWND window, HDC hdc) {
+  return 1;
+}
+
+HDC CreateCompatibleDC(HDC hdc) {
+  return static_cast<Object*>(new DeviceContext());
+}
+
+BOOL DeleteDC(HDC hdc) {
+  delete Cast<DeviceContext>(hdc);
+  return TRUE;
+}
+
+HGDIOBJ SelectObject(HDC hdc, HGDIOBJ object) {
+  auto* dc = Cast<DeviceContext>(hdc);
+  if (!dc)
+    return nullptr;
+  if (auto* bitmap = Cast<Bitmap>(object))
+    return static_cast<Object*>(std::exchange(dc->bitmap, bitmap));
+  if (auto* font = Cast<Font>(object))
+    return static_cast<Object*>(std::exchange(dc->font, font));
+  return nullptr;
+}
+
+BOOL DeleteObject(HGDIOBJ object) {
+  delete static_cast<Object*>(object);
+  return TRUE;
+}
+
+HBITMAP CreateDIBSection(HDC hdc,
+                         BITMAPINFO const* info,
+                         UINT usage,
+                         void** bits,
+                         HANDLE section,
+                         DWORD offset) {
+  const auto& header = info->bmiHeader;
+  // Only top-down 32 bit DIBs are supported.
+  if (header.biBitCount != 32 || header.biWidth <= 0 || header.biHeight >= 0)
+    return nullptr;
+  auto* bitmap = new Bitmap();
+  bitmap->width = header.biWidth;
+  bitmap->height = -header.biHeight;
+  bitmap->pixels.assign(
+      static_cast<size_t>(bitmap->width) * bitmap->height, 0);
+  *bits = bitmap->pixels.data();
+  return static_cast<Object*>(bitmap);
+}
+
+BOOL StretchBlt(HDC destination,
+                int x,
+                int y,
+                int width,
+                int height,
+                HDC source,
+                int source_x,
+                int source_y,
+                int source_width,
+                int source_height,
+                DWORD rop) {
+  auto* dst = Cast<DeviceContext>(destination);
+  auto* src = Cast<DeviceContext>(source);
+  if (!dst || !src || width <= 0 || height <= 0 || source_width <= 0 ||
+      source_height <= 0)
+    return FALSE;
+  const Bitmap& from = *src->bitmap;
+  Bitmap& to = *dst->bitmap;
+  for (int row = std::max(y, 0); row < std::min(y + height, to.height);
+       ++row) {
+    const int from_row = source_y + (row - y) * source_height / height;
+    if (from_row < 0 || from_row >= from.height)
+      continue;
+    for (int column = std::max(x, 0); column < std::min(x + width, to.width);
+         ++column) {
+      const int from_column = source_x + (column - x) * source_width / width;
+      if (from_column < 0 || from_column >= from.width)
+        continue;
+      to.pixels[static_cast<size_t>(row) * to.width + column] =
+          from.pixels[static_cast<size_t>(from_row) * from.width +
+                      from_column];
+    }
+  }
+  return TRUE;
+}
+
+HFONT CreateFont(int height,
+                 int width,
+                 int escapement,
+                 int orientation,
+                 int weight,
+                 DWORD italic,
+                 DWORD underline,
+                 DWORD strike_out,
+                 DWORD charset,
+                 DWORD out_precision,
+                 DWORD clip_precision,
+                 DWORD quality,
+                 DWORD pitch_and_family,
+                 LPCWSTR face_name) {
+  auto* font = new Font();
+  font->height = std::max(std::abs(height), 1);
+  return static_cast<Object*>(font);
+}
+
+int SetBkMode(HDC hdc, int mode) {
+  return TRANSPARENT;
+}
+
+COLORREF SetTextColor(HDC hdc, COLORREF color) {
+  auto* dc = Cast<DeviceContext>(hdc);
+  return dc ? std::exchange(dc->text_color, color) : 0;
+}
+
+int DrawTextW(HDC hdc, LPCWSTR text, int length, RECT* rect, UINT format) {
+  auto* dc = Cast<DeviceContext>(hdc);
+  if (!dc)
+    return 0;
+  const int char_width = GetCharWidth(dc->font);
+  const int char_height = dc->font->height;
+  if (format & DT_CALCRECT) {
+    rect->right = rect->left + length * char_width;
+    rect->bottom = rect->top + char_height;
+    return char_height;
+  }
+  Bitmap& bitmap = *dc->bitmap;
+  const uint32_t color = GetRValue(dc->text_color) << 16 |
+                         GetGValue(dc->text_color) << 8 |
+                         GetBValue(dc->text_color);
+  for (int i = 0; i < length; ++i) {
+    if (text[i] == L' ')
+      continue;
+    const int left = rect->left + i * char_width + kGlyphMargin;
+    const int right = left + char_width - 2 * kGlyphMargin;
+    for (int row = std::max(rect->top + kGlyphMargin, 0);
+         row < std::min(rect->top + char_height - kGlyphMargin, bitmap.height);
+         ++row) {
+      for (int column = std::max(left, 0);
+           column < std::min(right, bitmap.width); ++column)
+        bitmap.pixels[static_cast<size_t>(row) * bitmap.width + column] =
+            color;
+    }
+  }
+  return char_height;
+}
+
+BOOL GdiFlush() {
+  return TRUE;
+}
+
+HANDLE CreateFileW(LPCWSTR name,
+                   DWORD access,
+                   DWORD share_mode,
+                   void* security,
+                   DWORD disposition,
+                   DWORD flags,
+                   HANDLE template_file) {
+  // Only opening existing files for reading is supported.
+  if (access != GENERIC_READ || disposition != OPEN_EXISTING)
+    return INVALID_HANDLE_VALUE;
+  const std::wstring wide(name);
+  const int fd = open(std::string(wide.begin(), wide.end()).c_str(), O_RDONLY);
+  if (fd < 0)
+    return INVALID_HANDLE_VALUE;
+  auto* file = new File();
+  file->fd = fd;
+  return static_cast<Object*>(file);
+}
+
+BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER* size) {
+  auto* f = Cast<File>(file);
+  struct stat status;
+  if (!f || fstat(f->fd, &status) != 0)
+    return FALSE;
+  size->QuadPart = status.st_size;
+  return TRUE;
+}
+
+HANDLE CreateFileMappingW(HANDLE file,
+                          void* security,
+                          DWORD protection,
+                          DWORD max_size_high,
+                          DWORD max_size_low,
+                          LPCWSTR name) {
+  LARGE_INTEGER size;
+  // Like in Win32, empty files can't be mapped.
+  if (protection != PAGE_READONLY || !GetFileSizeEx(file, &size) ||
+      size.QuadPart == 0) {
+    return NULL;
+  }
+  auto* mapping = new FileMapping();
+  mapping->fd = Cast<File>(file)->fd;
+  mapping->size = static_cast<size_t>(size.QuadPart);
+  return static_cast<Object*>(mapping);
+}
+
+LPVOID MapViewOfFile(HANDLE mapping,
+                     DWORD access,
+                     DWORD offset_high,
+                     DWORD offset_low,
+                     size_t bytes) {
+  auto* m = Cast<FileMapping>(mapping);
+  if (!m || access != FILE_MAP_READ || offset_high || offset_low ||
+      (bytes && bytes != m->size)) {
+    return nullptr;
+  }
+  void* view = mmap(nullptr, m->size, PROT_READ, MAP_SHARED, m->fd, 0);
+  if (view == MAP_FAILED)
+    return nullptr;
+  GetViews()[view] = m->size;
+  return view;
+}
+
+BOOL UnmapViewOfFile(LPCVOID address) {
+  const auto view = GetViews().find(address);
+  if (view == GetViews().end())
+    return FALSE;
+  munmap(const_cast<void*>(address), view->second);
+  GetViews().erase(view);
+  return TRUE;
+}
+
+BOOL CloseHandle(HANDLE object) {
+  delete static_cast<Object*>(object);
+  return TRUE;
+}
+
+DWORD GetLastError() {
+  return 0;
+}
+
+DWORD FormatMessageW(DWORD flags,
+                     void const* source,
+                     DWORD message_id,
+                     DWORD language_id,
+                     LPWSTR buffer,
+                     DWORD size,
+                     void* arguments) {
+  return 0;
+}
+
+HLOCAL LocalFree(HLOCAL memory) {
+  return nullptr;
+}
+
+namespace headless {
+void SetKeyDown(int key, bool down) {
+  if (key >= 0 && key < static_cast<int>(GetKeys().size()))
+    GetKeys()[key] = down;
+}
+
+uint32_t const* GetWindowPixels(HWND window, int* width, int* height) {
+  auto* w = Cast<Window>(window);
+  if (!w)
+    return nullptr;
+  *width = w->surface.width;
+  *height = w->surface.height;
+  return w->surface.pixels.data();
+}
+}  // namespace headless